@@ -0,0 +1,667 @@
+#ifndef BITBOARD_H_INCLUDED
+#define BITBOARD_H_INCLUDED
+
+
+//Bitboards store one bit per square in an integer, bit (row * N + col) being set if the
+//square belongs to that set. Board wide questions such as "which discs can never be
+//flipped" then become a handful of shifts and masks instead of loops over the Board_vec.
+//Boards up to 8x8 fit in 64 bits, 10x10 boards use a 128 bit integer.
+
+
+#include "Piece.h"
+#include "Const_table.h"
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <type_traits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//Square sets and masks for an N x N board. The masks are generated by constexpr
+//functions, so each board size gets its own constants and no size checks at runtime.
+template<int N>
+struct Board_bits {
+    typedef typename conditional<(N * N <= 64), uint64_t, unsigned __int128>::type Type;
+
+    static constexpr Type square(int row, int col) {
+        return Type(1) << (row * N + col);
+    }
+
+    //Every square on the board (the unused high bits of boards smaller than 8x8 are left out)
+    static constexpr Type full() {
+        Type out = 0;
+        for(int i = 0; i < N * N; i++)
+            out |= Type(1) << i;
+        return out;
+    }
+
+    static constexpr Type column(int col) {
+        Type out = 0;
+        for(int row = 0; row < N; row++)
+            out |= square(row, col);
+        return out;
+    }
+
+    static constexpr Type corners() {
+        return square(0, 0) | square(0, N - 1) | square(N - 1, 0) | square(N - 1, N - 1);
+    }
+};
+
+template<int N>
+using Bits = typename Board_bits<N>::Type;
+
+//Bitboards of the standard 8x8 board
+typedef Bits<8> Bitboard;
+
+const static Bitboard FULL_BOARD = Board_bits<8>::full();
+const static Bitboard CORNERS = Board_bits<8>::corners();
+const static Bitboard INNER_SQUARES = 0x007e7e7e7e7e7e00ULL;
+
+template<int N = 8>
+constexpr Bits<N> square_bit(int row, int col) {
+    return Board_bits<N>::square(row, col);
+}
+
+inline int count_bits(uint64_t bits) {
+    return __builtin_popcountll(bits);
+}
+
+inline int count_bits(unsigned __int128 bits) {
+    return __builtin_popcountll(uint64_t(bits)) + __builtin_popcountll(uint64_t(bits >> 64));
+}
+
+//The index of the lowest square in a non-empty set
+inline int first_square(uint64_t bits) {
+    return __builtin_ctzll(bits);
+}
+
+inline int first_square(unsigned __int128 bits) {
+    if(uint64_t(bits))
+        return __builtin_ctzll(uint64_t(bits));
+    return 64 + __builtin_ctzll(uint64_t(bits >> 64));
+}
+
+template<int N = 8>
+inline Position square_position(int square) {
+    return Position(square / N, square % N);
+}
+
+//Splits a Board_vec into the discs owned by piece and the discs owned by its opponent
+template<int N = 8>
+void to_bitboards(const Board_vec &board, Piece piece, Bits<N> &own, Bits<N> &opp);
+
+//Moves every square in a set one step in one of the 8 directions (0 to 7, clockwise
+//from north). Squares that would wrap around the side or fall off the end of the
+//board are dropped.
+template<int N = 8>
+inline Bits<N> shift(Bits<N> bits, int dir) {
+    typedef Board_bits<N> B;
+    const Bits<N> NOT_FIRST_COL = B::full() & ~B::column(0);
+    const Bits<N> NOT_LAST_COL = B::full() & ~B::column(N - 1);
+
+    switch(dir) {
+        case 0: return bits >> N;
+        case 1: return (bits >> (N - 1)) & NOT_FIRST_COL;
+        case 2: return (bits << 1) & NOT_FIRST_COL;
+        case 3: return (bits << (N + 1)) & NOT_FIRST_COL;
+        case 4: return (bits << N) & B::full();
+        case 5: return (bits << (N - 1)) & NOT_LAST_COL;
+        case 6: return (bits >> 1) & NOT_LAST_COL;
+        case 7: return (bits >> (N + 1)) & NOT_LAST_COL;
+        //Default case is unreachable
+        default: assert(false); return 0;
+    }
+}
+
+//The set of squares where own can legally play
+template<int N = 8>
+Bits<N> legal_moves(Bits<N> own, Bits<N> opp);
+//The opponent discs flipped if own plays at square (0 if the move is illegal)
+template<int N = 8>
+Bits<N> flipped_discs(Bits<N> own, Bits<N> opp, int square);
+
+//Portable versions of the two functions above, which work through the 8 directions one
+//at a time. The 8x8 board uses vector kernels instead when the processor supports them.
+template<int N = 8>
+Bits<N> legal_moves_scalar(Bits<N> own, Bits<N> opp);
+template<int N = 8>
+Bits<N> flipped_discs_scalar(Bits<N> own, Bits<N> opp, int square);
+
+template<>
+inline Bitboard legal_moves<8>(Bitboard own, Bitboard opp);
+template<>
+inline Bitboard flipped_discs<8>(Bitboard own, Bitboard opp, int square);
+
+//Returns the discs in own that can never be flipped by any sequence of moves.
+//Stability uses tables of the 8x8 board's edges, so it is only available for that size.
+Bitboard stable_discs(Bitboard own, Bitboard opp);
+
+
+//Line helpers. An edge is read into an 8 bit line with bit i holding square i along the edge.
+
+//The base 3 value of each 8 bit line read as digits of 0 and 1, bit i being digit i
+constexpr Const_table<int, 256> make_ternary_lines() {
+    Const_table<int, 256> out{};
+    for(int line = 0; line < 256; line++)
+        for(int i = 7; i >= 0; i--)
+            out[line] = out[line] * 3 + ((line >> i) & 1);
+
+    return out;
+}
+
+constexpr static Const_table<int, 256> TERNARY_LINES = make_ternary_lines();
+
+//Index of an edge configuration in base 3: each square is 0 (empty), 1 (own) or 2 (opp)
+constexpr int edge_index(int own, int opp) {
+    return TERNARY_LINES[own & 0xff] + 2 * TERNARY_LINES[opp & 0xff];
+}
+
+inline int get_column(Bitboard bits, int col) {
+    int out = 0;
+    for(int row = 0; row < 8; row++)
+        out |= int((bits >> (row * 8 + col)) & 1) << row;
+
+    return out;
+}
+
+inline Bitboard set_column(int line, int col) {
+    Bitboard out = 0;
+    for(int row = 0; row < 8; row++)
+        if((line >> row) & 1)
+            out |= square_bit(row, col);
+
+    return out;
+}
+
+//Plays mover at square x of a line, flipping the other player's discs along the line only
+constexpr void play_edge(int &mover, int &other, int x) {
+    mover |= 1 << x;
+
+    for(int dir = -1; dir <= 1; dir += 2) {
+        int flips = 0;
+        int y = x + dir;
+        while(y >= 0 && y < 8 && ((other >> y) & 1)) {
+            flips |= 1 << y;
+            y += dir;
+        }
+
+        if(y >= 0 && y < 8 && ((mover >> y) & 1)) {
+            mover ^= flips;
+            other ^= flips;
+        }
+    }
+}
+
+//Finds the stable own discs of an edge by trying every possible move by either player
+//on every empty square. Moves from the inside of the board can fill an edge square
+//without flipping anything along the edge, so every placement is tried whether or
+//not it flips. A disc is stable if it is still owned after every sequence of moves.
+//Results are stored in table as they are found, using computed to mark finished entries.
+constexpr int find_edge_stable(int own, int opp, Const_table<unsigned char, 6561> &table, Const_table<bool, 6561> &computed) {
+    int index = edge_index(own, opp);
+    if(computed[index])
+        return table[index];
+
+    int stable = own;
+    int empty = ~(own | opp) & 0xff;
+
+    for(int x = 0; x < 8 && stable; x++) {
+        if(!((empty >> x) & 1))
+            continue;
+
+        int next_own = own;
+        int next_opp = opp;
+        play_edge(next_own, next_opp, x);
+        stable &= find_edge_stable(next_own, next_opp, table, computed);
+
+        next_own = own;
+        next_opp = opp;
+        play_edge(next_opp, next_own, x);
+        stable &= find_edge_stable(next_own, next_opp, table, computed);
+    }
+
+    table[index] = stable;
+    computed[index] = true;
+
+    return stable;
+}
+
+//The stable own discs for each of the 3^8 configurations of an edge
+constexpr Const_table<unsigned char, 6561> make_edge_stability() {
+    Const_table<unsigned char, 6561> out{};
+    Const_table<bool, 6561> computed{};
+
+    for(int own = 0; own < 256; own++)
+        for(int opp = 0; opp < 256; opp++)
+            if(!(own & opp))
+                find_edge_stable(own, opp, out, computed);
+
+    return out;
+}
+
+constexpr static Const_table<unsigned char, 6561> EDGE_STABILITY = make_edge_stability();
+
+//Masks of each complete line on the board: 8 rows, 8 columns and 15 diagonals in each direction
+struct Line_masks {
+    Bitboard rows[8];
+    Bitboard cols[8];
+    Bitboard diagonals[15];  //Squares with the same row - col
+    Bitboard anti_diagonals[15];  //Squares with the same row + col
+};
+
+constexpr Line_masks make_line_masks() {
+    Line_masks out{};
+    for(int row = 0; row < 8; row++) {
+        for(int col = 0; col < 8; col++) {
+            out.rows[row] |= square_bit(row, col);
+            out.cols[col] |= square_bit(row, col);
+            out.diagonals[row - col + 7] |= square_bit(row, col);
+            out.anti_diagonals[row + col] |= square_bit(row, col);
+        }
+    }
+
+    return out;
+}
+
+constexpr static Line_masks LINE_MASKS = make_line_masks();
+
+template<int N>
+void to_bitboards(const Board_vec &board, Piece piece, Bits<N> &own, Bits<N> &opp) {
+    Piece opponent = get_opponent(piece);
+
+    own = 0;
+    opp = 0;
+    for(int row = 0; row < N; row++) {
+        for(int col = 0; col < N; col++) {
+            if(board[row][col] == piece)
+                own |= square_bit<N>(row, col);
+            else if(board[row][col] == opponent)
+                opp |= square_bit<N>(row, col);
+        }
+    }
+}
+
+template<int N>
+Bits<N> legal_moves(Bits<N> own, Bits<N> opp) {
+    return legal_moves_scalar<N>(own, opp);
+}
+
+template<int N>
+Bits<N> flipped_discs(Bits<N> own, Bits<N> opp, int square) {
+    return flipped_discs_scalar<N>(own, opp, square);
+}
+
+template<int N>
+Bits<N> legal_moves_scalar(Bits<N> own, Bits<N> opp) {
+    Bits<N> empty = Board_bits<N>::full() & ~(own | opp);
+    Bits<N> moves = 0;
+
+    //Runs of opponent discs are grown away from own discs one square at a time. A run is
+    //at most N - 2 discs long, and a move is any empty square just past the end of a run.
+    for(int dir = 0; dir < 8; dir++) {
+        Bits<N> run = shift<N>(own, dir) & opp;
+        for(int i = 0; i < N - 3; i++)
+            run |= shift<N>(run, dir) & opp;
+
+        moves |= shift<N>(run, dir) & empty;
+    }
+
+    return moves;
+}
+
+template<int N>
+Bits<N> flipped_discs_scalar(Bits<N> own, Bits<N> opp, int square) {
+    Bits<N> move = Bits<N>(1) << square;
+    if((own | opp) & move)
+        return 0;
+
+    Bits<N> flips = 0;
+    for(int dir = 0; dir < 8; dir++) {
+        Bits<N> line = 0;
+        Bits<N> next = shift<N>(move, dir);
+        while(next & opp) {
+            line |= next;
+            next = shift<N>(next, dir);
+        }
+
+        if(next & own)
+            flips |= line;
+    }
+
+    return flips;
+}
+
+//Vector move generation for the 8x8 board. Each 256 bit AVX2 register holds four copies
+//of a bitboard, one for each of four directions, and shifting the register left and
+//right by the per lane amounts (1, 8, 9 and 7) covers all eight directions at once.
+//Opponent discs on the first and last columns are masked out of every direction with a
+//sideways step, as a run containing them could only continue by wrapping around the
+//side of the board.
+#if defined(__x86_64__)
+
+__attribute__((target("avx2")))
+Bitboard legal_moves_avx2(Bitboard own, Bitboard opp) {
+    const __m256i shifts = _mm256_set_epi64x(7, 9, 8, 1);
+    const __m256i masks = _mm256_set_epi64x(0x7e7e7e7e7e7e7e7eLL, 0x7e7e7e7e7e7e7e7eLL, -1LL, 0x7e7e7e7e7e7e7e7eLL);
+
+    __m256i own_v = _mm256_set1_epi64x(own);
+    __m256i opp_v = _mm256_and_si256(_mm256_set1_epi64x(opp), masks);
+
+    __m256i left = _mm256_and_si256(opp_v, _mm256_sllv_epi64(own_v, shifts));
+    __m256i right = _mm256_and_si256(opp_v, _mm256_srlv_epi64(own_v, shifts));
+    for(int i = 0; i < 5; i++) {
+        left = _mm256_or_si256(left, _mm256_and_si256(opp_v, _mm256_sllv_epi64(left, shifts)));
+        right = _mm256_or_si256(right, _mm256_and_si256(opp_v, _mm256_srlv_epi64(right, shifts)));
+    }
+
+    __m256i moves = _mm256_or_si256(_mm256_sllv_epi64(left, shifts), _mm256_srlv_epi64(right, shifts));
+
+    //Combine the four lanes
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(moves), _mm256_extracti128_si256(moves, 1));
+    half = _mm_or_si128(half, _mm_unpackhi_epi64(half, half));
+
+    return Bitboard(_mm_cvtsi128_si64(half)) & ~(own | opp);
+}
+
+__attribute__((target("avx2")))
+Bitboard flipped_discs_avx2(Bitboard own, Bitboard opp, int square) {
+    Bitboard move = Bitboard(1) << square;
+    if((own | opp) & move)
+        return 0;
+
+    const __m256i shifts = _mm256_set_epi64x(7, 9, 8, 1);
+    const __m256i masks = _mm256_set_epi64x(0x7e7e7e7e7e7e7e7eLL, 0x7e7e7e7e7e7e7e7eLL, -1LL, 0x7e7e7e7e7e7e7e7eLL);
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i own_v = _mm256_set1_epi64x(own);
+    __m256i opp_v = _mm256_and_si256(_mm256_set1_epi64x(opp), masks);
+    __m256i move_v = _mm256_set1_epi64x(move);
+
+    //Grow the run of opponent discs next to the move in each direction
+    __m256i left = _mm256_and_si256(opp_v, _mm256_sllv_epi64(move_v, shifts));
+    __m256i right = _mm256_and_si256(opp_v, _mm256_srlv_epi64(move_v, shifts));
+    for(int i = 0; i < 5; i++) {
+        left = _mm256_or_si256(left, _mm256_and_si256(opp_v, _mm256_sllv_epi64(left, shifts)));
+        right = _mm256_or_si256(right, _mm256_and_si256(opp_v, _mm256_srlv_epi64(right, shifts)));
+    }
+
+    //A run is only flipped if the square just past it holds an own disc
+    __m256i left_end = _mm256_and_si256(own_v, _mm256_sllv_epi64(left, shifts));
+    __m256i right_end = _mm256_and_si256(own_v, _mm256_srlv_epi64(right, shifts));
+    left = _mm256_andnot_si256(_mm256_cmpeq_epi64(left_end, zero), left);
+    right = _mm256_andnot_si256(_mm256_cmpeq_epi64(right_end, zero), right);
+
+    __m256i flips = _mm256_or_si256(left, right);
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(flips), _mm256_extracti128_si256(flips, 1));
+    half = _mm_or_si128(half, _mm_unpackhi_epi64(half, half));
+
+    return Bitboard(_mm_cvtsi128_si64(half));
+}
+
+#endif
+
+//The move generation functions used for the 8x8 board, chosen once at startup
+struct Move_kernels {
+    const char *name;
+    Bitboard (*legal_moves)(Bitboard own, Bitboard opp);
+    Bitboard (*flipped_discs)(Bitboard own, Bitboard opp, int square);
+};
+
+const static Move_kernels SCALAR_KERNELS = {"scalar", legal_moves_scalar<8>, flipped_discs_scalar<8>};
+
+#if defined(__x86_64__)
+const static Move_kernels AVX2_KERNELS = {"avx2", legal_moves_avx2, flipped_discs_avx2};
+#endif
+
+//Returns the AVX2 kernels if the processor running the program supports them
+Move_kernels best_move_kernels() {
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2"))
+        return AVX2_KERNELS;
+#endif
+
+    return SCALAR_KERNELS;
+}
+
+const static Move_kernels MOVE_KERNELS = best_move_kernels();
+
+template<>
+inline Bitboard legal_moves<8>(Bitboard own, Bitboard opp) {
+    return MOVE_KERNELS.legal_moves(own, opp);
+}
+
+template<>
+inline Bitboard flipped_discs<8>(Bitboard own, Bitboard opp, int square) {
+    return MOVE_KERNELS.flipped_discs(own, opp, square);
+}
+
+//The 8 rotations and reflections of the 8x8 board, each a few shifts and masks
+inline Bitboard flip_vertical(Bitboard bits) {
+    return __builtin_bswap64(bits);
+}
+
+inline Bitboard mirror_horizontal(Bitboard bits) {
+    const Bitboard k1 = 0x5555555555555555ULL;
+    const Bitboard k2 = 0x3333333333333333ULL;
+    const Bitboard k4 = 0x0f0f0f0f0f0f0f0fULL;
+    bits = ((bits >> 1) & k1) | ((bits & k1) << 1);
+    bits = ((bits >> 2) & k2) | ((bits & k2) << 2);
+    bits = ((bits >> 4) & k4) | ((bits & k4) << 4);
+    return bits;
+}
+
+//Swaps rows and columns, by swapping ever smaller blocks across the diagonal
+inline Bitboard transpose(Bitboard bits) {
+    const Bitboard k1 = 0x5500550055005500ULL;
+    const Bitboard k2 = 0x3333000033330000ULL;
+    const Bitboard k4 = 0x0f0f0f0f00000000ULL;
+    Bitboard t = k4 & (bits ^ (bits << 28));
+    bits ^= t ^ (t >> 28);
+    t = k2 & (bits ^ (bits << 14));
+    bits ^= t ^ (t >> 14);
+    t = k1 & (bits ^ (bits << 7));
+    bits ^= t ^ (t >> 7);
+    return bits;
+}
+
+//The i-th of the 8 symmetries of the board, 0 being the board itself
+inline Bitboard symmetry(Bitboard bits, int i) {
+    if(i & 1) bits = flip_vertical(bits);
+    if(i & 2) bits = mirror_horizontal(bits);
+    if(i & 4) bits = transpose(bits);
+    return bits;
+}
+
+//Replaces a position with the smallest of its 8 symmetries, comparing own then opp, so
+//positions that are rotations or reflections of each other become the same. Returns the
+//symmetry that was applied.
+inline int canonical(Bitboard &own, Bitboard &opp) {
+    Bitboard best_own = own, best_opp = opp;
+    int best = 0;
+    for(int i = 1; i < 8; i++) {
+        Bitboard o = symmetry(own, i);
+        if(o > best_own)
+            continue;
+        Bitboard p = symmetry(opp, i);
+        if(o < best_own || p < best_opp) {
+            best_own = o;
+            best_opp = p;
+            best = i;
+        }
+    }
+    own = best_own;
+    opp = best_opp;
+    return best;
+}
+
+//A well mixed 64 bit key for a position
+inline uint64_t position_hash(Bitboard own, Bitboard opp) {
+    uint64_t out = own * 0x9e3779b97f4a7c15ULL ^ (opp + 0x632be59bd9b4e019ULL) * 0xc2b2ae3d27d4eb4fULL;
+    out ^= out >> 29;
+    out *= 0xbf58476d1ce4e5b9ULL;
+    return out ^ (out >> 32);
+}
+
+Bitboard stable_discs(Bitboard own, Bitboard opp) {
+    const Const_table<unsigned char, 6561> &edges = EDGE_STABILITY;
+    const Line_masks &masks = LINE_MASKS;
+
+    //Edge discs can only be flipped along the edge, so the table gives their exact stability
+    Bitboard stable = 0;
+    stable |= Bitboard(edges[edge_index(own & 0xff, opp & 0xff)]);
+    stable |= Bitboard(edges[edge_index(own >> 56, opp >> 56)]) << 56;
+    stable |= set_column(edges[edge_index(get_column(own, 0), get_column(opp, 0))], 0);
+    stable |= set_column(edges[edge_index(get_column(own, 7), get_column(opp, 7))], 7);
+
+    //A line with no empty squares can never be played in again, so discs are safe in any
+    //direction that runs along a full line
+    Bitboard occupied = own | opp;
+    Bitboard full_h = 0, full_v = 0, full_d9 = 0, full_d7 = 0;
+    for(int i = 0; i < 8; i++) {
+        if((occupied & masks.rows[i]) == masks.rows[i]) full_h |= masks.rows[i];
+        if((occupied & masks.cols[i]) == masks.cols[i]) full_v |= masks.cols[i];
+    }
+    for(int i = 0; i < 15; i++) {
+        if((occupied & masks.diagonals[i]) == masks.diagonals[i]) full_d9 |= masks.diagonals[i];
+        if((occupied & masks.anti_diagonals[i]) == masks.anti_diagonals[i]) full_d7 |= masks.anti_diagonals[i];
+    }
+
+    Bitboard inner = own & INNER_SQUARES;
+    stable |= inner & full_h & full_v & full_d9 & full_d7;
+
+    //A disc is also safe in a direction if it touches a stable disc of its own colour along
+    //that line. Stable discs are grown from the edges inwards until nothing changes. Only
+    //inner squares are updated, so bits shifted across the sides of the board never matter.
+    Bitboard previous;
+    do {
+        previous = stable;
+        Bitboard safe_h = (stable >> 1) | (stable << 1) | full_h;
+        Bitboard safe_v = (stable >> 8) | (stable << 8) | full_v;
+        Bitboard safe_d9 = (stable >> 9) | (stable << 9) | full_d9;
+        Bitboard safe_d7 = (stable >> 7) | (stable << 7) | full_d7;
+        stable |= inner & safe_h & safe_v & safe_d9 & safe_d7;
+    } while(stable != previous);
+
+    return stable;
+}
+
+
+//Weighted square counts for evaluating many 8x8 positions at once. The squares are
+//split into classes that share a weight, so the weighted sum of a position is a handful
+//of popcounts instead of a loop over all 64 squares. Classes can also carry an extra
+//weight that only applies in the quadrants whose corner is occupied.
+struct Square_classes {
+    const static int MAX_CLASSES = 16;
+
+    int count = 0;
+    Bitboard masks[MAX_CLASSES];
+    int weights[MAX_CLASSES];
+    int taken_weights[MAX_CLASSES];  //Added to weights for squares in a quadrant with its corner taken
+
+    Bitboard corners[4];
+    Bitboard quadrants[4];  //The squares each corner decides
+};
+
+//Sets out[i] to the weighted count of own minus that of opp for positions 0 to count - 1.
+//The positions are a structure of arrays, so the vector kernel loads four at a time.
+void weighted_counts_scalar(const Bitboard own[], const Bitboard opp[], size_t count, const Square_classes &classes, int out[]) {
+    for(size_t i = 0; i < count; i++) {
+        Bitboard occupied = own[i] | opp[i];
+        Bitboard taken = 0;
+        for(int q = 0; q < 4; q++)
+            if(occupied & classes.corners[q])
+                taken |= classes.quadrants[q];
+
+        int sum = 0;
+        for(int c = 0; c < classes.count; c++) {
+            Bitboard mask = classes.masks[c];
+            sum += classes.weights[c] * (count_bits(own[i] & mask) - count_bits(opp[i] & mask));
+            if(classes.taken_weights[c])
+                sum += classes.taken_weights[c] * (count_bits(own[i] & mask & taken) - count_bits(opp[i] & mask & taken));
+        }
+        out[i] = sum;
+    }
+}
+
+#if defined(__x86_64__)
+
+//Counts the bits of each 64 bit lane, by looking up the count of every 4 bit nibble with
+//a byte shuffle and then summing the bytes of each lane
+__attribute__((target("avx2")))
+inline __m256i popcount_avx2(__m256i v) {
+    const __m256i nibble_counts = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+
+    __m256i low = _mm256_and_si256(v, low_nibbles);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi64(v, 4), low_nibbles);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(nibble_counts, low), _mm256_shuffle_epi8(nibble_counts, high));
+
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+//Difference of the popcounts of own and opp under mask, times weight, in each lane.
+//The counts fit in 32 bits, so the signed 32 bit multiply gives the exact product.
+__attribute__((target("avx2")))
+inline __m256i weighted_difference_avx2(__m256i own, __m256i opp, __m256i mask, int weight) {
+    __m256i difference = _mm256_sub_epi64(popcount_avx2(_mm256_and_si256(own, mask)), popcount_avx2(_mm256_and_si256(opp, mask)));
+    return _mm256_mul_epi32(difference, _mm256_set1_epi64x(weight));
+}
+
+__attribute__((target("avx2")))
+void weighted_counts_avx2(const Bitboard own[], const Bitboard opp[], size_t count, const Square_classes &classes, int out[]) {
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m256i own_v = _mm256_loadu_si256((const __m256i*)(own + i));
+        __m256i opp_v = _mm256_loadu_si256((const __m256i*)(opp + i));
+        __m256i occupied = _mm256_or_si256(own_v, opp_v);
+
+        __m256i taken = zero;
+        for(int q = 0; q < 4; q++) {
+            __m256i corner = _mm256_and_si256(occupied, _mm256_set1_epi64x(classes.corners[q]));
+            __m256i quadrant = _mm256_set1_epi64x(classes.quadrants[q]);
+            taken = _mm256_or_si256(taken, _mm256_andnot_si256(_mm256_cmpeq_epi64(corner, zero), quadrant));
+        }
+
+        __m256i sum = zero;
+        for(int c = 0; c < classes.count; c++) {
+            __m256i mask = _mm256_set1_epi64x(classes.masks[c]);
+            sum = _mm256_add_epi64(sum, weighted_difference_avx2(own_v, opp_v, mask, classes.weights[c]));
+            if(classes.taken_weights[c])
+                sum = _mm256_add_epi64(sum, weighted_difference_avx2(own_v, opp_v, _mm256_and_si256(mask, taken), classes.taken_weights[c]));
+        }
+
+        long long lanes[4];
+        _mm256_storeu_si256((__m256i*)lanes, sum);
+        for(int k = 0; k < 4; k++)
+            out[i + k] = int(lanes[k]);
+    }
+
+    weighted_counts_scalar(own + i, opp + i, count - i, classes, out + i);
+}
+
+#endif
+
+typedef void (*Weighted_count_kernel)(const Bitboard own[], const Bitboard opp[], size_t count, const Square_classes &classes, int out[]);
+
+Weighted_count_kernel best_weighted_count_kernel() {
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2"))
+        return weighted_counts_avx2;
+#endif
+
+    return weighted_counts_scalar;
+}
+
+const static Weighted_count_kernel WEIGHTED_COUNT_KERNEL = best_weighted_count_kernel();
+
+
+#endif
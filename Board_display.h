@@ -0,0 +1,188 @@
+#ifndef BOARD_DISPLAY_H_INCLUDED
+#define BOARD_DISPLAY_H_INCLUDED
+
+
+#include "Board.h"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+using namespace std;
+
+//Shows a game's board on the terminal, one frame per turn. Each frame is built in a buffer
+//that is kept between frames, and sent with a single write.
+//
+//On a terminal that understands cursor addressing the board is drawn once at the top of the
+//screen and everything printed after it scrolls in the lines below (a VT100 scrolling
+//region). Later frames only send the squares that changed, each addressed by its position,
+//which is a few hundred bytes instead of a few kilobytes over a slow link. Otherwise, when
+//the output is a file, a pipe or a dumb terminal, every frame is the whole board as text.
+template<int N>
+class Basic_board_display {
+private:
+    typedef Basic_renderer<N> Renderer;
+
+    const static int TOP = 1;  //Screen line of the board's first line
+
+    bool _differential;
+    string _frame;
+
+    //What is on screen, so the next frame can send only the differences. Nothing is on
+    //screen while _drawn is null.
+    const Renderer *_drawn = nullptr;
+    typename Renderer::Cell _cells[N][N];
+    int _rows = 0;  //The terminal's height when the board was drawn
+
+    static int terminal_rows();
+    void write_frame();
+
+public:
+    //Uses differential frames if the standard output is a capable terminal
+    Basic_board_display();
+    explicit Basic_board_display(bool differential);
+    ~Basic_board_display();
+
+    bool differential() const { return _differential; }
+
+    //Sends text then the board, showing the legal moves of the given player (none for
+    //Piece::EMPTY), then more text. In full frame mode the board is followed by a newline.
+    void show(const string &before, const Basic_board<N> &board, Piece active_player, const string &after);
+    //Sends text that is not part of a frame, in the same single write
+    void print(const string &text);
+
+    //Returns the terminal to normal scrolling, below the board
+    void finish();
+};
+
+typedef Basic_board_display<8> Board_display;
+
+//Private methods
+
+template<int N>
+int Basic_board_display<N>::terminal_rows() {
+    winsize size;
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) < 0)
+        return 0;
+    return size.ws_row;
+}
+
+template<int N>
+void Basic_board_display<N>::write_frame() {
+    //Anything already written through cout has to reach the terminal first
+    cout.flush();
+
+    for(size_t sent = 0; sent < _frame.size(); ) {
+        ssize_t n = ::write(STDOUT_FILENO, _frame.data() + sent, _frame.size() - sent);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            break;
+        sent += n;
+    }
+
+    _frame.clear();
+}
+
+
+//Public methods
+
+template<int N>
+Basic_board_display<N>::Basic_board_display():
+    Basic_board_display(false)
+{
+    const char *term = getenv("TERM");
+    _differential = isatty(STDOUT_FILENO) && term && *term && strcmp(term, "dumb") != 0;
+}
+
+template<int N>
+Basic_board_display<N>::Basic_board_display(bool differential):
+    _differential(differential)
+{
+    //The largest frame is the large board in full, about 8 KiB on 8x8
+    _frame.reserve(16384);
+}
+
+template<int N>
+Basic_board_display<N>::~Basic_board_display() {
+    finish();
+}
+
+template<int N>
+void Basic_board_display<N>::show(const string &before, const Basic_board<N> &board, Piece active_player, const string &after) {
+    const Renderer &renderer = board.renderer();
+    const Basic_board_state<N> &state = board.state();
+    Bits<N> moves = active_player == Piece::EMPTY ? 0 : state.legal_moves(active_player);
+
+    //A terminal too short to keep the board and a few lines of text under it gets full frames
+    int rows = _differential ? terminal_rows() : 0;
+    int region = TOP + renderer.lines() + 1;  //First line of the text under the board
+    if(_differential && rows < region + 4) {
+        finish();
+        _differential = false;
+    }
+
+    if(!_differential) {
+        _frame += before;
+        renderer.render(state, moves, active_player, _frame);
+        _frame += "\n";
+        _frame += after;
+        write_frame();
+        return;
+    }
+
+    if(_drawn != &renderer || _rows != rows) {
+        //The whole board at the top of a cleared screen, then the text scrolls under it
+        _frame += "\033[r\033[H\033[2J";
+        renderer.render(state, moves, active_player, _frame);
+        for(int row = 0; row < N; row++)
+            for(int col = 0; col < N; col++)
+                _cells[row][col] = Renderer::cell(state, moves, active_player, row, col);
+        _frame += "\033[" + to_string(region) + ";" + to_string(rows) + "r";
+        _frame += "\033[" + to_string(rows) + ";1H";
+
+        _drawn = &renderer;
+        _rows = rows;
+    } else {
+        //Only the squares that changed, with the cursor put back where the text left it
+        _frame += "\0337";
+        for(int row = 0; row < N; row++) {
+            for(int col = 0; col < N; col++) {
+                typename Renderer::Cell cell = Renderer::cell(state, moves, active_player, row, col);
+                if(cell != _cells[row][col]) {
+                    renderer.render_cell(cell, row, col, TOP, _frame);
+                    _cells[row][col] = cell;
+                }
+            }
+        }
+        _frame += "\0338";
+    }
+
+    //The text goes after the board, as a full redraw clears the screen
+    _frame += before;
+    _frame += after;
+    write_frame();
+}
+
+template<int N>
+void Basic_board_display<N>::print(const string &text) {
+    _frame += text;
+    write_frame();
+}
+
+template<int N>
+void Basic_board_display<N>::finish() {
+    if(!_drawn)
+        return;
+
+    _frame += "\033[r\033[" + to_string(_rows) + ";1H\n";
+    write_frame();
+    _drawn = nullptr;
+}
+
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef BOARD_STATE_H_INCLUDED
+#define BOARD_STATE_H_INCLUDED
+
+
+#include "Piece.h"
+#include "Bitboard.h"
+
+#include <type_traits>
+#include <cassert>
+
+using namespace std;
+
+//The contents of a board and nothing else: one bitboard of discs per player. It is plain
+//data, 16 bytes on the 8x8 board, so servers and batch jobs can hold huge numbers of
+//positions and copy them with memcpy. Drawing is left to Basic_renderer.
+template<int N>
+struct Basic_board_state {
+    Bits<N> p1;
+    Bits<N> p2;
+
+    //The standard starting position
+    static Basic_board_state start();
+    static Basic_board_state from_vec(const Board_vec &board);
+    Board_vec to_vec() const;
+
+    Piece at(int row, int col) const;
+    Bits<N> discs(Piece piece) const;
+    Bits<N> legal_moves(Piece piece) const;
+    bool is_legal(Piece piece, Position pos) const;
+    bool can_move(Piece piece) const;
+    bool game_over() const;
+    int count(Piece piece) const;
+
+    //Returns the number of discs flipped, 0 (with nothing changed) if the move is not legal
+    int play(Piece piece, Position pos);
+};
+
+typedef Basic_board_state<8> Board_state;
+
+static_assert(is_trivially_copyable<Board_state>::value, "Board states must be plain data");
+
+template<int N>
+Basic_board_state<N> Basic_board_state<N>::start() {
+    const int mid = N / 2;
+    Basic_board_state out;
+    out.p1 = square_bit<N>(mid - 1, mid) | square_bit<N>(mid, mid - 1);
+    out.p2 = square_bit<N>(mid - 1, mid - 1) | square_bit<N>(mid, mid);
+    return out;
+}
+
+template<int N>
+Basic_board_state<N> Basic_board_state<N>::from_vec(const Board_vec &board) {
+    Basic_board_state out;
+    to_bitboards<N>(board, Piece::P1, out.p1, out.p2);
+    return out;
+}
+
+template<int N>
+Board_vec Basic_board_state<N>::to_vec() const {
+    Board_vec out(N, vector<Piece>(N, Piece::EMPTY));
+    for(int row = 0; row < N; row++)
+        for(int col = 0; col < N; col++)
+            out[row][col] = at(row, col);
+
+    return out;
+}
+
+template<int N>
+Piece Basic_board_state<N>::at(int row, int col) const {
+    Bits<N> bit = square_bit<N>(row, col);
+    if(p1 & bit)
+        return Piece::P1;
+    if(p2 & bit)
+        return Piece::P2;
+    return Piece::EMPTY;
+}
+
+template<int N>
+Bits<N> Basic_board_state<N>::discs(Piece piece) const {
+    assert(piece != Piece::EMPTY);
+    return piece == Piece::P1 ? p1 : p2;
+}
+
+template<int N>
+Bits<N> Basic_board_state<N>::legal_moves(Piece piece) const {
+    return ::legal_moves<N>(discs(piece), discs(get_opponent(piece)));
+}
+
+template<int N>
+bool Basic_board_state<N>::is_legal(Piece piece, Position pos) const {
+    if(piece == Piece::EMPTY || pos.row >= N || pos.col >= N)
+        return false;
+    return (legal_moves(piece) & square_bit<N>(pos.row, pos.col)) != 0;
+}
+
+template<int N>
+bool Basic_board_state<N>::can_move(Piece piece) const {
+    return legal_moves(piece) != 0;
+}
+
+template<int N>
+bool Basic_board_state<N>::game_over() const {
+    return !can_move(Piece::P1) && !can_move(Piece::P2);
+}
+
+template<int N>
+int Basic_board_state<N>::count(Piece piece) const {
+    if(piece == Piece::EMPTY)
+        return N * N - count_bits(p1 | p2);
+    return count_bits(discs(piece));
+}
+
+template<int N>
+int Basic_board_state<N>::play(Piece piece, Position pos) {
+    assert(piece != Piece::EMPTY);
+
+    Bits<N> bit = square_bit<N>(pos.row, pos.col);
+    if((p1 | p2) & bit)
+        return 0;
+
+    Bits<N> &own = piece == Piece::P1 ? p1 : p2;
+    Bits<N> &opp = piece == Piece::P1 ? p2 : p1;
+    Bits<N> flips = flipped_discs<N>(own, opp, pos.row * N + pos.col);
+    if(!flips)
+        return 0;
+
+    own |= flips | bit;
+    opp &= ~flips;
+    return count_bits(flips);
+}
+
+
+#endif
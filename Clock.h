@@ -0,0 +1,317 @@
+#ifndef CLOCK_H_INCLUDED
+#define CLOCK_H_INCLUDED
+
+
+#include "Piece.h"
+#include "cmpt_error.h"
+
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+
+using namespace std;
+
+enum class Time_kind {
+    NONE,          //Untimed
+    SUDDEN_DEATH,  //A fixed amount of time for the whole game
+    FISCHER,       //Time for the whole game, with an increment added after each move
+    PER_MOVE       //A fixed amount of time for each move, unused time is lost
+};
+
+//How a game is timed. Times are in milliseconds.
+struct Time_control {
+    Time_kind kind = Time_kind::NONE;
+    int base = 0;       //Each player's time for the game, or for each move with PER_MOVE
+    int increment = 0;  //Added after each move with FISCHER
+
+    Time_control() {}
+
+    Time_control(Time_kind kind, int base, int increment = 0):
+    kind(kind),
+    base(base),
+    increment(increment)
+    {}
+
+    //Reads "none", "<minutes>" for sudden death, "<minutes>+<seconds>" for an increment or
+    //"<seconds>/move". Minutes and seconds may have fractions. Throws if the text is not one of these.
+    static Time_control parse(const string &text);
+};
+
+string to_string(const Time_control &control);
+
+//A clock for each player, only one of them running at a time as in a chess clock. The running
+//player's time is counted down as it is read, so running out of time is seen as soon as it
+//happens rather than when the move is finally made. With Time_kind::NONE nothing is counted
+//and no one runs out of time.
+class Chess_clock {
+private:
+    typedef chrono::steady_clock Steady_clock;
+
+    Time_control _control;
+    long long _remaining[2];  //Milliseconds, not counting the running player's current turn
+    Piece _running = Piece::EMPTY;
+    Steady_clock::time_point _started;
+    Piece _flagged = Piece::EMPTY;
+
+    static int index(Piece player);
+    long long running_ms() const;
+
+public:
+    explicit Chess_clock(const Time_control &control = Time_control());
+
+    const Time_control& control() const;
+    bool timed() const;
+
+    //Gives both players their full time again and stops the clock
+    void reset();
+    //Starts the given player's time. Does nothing if it is already running.
+    void start(Piece player);
+    //Stops the running player's time, adding the increment if the move was in time. Returns
+    //false if the player ran out of time before stopping, which ends the game.
+    bool stop();
+
+    //Milliseconds the player has left for this move, 0 once out of time
+    long long remaining(Piece player) const;
+    //The player who ran out of time, or Piece::EMPTY
+    Piece flagged() const;
+    //The time left as minutes and seconds, such as "4:59.2"
+    string time_string(Piece player) const;
+};
+
+//Plans how long a search may think about one move on a clock. The target is the fair share of
+//the remaining time for the moves still to be made, plus most of the increment, which comes back
+//after the move. The search may stretch past the target when the best move keeps changing from
+//one depth to the next, but never past the hard limit, which always leaves a reserve on the
+//clock for getting the move out.
+class Time_manager {
+private:
+    //Milliseconds kept back on every move for the time between the search and the clock
+    const static int MOVE_OVERHEAD = 30;
+    //The last few moves of the game are mostly solved or forced, so the time is shared out as if
+    //the game ended this many empties early, and never between fewer than MIN_MOVES_LEFT moves
+    const static int FAST_EMPTIES = 12;
+    const static int MIN_MOVES_LEFT = 3;
+    //The hard limit is at most this many targets, and at most this share of the remaining time
+    const double HARD_STRETCH = 5.0;
+    const double MAX_SHARE = 0.35;
+    //Instability raises the target up to this factor, and a stable best move lowers it again
+    const double MAX_INSTABILITY = 2.5;
+
+    double _target;   //Seconds
+    double _hard;     //Seconds
+    double _instability = 1.0;
+    double _last_depth_seconds = 0;
+    double _growth = 4.0;  //Time of each depth over the one before it, a cautious guess at first
+
+public:
+    //remaining is the player's time left in milliseconds, and empties the empty squares on the board
+    Time_manager(const Time_control &control, long long remaining, int empties);
+
+    double target() const;
+    double hard_limit() const;
+
+    //Records a completed depth of the search: its time, and whether it changed the best move
+    //or its value fell by enough to worry about
+    void depth_done(double depth_seconds, bool best_changed, bool value_dropped);
+    //Whether the next depth is worth starting after the given time: it should finish within
+    //the hard limit, and not start once most of the (stretched) target is used up
+    bool next_depth(double elapsed) const;
+};
+
+Time_control Time_control::parse(const string &text) {
+    string lower = text;
+    for(char &c: lower) c = tolower(c);
+
+    if(lower == "" || lower == "none")
+        return Time_control();
+
+    const char *start = lower.c_str();
+    char *end = nullptr;
+    double first = strtod(start, &end);
+    if(end == start || first <= 0)
+        cmpt::error("Cannot read the time control: " + text);
+
+    string rest = end;
+    if(rest == "")
+        return Time_control(Time_kind::SUDDEN_DEATH, int(first * 60000));
+    if(rest == "/move")
+        return Time_control(Time_kind::PER_MOVE, int(first * 1000));
+
+    if(rest[0] == '+') {
+        const char *inc_start = end + 1;
+        double increment = strtod(inc_start, &end);
+        if(end != inc_start && *end == '\0' && increment >= 0)
+            return Time_control(Time_kind::FISCHER, int(first * 60000), int(increment * 1000));
+    }
+
+    cmpt::error("Cannot read the time control: " + text);
+    return Time_control();
+}
+
+string to_string(const Time_control &control) {
+    char out[64];
+    switch(control.kind) {
+        case Time_kind::SUDDEN_DEATH:
+            snprintf(out, sizeof(out), "%g min each", control.base / 60000.0);
+            break;
+        case Time_kind::FISCHER:
+            snprintf(out, sizeof(out), "%g min each + %g s per move", control.base / 60000.0, control.increment / 1000.0);
+            break;
+        case Time_kind::PER_MOVE:
+            snprintf(out, sizeof(out), "%g s per move", control.base / 1000.0);
+            break;
+        default:
+            return "untimed";
+    }
+    return out;
+}
+
+//Chess_clock private methods
+
+int Chess_clock::index(Piece player) {
+    assert(player != Piece::EMPTY);
+    return player == Piece::P1 ? 0 : 1;
+}
+
+long long Chess_clock::running_ms() const {
+    if(_running == Piece::EMPTY)
+        return 0;
+    return chrono::duration_cast<chrono::milliseconds>(Steady_clock::now() - _started).count();
+}
+
+
+//Chess_clock public methods
+
+Chess_clock::Chess_clock(const Time_control &control):
+    _control(control)
+{
+    if(_control.base < 0 || _control.increment < 0)
+        cmpt::error("Times must not be negative");
+    reset();
+}
+
+const Time_control& Chess_clock::control() const {
+    return _control;
+}
+
+bool Chess_clock::timed() const {
+    return _control.kind != Time_kind::NONE;
+}
+
+void Chess_clock::reset() {
+    _remaining[0] = _remaining[1] = _control.base;
+    _running = Piece::EMPTY;
+    _flagged = Piece::EMPTY;
+}
+
+void Chess_clock::start(Piece player) {
+    if(!timed() || _running == player)
+        return;
+    if(_running != Piece::EMPTY)
+        stop();
+
+    //Time per move is not carried from one move to the next
+    if(_control.kind == Time_kind::PER_MOVE)
+        _remaining[index(player)] = _control.base;
+
+    _running = player;
+    _started = Steady_clock::now();
+}
+
+bool Chess_clock::stop() {
+    if(_running == Piece::EMPTY)
+        return _flagged == Piece::EMPTY;
+
+    long long &left = _remaining[index(_running)];
+    left -= running_ms();
+    if(left < 0) {
+        left = 0;
+        if(_flagged == Piece::EMPTY)
+            _flagged = _running;
+    } else if(_control.kind == Time_kind::FISCHER) {
+        left += _control.increment;
+    }
+
+    bool in_time = _flagged != _running;
+    _running = Piece::EMPTY;
+    return in_time;
+}
+
+long long Chess_clock::remaining(Piece player) const {
+    if(!timed())
+        return LLONG_MAX;
+
+    long long left = _remaining[index(player)];
+    if(_running == player)
+        left -= running_ms();
+    return max(0LL, left);
+}
+
+Piece Chess_clock::flagged() const {
+    if(_flagged == Piece::EMPTY && _running != Piece::EMPTY && remaining(_running) == 0)
+        return _running;
+    return _flagged;
+}
+
+string Chess_clock::time_string(Piece player) const {
+    long long tenths = remaining(player) / 100;
+    char out[32];
+    snprintf(out, sizeof(out), "%lld:%02lld.%lld", tenths / 600, tenths / 10 % 60, tenths % 10);
+    return out;
+}
+
+
+//Time_manager public methods
+
+Time_manager::Time_manager(const Time_control &control, long long remaining, int empties) {
+    double left = max(0LL, remaining - MOVE_OVERHEAD) / 1000.0;
+
+    if(control.kind == Time_kind::PER_MOVE) {
+        //Time that is not used is lost, so most of it is used on every move
+        _hard = left;
+        _target = left * 0.6;
+        return;
+    }
+
+    //The player makes about half of the moves left, which also keeps the overhead of each in reserve
+    int moves_left = MIN_MOVES_LEFT + max(0, empties - FAST_EMPTIES) / 2;
+    double increment = control.kind == Time_kind::FISCHER ? control.increment / 1000.0 : 0;
+    double reserve = moves_left * MOVE_OVERHEAD / 1000.0;
+
+    _target = max(0.0, left - reserve) / moves_left + 0.8 * increment;
+    _hard = min(_target * HARD_STRETCH, left * MAX_SHARE + 0.8 * increment);
+    _hard = min(max(_hard, _target), left);
+    _target = min(_target, _hard);
+}
+
+double Time_manager::target() const {
+    return _target * _instability;
+}
+
+double Time_manager::hard_limit() const {
+    return _hard;
+}
+
+void Time_manager::depth_done(double depth_seconds, bool best_changed, bool value_dropped) {
+    //Depths that are too quick to time well say little about the next one
+    if(_last_depth_seconds >= 0.005)
+        _growth = min(8.0, max(1.5, depth_seconds / _last_depth_seconds));
+    _last_depth_seconds = depth_seconds;
+
+    if(best_changed || value_dropped)
+        _instability = min(MAX_INSTABILITY, _instability * 1.5);
+    else
+        _instability = max(1.0, _instability * 0.8);
+}
+
+bool Time_manager::next_depth(double elapsed) const {
+    double predicted = elapsed + _last_depth_seconds * _growth;
+    return predicted <= _hard && elapsed <= 0.6 * target();
+}
+
+
+#endif
@@ -4,12 +4,24 @@
 
 #include "Board.h"
 #include "Player.h"
+#include "Transposition_table.h"
+#include "Bitboard.h"
+#include "Network.h"
+#include "Endgame_solver.h"
 
 #include <string>
 #include <iostream>
 #include <algorithm>
 #include <utility>
 #include <climits>
+#include <functional>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <poll.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -40,8 +52,107 @@ struct Possibility {
 
 };
 
-class Computer_player : public Player {
+//The result of analysing a single legal move: its value, how deep it was
+//searched and the line of play the search expects to follow it.
+struct Move_analysis {
+    Position pos;
+    int value;
+    int depth;  //Number of moves searched ahead, ignored if exact is set
+    bool exact;  //Set when the game was searched all the way to the end
+    vector<Position> line;  //Principal variation, starting with pos
+};
+
+typedef function<void(const vector<Move_analysis>&)> Analysis_report;
+
+//A batch of 8x8 positions to evaluate at once. The positions are kept as a structure of
+//arrays, the discs of the player each position is valued for in one array and the
+//opponent's discs in the other, so consecutive positions can be loaded into vector registers.
+struct Position_batch {
+    vector<Bitboard> own;
+    vector<Bitboard> opp;
+
+    void add(const Board_vec &board, Piece piece);
+    void add(Bitboard own_discs, Bitboard opp_discs);
+
+    size_t size() const;
+    void clear();
+};
+
+//Turns a search value into a readable score. Finished game values are shown
+//as the final margin, anything else as the raw evaluation. A draw has the value
+//0, so it can only be told apart from an even evaluation when the value is exact.
+string value_string(int value, bool exact = false) {
+    if(exact && value == 0)
+        return "Draw";
+    if(value >= INT_MAX / 4)
+        return "Win by " + to_string(value - INT_MAX / 2);
+    if(value <= INT_MIN / 4)
+        return "Loss by " + to_string(-(INT_MAX / 2) - value);
+
+    return to_string(value);
+}
+
+//Multi-ProbCut models the value of a deep search as a linear function of a much
+//shallower search of the same position: deep = slope * shallow + intercept, with
+//normally distributed error sigma. When the shallow result makes it sufficiently
+//unlikely that the deep search would land inside the alpha-beta window, the deep
+//search is skipped. Entries are indexed by the remaining depth of the deep search,
+//and were generated by the probcut_calibrate program from self-play positions.
+struct Probcut_fit {
+    int shallow_depth;
+    double slope;
+    double intercept;
+    double sigma;
+};
+
+const static int PROBCUT_MIN_DEPTH = 3;
+const static Probcut_fit PROBCUT_FITS[] = {
+    {0, 0, 0, 0},
+    {0, 0, 0, 0},
+    {0, 0, 0, 0},
+    {1, 1.066, 5.297, 25.374},
+    {2, 1.077, -1.686, 35.556},
+    {2, 1.120, 27.366, 39.282},
+    {3, 1.124, -32.143, 36.528},
+    {3, 1.162, -3.724, 41.549},
+    {4, 1.153, 3.480, 37.767}
+};
+
+const static int PROBCUT_MAX_DEPTH = sizeof(PROBCUT_FITS) / sizeof(PROBCUT_FITS[0]) - 1;
+
+//Predicts how many nodes solving a position to the end takes, as
+//ln(nodes) = intercept + per_empty * empties + per_log_mobility * ln(mobility + 1),
+//with mobility being the number of moves of the player to move. A win/loss/draw solve
+//only searches a window around a draw and takes wld_fraction as many nodes. Generated
+//by the solve_calibrate program from self-play positions.
+struct Solve_cost_fit {
+    double intercept;
+    double per_empty;
+    double per_log_mobility;
+    double wld_fraction;
+};
+
+const static Solve_cost_fit SOLVE_COST = {-1.100, 0.805, 0.928, 0.034};
+
+//The kinds of search to the end, chosen by the predicted cost of each
+enum class Solve {
+    NONE, WIN_LOSS_DRAW, EXACT
+};
+
+//How many standard deviations the shallow result must be outside the window
+//before a cut is made, for each selectivity level. Level 0 turns Multi-ProbCut
+//off, higher levels cut more often and search faster at the cost of accuracy.
+const static double PROBCUT_THRESHOLDS[] = {0, 2.0, 1.5, 1.0, 0.6};
+const static int PROBCUT_LEVELS = sizeof(PROBCUT_THRESHOLDS) / sizeof(PROBCUT_THRESHOLDS[0]);
+
+//The search is a template on the board size, so each size gets a search specialized for
+//its own board. The position weights, stability and Multi-ProbCut fits were made for the
+//standard 8x8 board, and are stretched to or disabled on other sizes.
+template<int N>
+class Basic_computer_player : public Player {
 private:
+    typedef Basic_board<N> Board;
+
     Piece _piece;
     //The computer player must store a pointer to the game board in order to be able to choose a position to play
     //based on the current board state
@@ -51,6 +162,55 @@ private:
     bool _wait;
 
     mutable bool _search_to_end = false;
+    mutable int _depth_limit = 0;  //The depth at which the current search stops
+
+    //Remaining depth recorded in the cache for values found by searching to the end
+    const static int END_DEPTH = N * N;
+    mutable Transposition_table _cache;
+
+    int _selectivity = 0;
+    mutable bool _in_probcut = false;  //Set while a shallow Multi-ProbCut search is running
+
+    //When set, positions are evaluated by the network instead of the position weights.
+    //The accumulator follows the board through the search, updated as moves are played
+    //and taken back, so it always matches the position being searched.
+    const Network *_network = nullptr;
+    mutable Network::Accumulator _accumulator;
+
+    //A search can be cut short by stop() from another thread or by the time limit. Both are
+    //only checked every POLL_INTERVAL nodes, as reading the clock costs far more than a node.
+    //Once a search is aborted every node returns at once, and nothing more is cached.
+    mutable atomic<bool> _stop{false};
+    int _time_limit = 0;  //In milliseconds, 0 for no limit
+    long long _node_limit = 0;  //0 for no limit
+    //Set to leave out everything that depends on timing (see set_deterministic)
+    bool _deterministic = false;
+    mutable chrono::steady_clock::time_point _deadline;  //time_point::max() for no limit
+
+    //On a clock, each move is planned by a Time_manager: the search deepens while the plan
+    //allows, past the fixed depth, and its hard limit becomes the deadline
+    const Chess_clock *_clock = nullptr;
+    //A best move whose value falls by this much from one depth to the next is unstable
+    const static int UNSTABLE_DROP = 24;
+    mutable long long _nodes = 0;
+    mutable bool _aborted = false;
+    const static int POLL_INTERVAL = 1024;
+
+    //The searches to the end are chosen by predicted time when a solve budget is set (see
+    //set_solve_budget), using the speed measured over recent searches
+    int _solve_budget = 0;  //In milliseconds, 0 to use the fixed _end_game_depth instead
+    mutable double _nodes_per_second = 40000;  //A cautious guess until a search is timed
+    mutable long long _last_nodes = 0;
+    mutable chrono::steady_clock::time_point _start;
+    mutable Move_analysis _last_move;
+
+    //Solves on the 8x8 board are handed to the bitboard solver, which shares the tree
+    //between threads. Its nodes are far cheaper than the search's, so its speed is kept apart.
+    //The solver code is picked by overloading on this, so it is only compiled for 8x8 boards.
+    const static bool USE_SOLVER = N == 8;
+    typedef integral_constant<bool, USE_SOLVER> Solver_tag;
+    mutable Endgame_solver _solver;
+    mutable double _solve_nodes_per_second = 1500000;  //A cautious guess until a solve is timed
 
     string _name;
 
@@ -61,12 +221,66 @@ private:
         {  8,  -4,   7,   4},
         {  6,  -3,   4,   0}
     };
+    //Bonus for each disc that can never be flipped, on top of its position weight
+    const int STABLE_WEIGHT = 10;
+    const static bool USE_STABILITY = N == 8;
+    //The Multi-ProbCut fits only hold for the evaluation's values on the 8x8 board
+    const static bool USE_PROBCUT = N == 8;
 
-    Possibility search(const Board_vec &board_state, Piece piece, int beta=INT_MAX, int alpha=INT_MIN, int depth=1) const;
+    //Batches smaller than this per thread are not worth starting a thread for
+    const static size_t MIN_THREAD_BATCH = 4096;
+
+    Possibility search(const Board_vec &board_state, Piece piece, int beta=INT_MAX, int alpha=-INT_MAX, int depth=1) const;
     inline int evaluate(const Board_vec &board_vec, Piece piece) const;
+    //The position value grid entry for a square, before any corners are taken
+    int square_weight(int row, int col) const;
+    //The position value grid grouped into classes of squares with the same weight
+    Square_classes weight_classes() const;
+    //Evaluates positions begin to end - 1 of a batch
+    void evaluate_range(const Position_batch &positions, const Square_classes &classes, int scores[], size_t begin, size_t end) const;
+    //The value of a finished game won (or lost, if negative) by the given margin of pieces
+    static int end_value(int margin);
+
+    //Recomputes the network accumulator for the position a search starts from
+    void reset_accumulator(const Board_vec &board_state) const;
+
+    //Clears the stop flag and starts the time limit for a new search
+    void start_clock() const;
+    //Records the nodes searched since start_clock, and folds the speed into the average
+    void stop_clock() const;
+
+    //Searches the position to the end, with the bitboard solver where it is available.
+    //A win/loss/draw solve only searches a window around a draw.
+    Possibility solve_to_end(const Board_vec &board_state, Piece piece, Solve solve) const;
+    Possibility solve_to_end(const Board_vec &board_state, Piece piece, Solve solve, true_type) const;
+    Possibility solve_to_end(const Board_vec &board_state, Piece piece, Solve solve, false_type) const;
+    //Fills in the exact value and line of a move analysed to the end, from the position after
+    //it with piece to move
+    void analyze_to_end(const Board_vec &board_next, Piece piece, Move_analysis &analysis, true_type) const;
+    void analyze_to_end(const Board_vec &board_next, Piece piece, Move_analysis &analysis, false_type) const;
+
+    //Chooses between searching to the end and the midgame search for the root position. On a
+    //clock, clock_budget is the most time in seconds the move may take.
+    Solve choose_solve(const Board_vec &board_state, Piece piece, double clock_budget = 0) const;
+    //Sets _aborted if the search has been stopped or has run out of time
+    bool check_stop() const;
+
+    //Deepens the search one move at a time and returns the best move of the deepest search
+    //that finished, so a stopped search still has a move to play
+    Position think() const;
+    //Runs think on another thread while reading commands typed at the terminal. STOP makes the
+    //computer play the best move found so far, other commands stop the search and are returned.
+    string think_interruptible(Position &best) const;
+
+    //Runs the shallow Multi-ProbCut searches for a node. Returns true and sets value to the
+    //bound that was proven if the deep search can be skipped.
+    bool probcut(const Board_vec &board_state, Piece piece, int beta, int alpha, int depth, int &value) const;
+
+    //Follows the cached best moves from a position to rebuild the expected line of play
+    vector<Position> principal_variation(Board_vec board_state, Piece piece, Position first, int max_length) const;
 
 public:
-    Computer_player(Piece piece, const Board *board, int max_depth = 7, int end_game_depth = 12, bool wait=true, string name="Robo"):
+    Basic_computer_player(Piece piece, const Board *board, int max_depth = 7, int end_game_depth = 12, bool wait=true, string name="Robo"):
     _piece(piece),
     _board(board),
     _max_depth(max_depth),
@@ -77,22 +291,124 @@ public:
 
     string move() const;
     string name() const;
+
+    //Scores every legal move for the given player on the current board, best first.
+    //The search deepens one move at a time, and report (if set) is called with the
+    //full ranking each time a depth is completed.
+    vector<Move_analysis> analyze(Piece piece, const Analysis_report &report = nullptr) const;
+
+    //Sets the Multi-ProbCut selectivity level, from 0 (off) to PROBCUT_LEVELS - 1.
+    //Only the search on the 8x8 board uses it.
+    void set_selectivity(int level);
+
+    //Stops the current search as soon as possible. Safe to call from any thread. A stopped
+    //move plays the best move found so far, and a stopped analysis keeps the depths it finished.
+    void stop() const;
+    //Limits every move and analysis to the given time (0 for no limit)
+    void set_time_limit(int milliseconds);
+    //Limits every move and analysis to about the given number of nodes (0 for no limit).
+    //Solves are only started when their predicted size fits.
+    void set_node_limit(long long nodes);
+    //Plans each move from the time this player has left on the clock (null for no clock). The
+    //time limit still applies, and the fixed depth is only used when there is no clock.
+    void set_clock(const Chess_clock *clock);
+    //In deterministic mode a search depends only on the position, the settings and what is in
+    //the cache, so it always plays the same move with the same value and node count. The time
+    //limit, clock and solve budget are ignored, leaving the depth and node limit to end the
+    //search and the fixed end game depth to start solves, and the end game solver splits its
+    //work the same way every time (see Endgame_solver.h). Meant for benchmarks: a change in
+    //the node count is then a change in the search rather than noise.
+    void set_deterministic(bool deterministic);
+
+    //Replaces the fixed end game depth with a prediction of how long solving each position
+    //would take. An exact solve is started when it should finish within the budget, a
+    //win/loss/draw solve when only that should, and the midgame search is used otherwise.
+    //The budget is also capped by the time limit. 0 returns to the fixed end game depth.
+    void set_solve_budget(int milliseconds);
+    //Predicted time in seconds to solve the position exactly, at the measured search speed
+    double predicted_solve_time(const Board_vec &board_state, Piece piece) const;
+    //Predicted number of nodes to solve the position exactly
+    double predicted_solve_nodes(const Board_vec &board_state, Piece piece) const;
+    //The number of threads the end game solver uses (0 for every core)
+    void set_solver_threads(int threads);
+    //Where the end game solver's threads run and how its table is allocated (see Numa.h)
+    void set_solver_placement(const Placement &placement);
+
+    //Evaluates positions with the given network (or the position weights again if null).
+    //Only available on the 8x8 board. The Multi-ProbCut fits were made for the position
+    //weights, so the selectivity level is ignored while a network is set.
+    void set_network(const Network *network);
+
+    //Returns the value of a position for the given player, searched the given number of moves ahead.
+    //Used to gather data for calibrating the search.
+    int search_value(const Board_vec &board_state, Piece piece, int depth) const;
+    //Returns the value of a position searched to the end of the game, or for a win/loss/draw
+    //solve, a value that is only as good as a win, draw or loss. Used for calibration.
+    int solve_value(const Board_vec &board_state, Piece piece, Solve solve = Solve::EXACT) const;
+    //Nodes searched by the last move, analysis or value search
+    long long last_nodes() const;
+    //The move chosen by the last call to move(), with its value and how deep it was searched
+    Move_analysis last_move() const;
+
+    //Changes the player the computer moves for
+    void set_piece(Piece piece);
+    //Changes the number of moves the midgame search looks ahead
+    void set_depth(int max_depth);
+    //Positions with this many empty squares or fewer are solved exactly when there is no
+    //solve budget or clock to choose by, and always in deterministic mode (0 never solves)
+    void set_end_game_depth(int empties);
+    //Replaces the cache with an empty one of 2^size_bits entries
+    void set_cache_size(int size_bits);
+    void clear_cache();
+
+    //Sets scores[i] to the evaluation of position i, exactly as the search would value it.
+    //Large batches are split between threads (0 uses every core). Only for the 8x8 board.
+    //With a network set, the positions are run through it one at a time instead of the kernel.
+    void evaluate_batch(const Position_batch &positions, int scores[], int threads = 0) const;
 };
 
-string Computer_player::move() const {
-    if(!_board->can_move(_piece))
-        return "";
+typedef Basic_computer_player<8> Computer_player;
 
-    if(_board->count_pieces(Piece::EMPTY) <= _end_game_depth)
-        _search_to_end = true;
+void Position_batch::add(const Board_vec &board, Piece piece) {
+    Bitboard own_discs, opp_discs;
+    to_bitboards(board, piece, own_discs, opp_discs);
+    add(own_discs, opp_discs);
+}
 
-    Possibility poss = search(_board->get_board_vec(), _piece);
+void Position_batch::add(Bitboard own_discs, Bitboard opp_discs) {
+    own.push_back(own_discs);
+    opp.push_back(opp_discs);
+}
 
-    _search_to_end = false;
+size_t Position_batch::size() const {
+    return own.size();
+}
+
+void Position_batch::clear() {
+    own.clear();
+    opp.clear();
+}
+
+template<int N>
+string Basic_computer_player<N>::move() const {
+    if(!_board->can_move(_piece))
+        return "";
+
+    //Commands can only be typed during the search when someone is at the terminal, scripted
+    //input is left for the game to read
+    Position best;
+    if(_wait && isatty(STDIN_FILENO)) {
+        string command = think_interruptible(best);
+        if(command != "")
+            return command;
+    } else {
+        best = think();
+    }
 
-    string out = to_string(poss.pos);
+    string out = to_string(best);
 
-    if(_wait) {
+    //On a clock, waiting for enter would use up the computer's own time
+    if(_wait && !(_clock && _clock->timed())) {
         cout << "(Ready... hit enter)";
         string trash;
         getline(cin, trash);
@@ -103,10 +419,464 @@ string Computer_player::move() const {
 
 
 
-string Computer_player::name() const {
+template<int N>
+Position Basic_computer_player<N>::think() const {
+    Board_vec board_state = _board->get_board_vec();
+    start_clock();
+    reset_accumulator(board_state);
+
+    //Played if the search is stopped before even the first depth is done
+    Position best = Board::get_legal_positions(board_state, _piece).front();
+    _last_move = Move_analysis{best, 0, 0, false, {}};
+
+    int empties = Board::count_pieces(board_state, Piece::EMPTY);
+    bool timed = _clock && _clock->timed() && !_deterministic;
+    Time_manager plan(timed ? _clock->control() : Time_control(), timed ? _clock->remaining(_piece) : 0, empties);
+    if(timed)
+        _deadline = min(_deadline, _start + chrono::microseconds((long long)(plan.hard_limit() * 1e6)));
+
+    //Before a solve, the shallower searches only provide a fallback move (and cached best
+    //moves to search first) in case the solve runs out of time or only proves a loss
+    Solve solve = choose_solve(board_state, _piece, timed ? plan.hard_limit() : 0);
+    int last_limit = solve != Solve::NONE ? _max_depth / 2 : timed ? empties + 1 : _max_depth;
+
+    _search_to_end = false;
+    auto depth_start = _start;
+    for(_depth_limit = 2; _depth_limit <= last_limit && !_aborted; _depth_limit++) {
+        Possibility poss = search(board_state, _piece);
+        if(_aborted)
+            break;
+
+        bool changed = _depth_limit > 2 && (poss.pos.row != best.row || poss.pos.col != best.col);
+        bool dropped = _depth_limit > 2 && poss.value <= _last_move.value - UNSTABLE_DROP;
+        best = poss.pos;
+        _last_move = Move_analysis{best, poss.value, _depth_limit - 1, false, {}};
+
+        if(timed && solve == Solve::NONE) {
+            auto now = chrono::steady_clock::now();
+            plan.depth_done(chrono::duration<double>(now - depth_start).count(), changed, dropped);
+            depth_start = now;
+            if(!plan.next_depth(chrono::duration<double>(now - _start).count()))
+                break;
+        }
+    }
+
+    if(solve != Solve::NONE && !_aborted) {
+        //A window just around a draw only tells wins, draws and losses apart. A move that
+        //wins or draws is played, but when every move loses the midgame choice is kept, as
+        //it is more likely to lose by less.
+        Possibility poss = solve_to_end(board_state, _piece, solve);
+        if(!_aborted && (solve == Solve::EXACT || poss.value >= end_value(0))) {
+            best = poss.pos;
+            _last_move = Move_analysis{best, poss.value, END_DEPTH, solve == Solve::EXACT, {}};
+        }
+    }
+
+    stop_clock();
+    return best;
+}
+
+template<int N>
+string Basic_computer_player<N>::think_interruptible(Position &best) const {
+    atomic<bool> done{false};
+    thread worker([&] {
+        best = think();
+        done = true;
+    });
+
+    string command;
+    pollfd input = {STDIN_FILENO, POLLIN, 0};
+    while(!done) {
+        bool typed = cin.rdbuf()->in_avail() > 0 || poll(&input, 1, 50) > 0;
+        if(!typed || done)
+            continue;
+
+        string line;
+        if(!getline(cin, line))
+            break;
+        for(char &c: line) c = toupper(c);
+
+        if(line == "STOP") {
+            stop();
+        } else if(line != "" && all_of(line.begin(), line.end(), [](char c) {return isalpha(c);})) {
+            command = line;
+            stop();
+        } else if(line != "") {
+            cout << "Please wait for " << _name << " to move, or type \"STOP\" to make it move now" << endl;
+        }
+    }
+
+    worker.join();
+    return command;
+}
+
+template<int N>
+string Basic_computer_player<N>::name() const {
     return _name;
 }
 
+template<int N>
+vector<Move_analysis> Basic_computer_player<N>::analyze(Piece piece, const Analysis_report &report) const {
+    vector<Move_analysis> results;
+
+    Board_vec board_state = _board->get_board_vec();
+    if(!Board::can_move(board_state, piece))
+        return results;
+
+    //Solved the same way as a move would be, by the budget or the fixed end game depth. Only
+    //exact values are any use for a ranking, so a win/loss/draw solve is not enough.
+    _search_to_end = choose_solve(board_state, piece) == Solve::EXACT;
+    start_clock();
+
+    //Every root move is searched with a full window to get its exact value. This would
+    //be wasteful on its own, but positions shared between the root moves and between
+    //depths are found in the cache instead of being searched again.
+    int first_limit = _search_to_end ? _max_depth : 2;
+    for(_depth_limit = first_limit; _depth_limit <= _max_depth; _depth_limit++) {
+        vector<Move_analysis> depth_results;
+
+        for(Position pos: Board::get_legal_positions(board_state, piece)) {
+            Board_vec board_next = board_state;
+            Board::play(board_next, piece, pos);
+
+            Move_analysis analysis;
+            analysis.pos = pos;
+            analysis.depth = _depth_limit - 1;
+            analysis.exact = _search_to_end;
+
+            if(_search_to_end) {
+                analyze_to_end(board_next, get_opponent(piece), analysis, Solver_tag());
+            } else {
+                reset_accumulator(board_next);
+                analysis.value = -1 * search(board_next, get_opponent(piece), INT_MAX, -INT_MAX, 2).value;
+                analysis.line = principal_variation(board_next, get_opponent(piece), pos, analysis.depth);
+            }
+
+            depth_results.push_back(analysis);
+        }
+
+        if(_aborted)
+            break;
+        results = depth_results;
+
+        stable_sort(results.begin(), results.end(),
+        [](const Move_analysis &a, const Move_analysis &b)
+        {return a.value > b.value;}
+        );
+
+        if(report)
+            report(results);
+    }
+
+    _search_to_end = false;
+    stop_clock();
+
+    return results;
+}
+
+template<int N>
+void Basic_computer_player<N>::set_selectivity(int level) {
+    if(level < 0 || level >= PROBCUT_LEVELS)
+        cmpt::error("Selectivity level out of range");
+
+    _selectivity = level;
+}
+
+template<int N>
+void Basic_computer_player<N>::stop() const {
+    _stop = true;
+}
+
+template<int N>
+void Basic_computer_player<N>::set_time_limit(int milliseconds) {
+    _time_limit = milliseconds;
+}
+
+template<int N>
+void Basic_computer_player<N>::set_node_limit(long long nodes) {
+    _node_limit = max(0LL, nodes);
+}
+
+template<int N>
+void Basic_computer_player<N>::set_clock(const Chess_clock *clock) {
+    _clock = clock;
+}
+
+template<int N>
+void Basic_computer_player<N>::set_deterministic(bool deterministic) {
+    _deterministic = deterministic;
+    _solver.set_deterministic(deterministic);
+}
+
+template<int N>
+void Basic_computer_player<N>::set_solve_budget(int milliseconds) {
+    _solve_budget = milliseconds;
+}
+
+template<int N>
+double Basic_computer_player<N>::predicted_solve_time(const Board_vec &board_state, Piece piece) const {
+    double nodes = predicted_solve_nodes(board_state, piece);
+    return nodes / (USE_SOLVER ? _solve_nodes_per_second : _nodes_per_second);
+}
+
+template<int N>
+double Basic_computer_player<N>::predicted_solve_nodes(const Board_vec &board_state, Piece piece) const {
+    int empties = Board::count_pieces(board_state, Piece::EMPTY);
+    int mobility = Board::count_legal_positions(board_state, piece);
+
+    return exp(SOLVE_COST.intercept + SOLVE_COST.per_empty * empties + SOLVE_COST.per_log_mobility * log(mobility + 1.0));
+}
+
+template<int N>
+void Basic_computer_player<N>::set_solver_threads(int threads) {
+    _solver.set_threads(threads);
+}
+
+template<int N>
+void Basic_computer_player<N>::set_solver_placement(const Placement &placement) {
+    _solver.set_placement(placement);
+}
+
+template<int N>
+Possibility Basic_computer_player<N>::solve_to_end(const Board_vec &board_state, Piece piece, Solve solve) const {
+    return solve_to_end(board_state, piece, solve, Solver_tag());
+}
+
+template<int N>
+Possibility Basic_computer_player<N>::solve_to_end(const Board_vec &board_state, Piece piece, Solve solve, false_type) const {
+    const int draw = end_value(0);
+
+    _search_to_end = true;
+    _depth_limit = _max_depth;
+    Possibility poss = solve == Solve::EXACT ?
+        search(board_state, piece) : search(board_state, piece, draw + 1, draw - 1);
+    _search_to_end = false;
+    return poss;
+}
+
+template<int N>
+Possibility Basic_computer_player<N>::solve_to_end(const Board_vec &board_state, Piece piece, Solve solve, true_type) const {
+    Bitboard own, opp;
+    to_bitboards(board_state, piece, own, opp);
+
+    //The solver works in disc margins, the search's end values only add a constant to them
+    int alpha = solve == Solve::EXACT ? -N * N - 1 : -1;
+    int beta = solve == Solve::EXACT ? N * N + 1 : 1;
+
+    //The solver counts its own nodes, so it gets what is left of the limit
+    _solver.set_node_limit(_node_limit > 0 ? max(1LL, _node_limit - _nodes) : 0);
+
+    auto start = chrono::steady_clock::now();
+    int square;
+    int margin = _solver.solve(own, opp, alpha, beta, square, _stop, _deadline);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    _nodes += _solver.last_nodes();
+    if(_solver.aborted())
+        _aborted = true;
+    else if(seconds >= 0.05)
+        _solve_nodes_per_second = 0.5 * _solve_nodes_per_second + 0.5 * (_solver.last_nodes() / seconds);
+
+    Possibility poss(end_value(margin));
+    if(square < N * N)
+        poss.pos = square_position(square);
+    return poss;
+}
+
+template<int N>
+void Basic_computer_player<N>::analyze_to_end(const Board_vec &board_next, Piece piece, Move_analysis &analysis, false_type) const {
+    reset_accumulator(board_next);
+    analysis.value = -1 * search(board_next, piece, INT_MAX, -INT_MAX, 2).value;
+    analysis.line = principal_variation(board_next, piece, analysis.pos, END_DEPTH);
+}
+
+template<int N>
+void Basic_computer_player<N>::analyze_to_end(const Board_vec &board_next, Piece piece, Move_analysis &analysis, true_type) const {
+    //The solver keeps its table between solves, so the moves share their subtrees as they
+    //would in the cache
+    analysis.value = -1 * solve_to_end(board_next, piece, Solve::EXACT).value;
+
+    Bitboard own, opp;
+    to_bitboards(board_next, piece, own, opp);
+    analysis.line = {analysis.pos};
+    for(int square: _solver.best_line(own, opp, END_DEPTH))
+        analysis.line.push_back(square_position(square));
+}
+
+template<int N>
+Solve Basic_computer_player<N>::choose_solve(const Board_vec &board_state, Piece piece, double clock_budget) const {
+    //The predicted time of a solve comes from the measured speed, which varies from run to run
+    Solve solve = Solve::NONE;
+    if((_solve_budget <= 0 && clock_budget <= 0) || _deterministic) {
+        if(Board::count_pieces(board_state, Piece::EMPTY) <= _end_game_depth)
+            solve = Solve::EXACT;
+    } else {
+        //A solve saves the time of every move after it, so on a clock it may take the whole
+        //hard limit of the move in place of the solve budget
+        double budget = clock_budget > 0 ? clock_budget : _solve_budget / 1000.0;
+        if(_time_limit > 0)
+            budget = min(budget, _time_limit / 1000.0);
+
+        double seconds = predicted_solve_time(board_state, piece);
+        if(seconds <= budget)
+            solve = Solve::EXACT;
+        else if(seconds * SOLVE_COST.wld_fraction <= budget)
+            solve = Solve::WIN_LOSS_DRAW;
+    }
+
+    //A solve that would run into the node limit would only be wasted
+    if(_node_limit > 0 && solve != Solve::NONE) {
+        double nodes = predicted_solve_nodes(board_state, piece);
+        if(nodes * SOLVE_COST.wld_fraction > _node_limit)
+            solve = Solve::NONE;
+        else if(nodes > _node_limit)
+            solve = Solve::WIN_LOSS_DRAW;
+    }
+
+    return solve;
+}
+
+template<int N>
+void Basic_computer_player<N>::set_network(const Network *network) {
+    if(network && N != 8)
+        cmpt::error("The network evaluator is only available on the 8x8 board");
+
+    _network = network;
+    _cache.clear();
+}
+
+template<int N>
+int Basic_computer_player<N>::search_value(const Board_vec &board_state, Piece piece, int depth) const {
+    _search_to_end = false;
+    _depth_limit = depth + 1;
+
+    start_clock();
+    reset_accumulator(board_state);
+    int value = search(board_state, piece).value;
+    stop_clock();
+
+    return value;
+}
+
+template<int N>
+int Basic_computer_player<N>::solve_value(const Board_vec &board_state, Piece piece, Solve solve) const {
+    start_clock();
+    reset_accumulator(board_state);
+    int value = solve_to_end(board_state, piece, solve).value;
+    stop_clock();
+
+    return value;
+}
+
+template<int N>
+long long Basic_computer_player<N>::last_nodes() const {
+    return _last_nodes;
+}
+
+template<int N>
+Move_analysis Basic_computer_player<N>::last_move() const {
+    return _last_move;
+}
+
+template<int N>
+void Basic_computer_player<N>::set_piece(Piece piece) {
+    _piece = piece;
+}
+
+template<int N>
+void Basic_computer_player<N>::set_depth(int max_depth) {
+    if(max_depth < 1)
+        cmpt::error("Search depth must be at least 1");
+
+    _max_depth = max_depth;
+}
+
+template<int N>
+void Basic_computer_player<N>::set_end_game_depth(int empties) {
+    if(empties < 0)
+        cmpt::error("End game depth cannot be negative");
+
+    _end_game_depth = empties;
+}
+
+template<int N>
+void Basic_computer_player<N>::set_cache_size(int size_bits) {
+    if(size_bits < 10 || size_bits > 30)
+        cmpt::error("Cache size out of range");
+
+    _cache = Transposition_table(size_bits);
+}
+
+template<int N>
+void Basic_computer_player<N>::clear_cache() {
+    _cache.clear();
+    _solver.clear();
+}
+
+template<int N>
+void Basic_computer_player<N>::start_clock() const {
+    _stop = false;
+    _aborted = false;
+    _nodes = 0;
+    _start = chrono::steady_clock::now();
+    _deadline = _time_limit > 0 && !_deterministic ? _start + chrono::milliseconds(_time_limit) : chrono::steady_clock::time_point::max();
+}
+
+template<int N>
+void Basic_computer_player<N>::stop_clock() const {
+    _last_nodes = _nodes;
+
+    //Very short searches are mostly overhead, and would make the speed look lower than it is
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - _start).count();
+    if(seconds >= 0.05)
+        _nodes_per_second = 0.5 * _nodes_per_second + 0.5 * (_nodes / seconds);
+}
+
+template<int N>
+bool Basic_computer_player<N>::check_stop() const {
+    if(_stop || (_deadline != chrono::steady_clock::time_point::max() && chrono::steady_clock::now() >= _deadline) ||
+        (_node_limit > 0 && _nodes >= _node_limit))
+        _aborted = true;
+
+    return _aborted;
+}
+
+template<int N>
+void Basic_computer_player<N>::reset_accumulator(const Board_vec &board_state) const {
+    if(!_network)
+        return;
+
+    Bitboard p1, p2;
+    to_bitboards(board_state, Piece::P1, p1, p2);
+    _network->refresh(_accumulator, p1, p2);
+}
+
+template<int N>
+vector<Position> Basic_computer_player<N>::principal_variation(Board_vec board_state, Piece piece, Position first, int max_length) const {
+    vector<Position> line = {first};
+
+    while(int(line.size()) < max_length && !Board::game_over(board_state)) {
+        if(!Board::can_move(board_state, piece)) {
+            piece = get_opponent(piece);
+            continue;
+        }
+
+        Cache_entry entry;
+        if(!_cache.probe(Transposition_table::hash<N>(board_state, piece), entry))
+            break;
+        if(entry.best.row >= N || entry.best.col >= N)
+            break;
+        if(!Board::count_move(board_state, piece, entry.best))
+            break;
+
+        line.push_back(entry.best);
+        Board::play(board_state, piece, entry.best);
+        piece = get_opponent(piece);
+    }
+
+    return line;
+}
+
 
 //This function uses the negamax algorithm to decide on a move based on a computed value for a given board state.
 //It uses alpha-beta pruning to eliminate many search patchs and dramatically reduce the search time.
@@ -114,14 +884,21 @@ string Computer_player::name() const {
 //first in the early stages of the search. This biases the search towards moves that restrict the opponents possible
 //moves, which are generally better moves, and it also reduces search time significantly by evaluating paths with
 //a higher branching factor later when they can often be eliminated quickly through alpha-beta pruning.
-Possibility Computer_player::search(const Board_vec &board_state, Piece piece, int beta, int alpha, int depth) const {
+//Results are stored in a transposition table, so positions reached through different move orders are only
+//searched once, and the best move found previously for a position is always tried first.
+template<int N>
+Possibility Basic_computer_player<N>::search(const Board_vec &board_state, Piece piece, int beta, int alpha, int depth) const {
+
+    //The value returned by an aborted search is never used
+    if(_aborted || (++_nodes % POLL_INTERVAL == 0 && check_stop()))
+        return Possibility(0);
 
     if(_search_to_end) {
         if(Board::game_over(board_state)) {
             return evaluate(board_state, piece);
         }
     } else {
-        if(depth == _max_depth) {
+        if(depth == _depth_limit) {
             return evaluate(board_state, piece);
         }
     }
@@ -130,6 +907,28 @@ Possibility Computer_player::search(const Board_vec &board_state, Piece piece, i
         return -1 * search(board_state, get_opponent(piece), -alpha, -beta, depth + 1).value;
     }
 
+    int remaining = _search_to_end ? END_DEPTH : _depth_limit - depth;
+    uint64_t key = Transposition_table::hash<N>(board_state, piece);
+    Position cached_best;
+
+    //The root always searches its moves so that a position is returned along with the value
+    Cache_entry entry;
+    if(_cache.probe(key, entry)) {
+        cached_best = entry.best;
+        if(depth > 1 && entry.depth >= remaining) {
+            if(entry.bound == Bound::EXACT ||
+                (entry.bound == Bound::LOWER && entry.value >= beta) ||
+                (entry.bound == Bound::UPPER && entry.value <= alpha))
+                return Possibility(entry.value);
+        }
+    }
+
+    int alpha_orig = alpha;
+
+    int probcut_value;
+    if(depth > 1 && probcut(board_state, piece, beta, alpha, depth, probcut_value))
+        return Possibility(probcut_value);
+
     vector<Position> possible_positions = Board::get_legal_positions(board_state, piece);
     vector<Possibility> possibilities;
 
@@ -139,9 +938,9 @@ Possibility Computer_player::search(const Board_vec &board_state, Piece piece, i
         possibilities.push_back(Possibility{pos, board_next, 0});
     }
 
-    if(depth <= _max_depth / 2) {
+    if(depth <= _depth_limit / 2) {
         for(Possibility &poss: possibilities)
-            poss.value = Board::count_legal_positions(poss.board, piece);
+            poss.value = Board::count_legal_positions(poss.board, get_opponent(piece));
 
         sort(possibilities.begin(), possibilities.end(),
         [](Possibility a, Possibility b)
@@ -149,11 +948,35 @@ Possibility Computer_player::search(const Board_vec &board_state, Piece piece, i
         );
     }
 
+    for(auto it = possibilities.begin(); it != possibilities.end(); it++) {
+        if(it->pos.row == cached_best.row && it->pos.col == cached_best.col) {
+            rotate(possibilities.begin(), it, it + 1);
+            break;
+        }
+    }
+
     Possibility max_poss(INT_MIN);
 
+    Bitboard own = 0, opp = 0;
+    if(_network)
+        to_bitboards(board_state, piece, own, opp);
+
     for(Possibility poss: possibilities) {
+        int square = poss.pos.row * N + poss.pos.col;
+        Bitboard flips = 0;
+        if(_network) {
+            flips = flipped_discs(own, opp, square);
+            _network->play(_accumulator, piece, square, flips);
+        }
+
         poss.value = -1 * search(poss.board, get_opponent(piece), -alpha, -beta, depth + 1).value;
 
+        if(_network)
+            _network->undo(_accumulator, piece, square, flips);
+
+        if(_aborted)
+            return Possibility(0);
+
         if(poss.value > max_poss.value) {
             max_poss = poss;
 
@@ -164,32 +987,77 @@ Possibility Computer_player::search(const Board_vec &board_state, Piece piece, i
         }
     }
 
+    Bound bound = Bound::EXACT;
+    if(max_poss.value <= alpha_orig)
+        bound = Bound::UPPER;
+    else if(max_poss.value >= beta)
+        bound = Bound::LOWER;
+    _cache.store(key, remaining, max_poss.value, bound, max_poss.pos);
+
     return max_poss;
 }
 
-int Computer_player::evaluate (const Board_vec &board_vec, Piece piece) const {
+template<int N>
+bool Basic_computer_player<N>::probcut(const Board_vec &board_state, Piece piece, int beta, int alpha, int depth, int &value) const {
+    int remaining = _depth_limit - depth;
+
+    if(!USE_PROBCUT || _selectivity == 0 || _network || _search_to_end || _in_probcut)
+        return false;
+    if(remaining < PROBCUT_MIN_DEPTH)
+        return false;
+
+    //The fits only describe evaluation values, so windows that depend on finished
+    //games are always searched in full
+    if(beta >= INT_MAX / 4 || alpha <= INT_MIN / 4)
+        return false;
+
+    const Probcut_fit &fit = PROBCUT_FITS[min(remaining, PROBCUT_MAX_DEPTH)];
+    double threshold = PROBCUT_THRESHOLDS[_selectivity] * fit.sigma;
+
+    //Shallow values that would put the deep value at least threshold above beta or
+    //below alpha. Each is tested with a null window search, which is much cheaper
+    //than finding the exact shallow value.
+    int high_bound = int(ceil((beta + threshold - fit.intercept) / fit.slope));
+    int low_bound = int(floor((alpha - threshold - fit.intercept) / fit.slope));
+
+    int saved_limit = _depth_limit;
+    _depth_limit = depth + fit.shallow_depth;
+    _in_probcut = true;
+
+    bool cut = false;
+    if(search(board_state, piece, high_bound, high_bound - 1, depth).value >= high_bound) {
+        value = beta;
+        cut = true;
+    } else if(search(board_state, piece, low_bound + 1, low_bound, depth).value <= low_bound) {
+        value = alpha;
+        cut = true;
+    }
+
+    _in_probcut = false;
+    _depth_limit = saved_limit;
+
+    return cut;
+}
+
+template<int N>
+int Basic_computer_player<N>::evaluate (const Board_vec &board_vec, Piece piece) const {
 
     //End state boards are evaluated differently than intermediate state boards.
     //Once the game is over, the board is valued very highly (effectively positive
     //infinity) if the active player has one the game, and very poorly if they have
     //lost. Among both winning and losing boards, configurations where the active
     //player has the most pieces are valued the highest, to win by as much as possible
-    //or lose by as little as possible.
+    //or lose by as little as possible. A draw is worth 0, so that values stay
+    //symmetric under negation.
     if(Board::game_over(board_vec)) {
-        Piece winner = Board::get_winner(board_vec);
-        if(winner == Piece::EMPTY) {
-            return INT_MIN / 4;
-        } else {
-            int active_pieces = Board::count_pieces(board_vec, piece);
-            int opponent_pieces = Board::count_pieces(board_vec, get_opponent(piece));
-            int modifier = active_pieces - opponent_pieces;
-            if(winner == piece)
-                return INT_MAX / 2 + modifier;
-            if(winner == get_opponent(piece))
-                return INT_MIN / 2 + modifier;
-        }
+        int active_pieces = Board::count_pieces(board_vec, piece);
+        int opponent_pieces = Board::count_pieces(board_vec, get_opponent(piece));
+        return end_value(active_pieces - opponent_pieces);
     }
 
+    if(_network)
+        return _network->evaluate(_accumulator, piece);
+
     //When the game is not over, the current state of the board is evaluated
     //using the position value grid (a constant member variable). Corner pieces
     //are valued very highly, and pieces adjacent to corners are generally avoided
@@ -197,20 +1065,9 @@ int Computer_player::evaluate (const Board_vec &board_vec, Piece piece) const {
     int active_weight = 0;
     int opponent_weight = 0;
 
-    for(int row = 0; row < 8; row++) {
-        for(int col = 0; col < 8; col++) {
-            int weight_row;
-            int weight_col;
-
-            //The following ternary conditions adjust the row
-            //and column values to effectively mirror the position
-            //value grid across the horizontal and vertical axes,
-            //allowing the position weights of a full 8x8 board to
-            //be stored in a 4x4 array.
-            row < 4? weight_row = row : weight_row = 7 - row;
-            col < 4? weight_col = col : weight_col = 7 - col;
-
-            int weight = WEIGHTS[weight_row][weight_col];
+    for(int row = 0; row < N; row++) {
+        for(int col = 0; col < N; col++) {
+            int weight = square_weight(row, col);
 
             //Some pieces in the position value grid have negative
             //values because they can potentially grant access to the
@@ -219,14 +1076,14 @@ int Computer_player::evaluate (const Board_vec &board_vec, Piece piece) const {
             //once a corner has been claimed, all negative values in the
             //corner's quadrant are raised to a small positive value of 1.
             bool corner_empty = false;
-            if(row < 4 && col < 4) {
+            if(row < N / 2 && col < N / 2) {
                 corner_empty = board_vec[0][0] == Piece::EMPTY;
-            } else if (row < 4 && col >= 4) {
-                corner_empty = board_vec[0][7] == Piece::EMPTY;
-            } else if (row >= 4 && col < 4) {
-                corner_empty = board_vec[7][0] == Piece::EMPTY;
+            } else if (row < N / 2 && col >= N / 2) {
+                corner_empty = board_vec[0][N - 1] == Piece::EMPTY;
+            } else if (row >= N / 2 && col < N / 2) {
+                corner_empty = board_vec[N - 1][0] == Piece::EMPTY;
             } else {
-                corner_empty = board_vec[7][7] == Piece::EMPTY;
+                corner_empty = board_vec[N - 1][N - 1] == Piece::EMPTY;
             }
 
             if(!corner_empty) {
@@ -242,8 +1099,141 @@ int Computer_player::evaluate (const Board_vec &board_vec, Piece piece) const {
         }
     }
 
+    //Discs that can never be flipped are worth more than their square alone suggests.
+    //Stability always spreads out from a corner, so it is only checked once one is taken.
+    Bitboard own = 0, opp = 0;
+    if(USE_STABILITY)
+        to_bitboards(board_vec, piece, own, opp);
+    if((own | opp) & CORNERS) {
+        active_weight += STABLE_WEIGHT * count_bits(stable_discs(own, opp));
+        opponent_weight += STABLE_WEIGHT * count_bits(stable_discs(opp, own));
+    }
+
     return active_weight - opponent_weight;
 }
 
+template<int N>
+int Basic_computer_player<N>::square_weight(int row, int col) const {
+    int weight_row;
+    int weight_col;
+
+    //The following ternary conditions adjust the row
+    //and column values to effectively mirror the position
+    //value grid across the horizontal and vertical axes,
+    //allowing the position weights of a full 8x8 board to
+    //be stored in a 4x4 array. On a 10x10 board the center
+    //ring shares the weights of the ring around it.
+    row < N / 2? weight_row = row : weight_row = N - 1 - row;
+    col < N / 2? weight_col = col : weight_col = N - 1 - col;
+    weight_row = min(weight_row, 3);
+    weight_col = min(weight_col, 3);
+
+    return WEIGHTS[weight_row][weight_col];
+}
+
+template<int N>
+Square_classes Basic_computer_player<N>::weight_classes() const {
+    Square_classes classes;
+
+    for(int row = 0; row < 8; row++) {
+        for(int col = 0; col < 8; col++) {
+            int weight = square_weight(row, col);
+
+            int c = 0;
+            while(c < classes.count && classes.weights[c] != weight)
+                c++;
+            if(c == classes.count) {
+                classes.count++;
+                classes.masks[c] = 0;
+                classes.weights[c] = weight;
+                //Matches evaluate, where a taken corner raises the weights in its quadrant to at least 1
+                classes.taken_weights[c] = max(1, weight) - weight;
+            }
+
+            classes.masks[c] |= square_bit(row, col);
+        }
+    }
+
+    for(int q = 0; q < 4; q++) {
+        int top = q < 2 ? 0 : 4;
+        int left = q % 2 == 0 ? 0 : 4;
+
+        classes.corners[q] = square_bit(top == 0 ? 0 : 7, left == 0 ? 0 : 7);
+        classes.quadrants[q] = 0;
+        for(int row = top; row < top + 4; row++)
+            for(int col = left; col < left + 4; col++)
+                classes.quadrants[q] |= square_bit(row, col);
+    }
+
+    return classes;
+}
+
+template<int N>
+void Basic_computer_player<N>::evaluate_batch(const Position_batch &positions, int scores[], int threads) const {
+    static_assert(N == 8, "Batch evaluation uses 8x8 bitboards");
+
+    Square_classes classes = weight_classes();
+    size_t count = positions.size();
+
+    if(threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    threads = int(min(size_t(threads), max(size_t(1), count / MIN_THREAD_BATCH)));
+
+    //Each thread takes one contiguous block, so every score is written by exactly one thread
+    vector<thread> workers;
+    size_t block = (count + threads - 1) / threads;
+    for(int i = 1; i < threads; i++) {
+        size_t begin = min(count, i * block);
+        size_t end = min(count, begin + block);
+        workers.emplace_back(&Basic_computer_player::evaluate_range, this, cref(positions), cref(classes), scores, begin, end);
+    }
+
+    evaluate_range(positions, classes, scores, 0, min(count, block));
+    for(thread &t: workers)
+        t.join();
+}
+
+template<int N>
+void Basic_computer_player<N>::evaluate_range(const Position_batch &positions, const Square_classes &classes, int scores[], size_t begin, size_t end) const {
+    const Bitboard *own = positions.own.data();
+    const Bitboard *opp = positions.opp.data();
+
+    //The network works on one position at a time, with an accumulator of each thread's own
+    if(_network) {
+        Network::Accumulator accumulator;
+        for(size_t i = begin; i < end; i++) {
+            if(!legal_moves(own[i], opp[i]) && !legal_moves(opp[i], own[i])) {
+                scores[i] = end_value(count_bits(own[i]) - count_bits(opp[i]));
+            } else {
+                _network->refresh(accumulator, own[i], opp[i]);
+                scores[i] = _network->evaluate(accumulator, Piece::P1);
+            }
+        }
+        return;
+    }
+
+    //The position weights of the whole range are computed first by the vector kernel, then
+    //finished games and stable discs, which need more than a few masks, are handled one at a time
+    WEIGHTED_COUNT_KERNEL(own + begin, opp + begin, end - begin, classes, scores + begin);
+
+    for(size_t i = begin; i < end; i++) {
+        if(!legal_moves(own[i], opp[i]) && !legal_moves(opp[i], own[i])) {
+            scores[i] = end_value(count_bits(own[i]) - count_bits(opp[i]));
+        } else if((own[i] | opp[i]) & CORNERS) {
+            scores[i] += STABLE_WEIGHT * (count_bits(stable_discs(own[i], opp[i])) - count_bits(stable_discs(opp[i], own[i])));
+        }
+    }
+}
+
+template<int N>
+int Basic_computer_player<N>::end_value(int margin) {
+    if(margin > 0)
+        return INT_MAX / 2 + margin;
+    else if(margin < 0)
+        return -(INT_MAX / 2) + margin;  //Exactly the negated win, so values survive negamax
+    else
+        return 0;
+}
+
 
 #endif
@@ -0,0 +1,21 @@
+#ifndef CONST_TABLE_H_INCLUDED
+#define CONST_TABLE_H_INCLUDED
+
+
+//A fixed size array that constexpr functions can fill in. A table made by one and stored in
+//a constexpr variable is built by the compiler and lands in read-only data, so no program
+//spends its startup building it, and a table that is never used costs nothing. std::array
+//cannot be written to in a constant expression before C++17, so this is used instead.
+//
+//The tables are checked against the runtime builders they replaced by check_tables.cpp.
+template<typename T, int SIZE>
+struct Const_table {
+    T values[SIZE];
+
+    constexpr T& operator[](int i) { return values[i]; }
+    constexpr const T& operator[](int i) const { return values[i]; }
+    static constexpr int size() { return SIZE; }
+};
+
+
+#endif
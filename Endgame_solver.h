@@ -0,0 +1,657 @@
+#ifndef ENDGAME_SOLVER_H_INCLUDED
+#define ENDGAME_SOLVER_H_INCLUDED
+
+
+#include "Bitboard.h"
+#include "Numa.h"
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+//Solves 8x8 positions to the end of the game, working on bitboards and on several threads.
+//
+//The threads share the tree with Young Brothers Wait: a node only offers its moves to other
+//threads once its first (and most likely best) move has been searched, as that search
+//usually narrows the window enough for the rest to be searched quickly or cut off. The node
+//becomes a split point, its remaining moves are pushed as tasks onto the deque of the thread
+//that owns it, and idle threads steal tasks from the other end of any deque. The owner keeps
+//working on its own tasks, and on stolen ones, until all of them are done.
+//
+//When a move proves a cutoff at a split point, the moves still being searched elsewhere are
+//pointless. Every node checks the split points above it, so those searches unwind as soon as
+//they notice.
+//
+//All of this depends on timing: which thread steals what, what the others have put in the
+//shared table by then and when a cutoff is noticed change the nodes searched, and can change
+//the best move among equal ones. In deterministic mode the work is split only at the root,
+//in a fixed way: the first move is searched, then every other move is tested against its
+//value on a null window, the moves dealt out to the threads in turn. Each thread has a table
+//of its own. The results are then merged in move order on the calling thread, which
+//searches again the moves that may be better. A thread that reaches its share of the node
+//limit stops only itself. The same position and settings then always give the same value,
+//move and node count, at the cost of a smaller speedup.
+//
+//On machines with several NUMA nodes the placement decides where the threads run and how
+//the tables are backed (see Numa.h). The table entries of a node's children are prefetched
+//while the children are generated, so the probes after them find the entries on their way.
+class Endgame_solver {
+public:
+    //The number of threads (0 uses every core) and the size of the shared hash table
+    Endgame_solver(int threads = 0, int hash_bits = 20);
+
+    //Returns the final margin (own discs minus opp discs) with best play from the position,
+    //own to move. If the margin is outside (alpha, beta) a bound on that side is returned
+    //instead. best is set to the square of the best move. The search gives up when stop is
+    //set or the deadline passes, after which aborted() is true and the result is meaningless.
+    int solve(Bitboard own, Bitboard opp, int alpha, int beta, int &best,
+        const atomic<bool> &stop, chrono::steady_clock::time_point deadline);
+
+    bool aborted() const;
+    long long last_nodes() const;
+    //Follows the best moves stored in the hash table from a position, own to move, for up to
+    //max_length moves. Passes are skipped over. The last few moves of a game are never stored,
+    //so they are searched again, and the line ends early wherever else the table has no move.
+    vector<int> best_line(Bitboard own, Bitboard opp, int max_length);
+
+    void set_threads(int threads);
+    int threads() const;
+    //Gives up once about this many nodes have been searched (0 for no limit), the limit is
+    //shared out evenly between the threads
+    void set_node_limit(long long nodes);
+    //Turns deterministic mode (see above) on or off. It needs a table for every thread.
+    void set_deterministic(bool deterministic);
+    //Sets where the threads run and how the tables are allocated, which drops the tables
+    void set_placement(const Placement &placement);
+    const Placement &placement() const;
+    //The pages the shared table actually got, which is only known once it is allocated
+    Page_size table_pages() const;
+    void clear();
+
+private:
+    struct Split_point {
+        Split_point *parent;  //The split point the node itself was searched under, if any
+        mutex lock;
+        int alpha;
+        int beta;
+        int best_value;
+        int best_square;
+        atomic<int> pending;  //Tasks not finished yet
+        atomic<bool> cutoff{false};
+    };
+
+    struct Task {
+        Bitboard own;  //The position after the move, with own to move
+        Bitboard opp;
+        int square;
+        Split_point *split;
+    };
+
+    struct Worker {
+        mutex lock;
+        deque<Task> tasks;  //The owner works at the back, thieves take from the front
+        long long nodes = 0;
+        bool stopped = false;  //In deterministic mode a worker stops on its own
+    };
+
+    //A move from a node, with the position after it
+    struct Child {
+        Bitboard own;
+        Bitboard opp;
+        int square;
+        int order;
+    };
+
+    //Entries are written without locks. The key is stored xor the data, so an entry torn by
+    //two threads writing at once does not match any position and is ignored.
+    struct Hash_entry {
+        atomic<uint64_t> check{0};
+        atomic<uint64_t> data{0};
+    };
+
+    enum Bound_kind { EXACT = 0, LOWER = 1, UPPER = 2 };
+
+    const static int SHALLOW_EMPTIES = 6;  //Below this moves are not ordered or cached
+    const static int SPLIT_EMPTIES = 12;  //Smaller trees are not worth sharing
+    const static int POLL_INTERVAL = 4096;  //Nodes between checks of the clock and stop flag
+    const static int NO_SQUARE = 64;
+    //Positions from games have at most about 30 moves, but the solver is given any position,
+    //so the move lists hold every square
+    const static int MAX_MOVES = 64;
+
+    int _threads;
+    int _hash_bits;
+    Placement _placement;
+    Large_array<Hash_entry> _table;
+    vector<Large_array<Hash_entry>> _worker_tables;  //For workers after the first, in deterministic mode
+
+    vector<unique_ptr<Worker>> _workers;
+    atomic<bool> _done{false};
+    atomic<bool> _abort{false};
+    const atomic<bool> *_stop = nullptr;
+    chrono::steady_clock::time_point _deadline;
+    long long _node_limit = 0;
+    bool _deterministic = false;
+
+    int search(int id, Bitboard own, Bitboard opp, int alpha, int beta, Split_point *split, int *best_square = nullptr);
+    int shallow_search(Bitboard own, Bitboard opp, int alpha, int beta, bool passed, long long &nodes);
+    //The root search of deterministic mode
+    int split_root(Bitboard own, Bitboard opp, int alpha, int beta, int &best);
+    //Fills children with the moves of a position, fastest first, returning how many there
+    //are. The table entries of the children worker id will probe are prefetched.
+    int ordered_children(int id, Bitboard own, Bitboard opp, int hash_square, Child children[]) const;
+
+    //Checks the stop flag, deadline and node limit every POLL_INTERVAL nodes of a worker
+    void poll(Worker &worker);
+    //True if the search has been stopped or a split point above has been cut off
+    bool cancelled(const Worker &worker, const Split_point *split) const;
+
+    void run_task(int id, const Task &task);
+    bool pop_task(int id, Task &task);
+    bool steal_task(int id, Task &task);
+    void helper(int id);
+
+    static uint64_t hash(Bitboard own, Bitboard opp);
+    //The table a worker reads and writes
+    Large_array<Hash_entry> &table(int id);
+    const Large_array<Hash_entry> &table(int id) const;
+    bool probe(int id, Bitboard own, Bitboard opp, int &value, int &bound, int &square) const;
+    void store(int id, Bitboard own, Bitboard opp, int value, int bound, int square);
+};
+
+Endgame_solver::Endgame_solver(int threads, int hash_bits):
+    _hash_bits(hash_bits)
+{
+    set_threads(threads);
+}
+
+void Endgame_solver::set_threads(int threads) {
+    _threads = threads > 0 ? threads : max(1, int(thread::hardware_concurrency()));
+}
+
+int Endgame_solver::threads() const {
+    return _threads;
+}
+
+void Endgame_solver::set_node_limit(long long nodes) {
+    _node_limit = max(0LL, nodes);
+}
+
+void Endgame_solver::set_deterministic(bool deterministic) {
+    _deterministic = deterministic;
+}
+
+void Endgame_solver::set_placement(const Placement &placement) {
+    _placement = placement;
+    _table = Large_array<Hash_entry>();
+    _worker_tables.clear();
+}
+
+const Placement &Endgame_solver::placement() const {
+    return _placement;
+}
+
+Page_size Endgame_solver::table_pages() const {
+    return _table.pages();
+}
+
+bool Endgame_solver::aborted() const {
+    return _abort;
+}
+
+long long Endgame_solver::last_nodes() const {
+    long long out = 0;
+    for(const unique_ptr<Worker> &worker: _workers)
+        out += worker->nodes;
+    return out;
+}
+
+vector<int> Endgame_solver::best_line(Bitboard own, Bitboard opp, int max_length) {
+    vector<int> line;
+    if(_table.empty())
+        return line;
+
+    while(int(line.size()) < max_length) {
+        Bitboard moves = legal_moves(own, opp);
+        if(!moves) {
+            if(!legal_moves(opp, own))
+                break;
+            swap(own, opp);
+            continue;
+        }
+
+        int value, bound, square = NO_SQUARE;
+        if(64 - count_bits(own | opp) <= SHALLOW_EMPTIES) {
+            long long nodes = 0;
+            int best_value = -65;
+            for(Bitboard left = moves; left; left &= left - 1) {
+                int move = first_square(left);
+                Bitboard flips = flipped_discs(own, opp, move);
+                int move_value = -shallow_search(opp & ~flips, own | flips | (Bitboard(1) << move), -65, 65, false, nodes);
+                if(move_value > best_value) {
+                    best_value = move_value;
+                    square = move;
+                }
+            }
+        } else if(!probe(0, own, opp, value, bound, square) || square >= NO_SQUARE || !(moves & (Bitboard(1) << square))) {
+            break;
+        }
+
+        line.push_back(square);
+        Bitboard flips = flipped_discs(own, opp, square);
+        Bitboard next_own = opp & ~flips;
+        opp = own | flips | (Bitboard(1) << square);
+        own = next_own;
+    }
+
+    return line;
+}
+
+void Endgame_solver::clear() {
+    for(Hash_entry &entry: _table) {
+        entry.check = 0;
+        entry.data = 0;
+    }
+    _worker_tables.clear();
+}
+
+int Endgame_solver::solve(Bitboard own, Bitboard opp, int alpha, int beta, int &best,
+    const atomic<bool> &stop, chrono::steady_clock::time_point deadline) {
+
+    //The table is only allocated once the solver is first used
+    if(_table.empty())
+        _table = Large_array<Hash_entry>(size_t(1) << _hash_bits, _placement);
+    if(_deterministic && _threads > 1 && int(_worker_tables.size()) != _threads - 1) {
+        _worker_tables.clear();
+        for(int i = 1; i < _threads; i++)
+            _worker_tables.emplace_back(size_t(1) << _hash_bits, _placement);
+    }
+
+    _workers.clear();
+    for(int i = 0; i < _threads; i++)
+        _workers.emplace_back(new Worker());
+
+    _stop = &stop;
+    _deadline = deadline;
+    _abort = false;
+    _done = false;
+
+    //The calling thread is pinned as worker 0 for the solve only
+    Affinity_guard affinity;
+    pin_thread(0, _placement.pinning);
+
+    best = NO_SQUARE;
+    int value;
+    if(_deterministic && _threads > 1) {
+        value = split_root(own, opp, alpha, beta, best);
+    } else {
+        //The calling thread is worker 0 and searches the root, the others start out idle
+        vector<thread> helpers;
+        for(int i = 1; i < _threads; i++)
+            helpers.emplace_back(&Endgame_solver::helper, this, i);
+
+        value = search(0, own, opp, alpha, beta, nullptr, &best);
+
+        _done = true;
+        for(thread &t: helpers)
+            t.join();
+    }
+
+    for(const unique_ptr<Worker> &worker: _workers)
+        if(worker->stopped)
+            _abort = true;
+    return value;
+}
+
+int Endgame_solver::split_root(Bitboard own, Bitboard opp, int alpha, int beta, int &best) {
+    Bitboard moves = legal_moves(own, opp);
+    if(!moves || 64 - count_bits(own | opp) < SPLIT_EMPTIES)
+        return search(0, own, opp, alpha, beta, nullptr, &best);
+
+    int hash_value, hash_bound, hash_square = NO_SQUARE;
+    probe(0, own, opp, hash_value, hash_bound, hash_square);
+    Child children[MAX_MOVES];
+    int count = ordered_children(0, own, opp, hash_square, children);
+
+    int alpha_orig = alpha;
+    int best_value = -search(0, children[0].own, children[0].opp, -beta, -alpha, nullptr);
+    best = children[0].square;
+    if(cancelled(*_workers[0], nullptr))
+        return 0;
+    alpha = max(alpha, best_value);
+
+    if(alpha < beta && count > 1) {
+        //Worker id tests moves id + 1, id + 1 + threads and so on
+        int tests[MAX_MOVES];
+        int test_alpha = alpha;
+        auto test = [&](int id) {
+            if(id > 0)
+                pin_thread(id, _placement.pinning);
+            for(int i = id + 1; i < count && !_workers[id]->stopped; i += _threads)
+                tests[i] = -search(id, children[i].own, children[i].opp, -test_alpha - 1, -test_alpha, nullptr);
+        };
+
+        vector<thread> helpers;
+        for(int id = 1; id < _threads; id++)
+            helpers.emplace_back(test, id);
+        test(0);
+        for(thread &t: helpers)
+            t.join();
+
+        for(const unique_ptr<Worker> &worker: _workers)
+            if(worker->stopped)
+                _abort = true;
+        if(_abort)
+            return 0;
+
+        //A move that failed low cannot be better. One that failed high is searched again
+        //with the window as it is by now, unless it already proved a cutoff.
+        for(int i = 1; i < count && alpha < beta; i++) {
+            int value = tests[i];
+            if(value > test_alpha && value < beta)
+                value = -search(0, children[i].own, children[i].opp, -beta, -alpha, nullptr);
+            if(cancelled(*_workers[0], nullptr))
+                return 0;
+
+            if(value > best_value) {
+                best_value = value;
+                best = children[i].square;
+                alpha = max(alpha, value);
+            }
+        }
+    }
+
+    int bound = best_value <= alpha_orig ? UPPER : (best_value >= beta ? LOWER : EXACT);
+    store(0, own, opp, best_value, bound, best);
+    return best_value;
+}
+
+int Endgame_solver::ordered_children(int id, Bitboard own, Bitboard opp, int hash_square, Child children[]) const {
+    //Fastest first: moves that leave the opponent the fewest replies are searched first,
+    //after the best move found by an earlier search of the position
+    const Large_array<Hash_entry> &entries = table(id);
+    int count = 0;
+    for(Bitboard moves = legal_moves(own, opp); moves; moves &= moves - 1) {
+        int square = first_square(moves);
+        Bitboard flips = flipped_discs(own, opp, square);
+        Child &child = children[count++];
+        child.own = opp & ~flips;
+        child.opp = own | flips | (Bitboard(1) << square);
+        child.square = square;
+        child.order = square == hash_square ? -1 : count_bits(legal_moves(child.own, child.opp));
+
+        //Shallow children are searched without the table
+        if(64 - count_bits(child.own | child.opp) > SHALLOW_EMPTIES)
+            __builtin_prefetch(&entries[hash(child.own, child.opp) & (entries.size() - 1)]);
+    }
+    sort(children, children + count, [](const Child &a, const Child &b) {return a.order < b.order;});
+    return count;
+}
+
+void Endgame_solver::poll(Worker &worker) {
+    if(++worker.nodes % POLL_INTERVAL == 0) {
+        if(*_stop || chrono::steady_clock::now() >= _deadline ||
+            (_node_limit > 0 && worker.nodes * _threads >= _node_limit)) {
+            if(_deterministic)
+                worker.stopped = true;
+            else
+                _abort = true;
+        }
+    }
+}
+
+bool Endgame_solver::cancelled(const Worker &worker, const Split_point *split) const {
+    if(_abort || worker.stopped)
+        return true;
+    for(; split; split = split->parent)
+        if(split->cutoff)
+            return true;
+    return false;
+}
+
+int Endgame_solver::search(int id, Bitboard own, Bitboard opp, int alpha, int beta, Split_point *split, int *best_square) {
+    Worker &worker = *_workers[id];
+    poll(worker);
+    if(cancelled(worker, split))
+        return 0;
+
+    Bitboard moves = legal_moves(own, opp);
+    if(!moves) {
+        if(!legal_moves(opp, own))
+            return count_bits(own) - count_bits(opp);
+        return -search(id, opp, own, -beta, -alpha, split);
+    }
+
+    //The opponent's stable discs will still be theirs at the end of the game, which caps
+    //the margin own can win by. If even that margin cannot raise alpha, nothing below this
+    //node can change the result. Only some of opp's discs are stable, so the stable discs are
+    //not worth finding while even all of them would not be enough.
+    if(64 - 2 * count_bits(opp) <= alpha && !best_square) {
+        int upper = 64 - 2 * count_bits(stable_discs(opp, own));
+        if(upper <= alpha)
+            return upper;
+    }
+
+    int empties = 64 - count_bits(own | opp);
+    if(empties <= SHALLOW_EMPTIES && !best_square)
+        return shallow_search(own, opp, alpha, beta, false, worker.nodes);
+
+    int hash_value, hash_bound, hash_square = NO_SQUARE;
+    if(probe(id, own, opp, hash_value, hash_bound, hash_square) && !best_square) {
+        if(hash_bound == EXACT ||
+            (hash_bound == LOWER && hash_value >= beta) ||
+            (hash_bound == UPPER && hash_value <= alpha))
+            return hash_value;
+    }
+
+    Child children[MAX_MOVES];
+    int count = ordered_children(id, own, opp, hash_square, children);
+
+    int alpha_orig = alpha;
+    int best_value = -search(id, children[0].own, children[0].opp, -beta, -alpha, split);
+    int best = children[0].square;
+    if(cancelled(worker, split))
+        return 0;
+    alpha = max(alpha, best_value);
+
+    if(alpha < beta && count > 1) {
+        if(_threads > 1 && !_deterministic && empties >= SPLIT_EMPTIES) {
+            Split_point point;
+            point.parent = split;
+            point.alpha = alpha;
+            point.beta = beta;
+            point.best_value = best_value;
+            point.best_square = best;
+            point.pending = count - 1;
+
+            //Pushed in reverse, so the owner (at the back) continues in the sorted order
+            //while thieves (at the front) take the moves least likely to be best
+            {
+                lock_guard<mutex> lock(worker.lock);
+                for(int i = count - 1; i >= 1; i--)
+                    worker.tasks.push_back({children[i].own, children[i].opp, children[i].square, &point});
+            }
+
+            while(point.pending > 0) {
+                Task task;
+                if(pop_task(id, task) || steal_task(id, task))
+                    run_task(id, task);
+                else
+                    this_thread::yield();
+            }
+
+            if(cancelled(worker, split))
+                return 0;
+            best_value = point.best_value;
+            best = point.best_square;
+        } else {
+            for(int i = 1; i < count && alpha < beta; i++) {
+                //Null window first, as the later moves are expected to be worse
+                int value = -search(id, children[i].own, children[i].opp, -alpha - 1, -alpha, split);
+                if(value > alpha && value < beta && !cancelled(worker, split))
+                    value = -search(id, children[i].own, children[i].opp, -beta, -value, split);
+                if(cancelled(worker, split))
+                    return 0;
+
+                if(value > best_value) {
+                    best_value = value;
+                    best = children[i].square;
+                    alpha = max(alpha, value);
+                }
+            }
+        }
+    }
+
+    int bound = best_value <= alpha_orig ? UPPER : (best_value >= beta ? LOWER : EXACT);
+    store(id, own, opp, best_value, bound, best);
+
+    if(best_square)
+        *best_square = best;
+    return best_value;
+}
+
+int Endgame_solver::shallow_search(Bitboard own, Bitboard opp, int alpha, int beta, bool passed, long long &nodes) {
+    nodes++;
+
+    Bitboard moves = legal_moves(own, opp);
+    if(!moves) {
+        if(passed)
+            return count_bits(own) - count_bits(opp);
+        return -shallow_search(opp, own, -beta, -alpha, true, nodes);
+    }
+
+    int best_value = -64 - 1;
+    for(; moves; moves &= moves - 1) {
+        int square = first_square(moves);
+        Bitboard flips = flipped_discs(own, opp, square);
+        int value = -shallow_search(opp & ~flips, own | flips | (Bitboard(1) << square), -beta, -alpha, false, nodes);
+
+        if(value > best_value) {
+            best_value = value;
+            if(value > alpha) {
+                alpha = value;
+                if(alpha >= beta)
+                    break;
+            }
+        }
+    }
+
+    return best_value;
+}
+
+void Endgame_solver::run_task(int id, const Task &task) {
+    Split_point *point = task.split;
+    const Worker &worker = *_workers[id];
+
+    if(!cancelled(worker, point)) {
+        int alpha, beta;
+        {
+            lock_guard<mutex> lock(point->lock);
+            alpha = point->alpha;
+            beta = point->beta;
+        }
+
+        int value = -search(id, task.own, task.opp, -alpha - 1, -alpha, point);
+        if(value > alpha && value < beta && !cancelled(worker, point))
+            value = -search(id, task.own, task.opp, -beta, -value, point);
+
+        if(!cancelled(worker, point)) {
+            lock_guard<mutex> lock(point->lock);
+            if(value > point->best_value) {
+                point->best_value = value;
+                point->best_square = task.square;
+            }
+            if(value > point->alpha) {
+                point->alpha = value;
+                if(value >= point->beta)
+                    point->cutoff = true;
+            }
+        }
+    }
+
+    point->pending--;
+}
+
+bool Endgame_solver::pop_task(int id, Task &task) {
+    Worker &worker = *_workers[id];
+    lock_guard<mutex> lock(worker.lock);
+    if(worker.tasks.empty())
+        return false;
+
+    task = worker.tasks.back();
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool Endgame_solver::steal_task(int id, Task &task) {
+    for(int i = 1; i < _threads; i++) {
+        Worker &victim = *_workers[(id + i) % _threads];
+        lock_guard<mutex> lock(victim.lock);
+        if(!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Endgame_solver::helper(int id) {
+    pin_thread(id, _placement.pinning);
+    while(!_done) {
+        Task task;
+        if(steal_task(id, task))
+            run_task(id, task);
+        else
+            this_thread::yield();
+    }
+}
+
+uint64_t Endgame_solver::hash(Bitboard own, Bitboard opp) {
+    return position_hash(own, opp);
+}
+
+Large_array<Endgame_solver::Hash_entry> &Endgame_solver::table(int id) {
+    return id > 0 && _deterministic ? _worker_tables[id - 1] : _table;
+}
+
+const Large_array<Endgame_solver::Hash_entry> &Endgame_solver::table(int id) const {
+    return id > 0 && _deterministic ? _worker_tables[id - 1] : _table;
+}
+
+bool Endgame_solver::probe(int id, Bitboard own, Bitboard opp, int &value, int &bound, int &square) const {
+    uint64_t key = hash(own, opp);
+    const Large_array<Hash_entry> &entries = table(id);
+    const Hash_entry &entry = entries[key & (entries.size() - 1)];
+
+    uint64_t data = entry.data.load(memory_order_relaxed);
+    if((entry.check.load(memory_order_relaxed) ^ data) != key || data == 0)
+        return false;
+
+    //Data layout: value + 65 in bits 0-7, bound in bits 8-9, square in bits 10-16
+    value = int(data & 0xff) - 65;
+    bound = int((data >> 8) & 3);
+    square = int((data >> 10) & 0x7f);
+    return true;
+}
+
+void Endgame_solver::store(int id, Bitboard own, Bitboard opp, int value, int bound, int square) {
+    uint64_t key = hash(own, opp);
+    Large_array<Hash_entry> &entries = table(id);
+    Hash_entry &entry = entries[key & (entries.size() - 1)];
+
+    uint64_t data = uint64_t(value + 65) | (uint64_t(bound) << 8) | (uint64_t(square) << 10);
+    entry.check.store(key ^ data, memory_order_relaxed);
+    entry.data.store(data, memory_order_relaxed);
+}
+
+
+#endif
@@ -0,0 +1,451 @@
+#ifndef ENGINE_H_INCLUDED
+#define ENGINE_H_INCLUDED
+
+
+#include "Board.h"
+#include "Computer_player.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+
+using namespace std;
+
+//A headless front end for GUIs and scripts, speaking a line based protocol modelled on
+//NBoard's. Commands are read one per line and replies written one per line, with nothing
+//interactive in between. Searches run on their own thread, so a stop (or any command that
+//changes the position) is acted on while the search is still running.
+//
+//Commands:
+//  nboard <version>             replies "set myname <name>"
+//  set depth <moves>            midgame search depth
+//  set endgame <empties>        exact solves from this many empty squares in deterministic
+//                               mode, otherwise they are chosen by their predicted time
+//  set time <milliseconds>      time limit per search, 0 for none
+//  set clock <milliseconds> [increment]
+//                               time left on the engine's clock, and added after each move.
+//                               Each go plans its time from the clock and takes it off, 0 for none
+//  set threads <count>          end game solver threads, 0 for every core
+//  set placement <words>        where the solver threads run and how its table is allocated,
+//                               such as "spread,huge,interleave" (see Numa.h)
+//  set nodes <count>            node limit per search, 0 for none
+//  set deterministic <0|1>      1 makes every search repeatable: the same position and
+//                               settings give the same move, value and node count. Time
+//                               limits and clocks are then ignored.
+//  set hash <bits>              cache of 2^bits entries
+//  set position <squares> <side>  64 squares of X, O and -, then the player to move
+//  set game <GGF>               a game record: its starting board and moves
+//  move <square>                plays a move ("pa" to pass), anything after a / is ignored
+//  go                           searches, then replies "=== <move>/<value>/<seconds>"
+//  hint <count>                 replies "search <move> <value> 0 <depth>" for the best moves,
+//                               after each depth of the analysis
+//  stop                         ends the search early, its reply is sent before the next one
+//  ping <n>                     stops any search, then replies "pong <n>"
+//  quit
+//
+//Values are disc margins for positions searched to the end, and evaluations otherwise.
+//Errors are reported on "status" lines.
+class Engine {
+private:
+    istream &_in;
+    ostream &_out;
+    mutex _out_lock;  //Search threads reply while the main thread is reading commands
+
+    Board _board;
+    Piece _to_move = Piece::P1;
+
+    const static int DEFAULT_DEPTH = 7;
+    const static int SOLVE_BUDGET = 3000;  //Milliseconds
+    //Solves positions with this many empty squares in deterministic mode, where the budget is
+    //not used. SOLVE_COST puts an exact solve of 18 empties at about a second.
+    const static int DEFAULT_END_GAME_DEPTH = 18;
+    Computer_player _player;
+    Chess_clock _clock;
+
+    thread _search;
+    atomic<bool> _search_done{true};
+
+    void send(const string &line);
+    //Stops the search, if any, and waits for it to reply
+    void finish_search();
+
+    //Returns false for "quit"
+    bool handle(const string &line);
+    void set(istringstream &args);
+    void play(const string &square);
+    void go();
+    void hint(int count);
+
+    //Sets the board and the player to move from a position or a game record. Return false
+    //if the text cannot be read, leaving the board as it was.
+    bool set_position(const string &squares, const string &side);
+    bool set_game(const string &ggf);
+
+    //Value in the units described above, with a sign
+    static string value_text(int value);
+    static bool parse_square(string text, Position &pos);
+
+public:
+    Engine(istream &in, ostream &out);
+    ~Engine();
+
+    //Reads and answers commands until quit or the end of the input
+    void run();
+};
+
+Engine::Engine(istream &in, ostream &out):
+    _in(in),
+    _out(out),
+    _player(Piece::P1, &_board, DEFAULT_DEPTH, DEFAULT_END_GAME_DEPTH, false)
+{
+    //Solves are chosen by their predicted cost rather than a fixed depth
+    _player.set_solve_budget(SOLVE_BUDGET);
+}
+
+Engine::~Engine() {
+    finish_search();
+}
+
+void Engine::run() {
+    string line;
+    while(getline(_in, line))
+        if(!handle(line))
+            break;
+
+    finish_search();
+}
+
+void Engine::send(const string &line) {
+    lock_guard<mutex> lock(_out_lock);
+    _out << line << endl;
+}
+
+void Engine::finish_search() {
+    if(!_search.joinable())
+        return;
+
+    //A search clears the stop flag as it starts, so a stop sent just before then would be
+    //lost. It is repeated until the search is over.
+    while(!_search_done) {
+        _player.stop();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    _search.join();
+}
+
+bool Engine::handle(const string &line) {
+    istringstream args(line);
+    string command;
+    args >> command;
+    for(char &c: command) c = tolower(c);
+
+    if(command == "")
+        return true;
+
+    if(command == "quit")
+        return false;
+
+    //Everything reads or changes the position, so the search has to be done with it first
+    finish_search();
+
+    if(command == "stop") {
+        //Nothing more to do, the search has replied
+    } else if(command == "nboard") {
+        send("set myname " + _player.name());
+    } else if(command == "ping") {
+        string n;
+        args >> n;
+        send("pong " + n);
+    } else if(command == "set") {
+        set(args);
+    } else if(command == "move") {
+        string square;
+        args >> square;
+        play(square.substr(0, square.find('/')));
+    } else if(command == "go") {
+        go();
+    } else if(command == "hint") {
+        int count = 1;
+        args >> count;
+        hint(max(1, count));
+    } else {
+        send("status Unknown command: " + command);
+    }
+
+    return true;
+}
+
+void Engine::set(istringstream &args) {
+    string name;
+    args >> name;
+    for(char &c: name) c = tolower(c);
+
+    if(name == "game") {
+        string ggf;
+        getline(args, ggf);
+        if(!set_game(ggf))
+            send("status Cannot read the game");
+        return;
+    }
+
+    if(name == "clock") {
+        long long remaining = 0, increment = 0;
+        bool read = bool(args >> remaining);
+        if(read && !(args >> increment))
+            read = args.eof() && !args.bad();
+        if(!read || remaining < 0 || increment < 0) {
+            send("status Cannot read the clock");
+            return;
+        }
+
+        //Both sides get the same time, only the engine's side is ever run
+        Time_kind kind = increment > 0 ? Time_kind::FISCHER : Time_kind::SUDDEN_DEATH;
+        _clock = Chess_clock(remaining > 0 ? Time_control(kind, int(remaining), int(increment)) : Time_control());
+        _player.set_clock(_clock.timed() ? &_clock : nullptr);
+        return;
+    }
+
+    if(name == "nodes") {
+        long long nodes;
+        if(!(args >> nodes) || nodes < 0) {
+            send("status Cannot read the node limit");
+            return;
+        }
+        _player.set_node_limit(nodes);
+        return;
+    }
+
+    if(name == "placement") {
+        string words;
+        Placement placement;
+        if(!(args >> words) || !parse_placement(words, placement)) {
+            send("status Cannot read the placement");
+            return;
+        }
+        _player.set_solver_placement(placement);
+        return;
+    }
+
+    if(name == "position") {
+        string squares, side;
+        args >> squares >> side;
+        if(!set_position(squares, side))
+            send("status Cannot read the position");
+        return;
+    }
+
+    int value;
+    if(!(args >> value)) {
+        send("status Missing value for set " + name);
+        return;
+    }
+
+    try {
+        if(name == "depth") {
+            if(value < 1 || value > 60) {
+                send("status Depth out of range");
+                return;
+            }
+            _player.set_depth(value);
+        } else if(name == "endgame") {
+            if(value < 0 || value > 60) {
+                send("status End game depth out of range");
+                return;
+            }
+            _player.set_end_game_depth(value);
+        } else if(name == "time") {
+            _player.set_time_limit(max(0, value));
+        } else if(name == "threads") {
+            _player.set_solver_threads(max(0, value));
+        } else if(name == "hash") {
+            _player.set_cache_size(value);
+        } else if(name == "deterministic") {
+            _player.set_deterministic(value != 0);
+        } else if(name != "contempt") {
+            send("status Unknown setting: " + name);
+        }
+    } catch(const exception &e) {
+        send(string("status ") + e.what());
+    }
+}
+
+void Engine::play(const string &square) {
+    string lower = square;
+    for(char &c: lower) c = tolower(c);
+
+    if(lower == "pa" || lower == "pass") {
+        if(_board.can_move(_to_move))
+            send("status Cannot pass while there are moves");
+        else
+            _to_move = get_opponent(_to_move);
+        return;
+    }
+
+    Position pos;
+    if(!parse_square(square, pos) || !_board.is_legal(_to_move, pos)) {
+        send("status Illegal move: " + square);
+        return;
+    }
+
+    _board.play(_to_move, pos);
+    _to_move = get_opponent(_to_move);
+}
+
+void Engine::go() {
+    if(!_board.can_move(_to_move)) {
+        send("=== PA");
+        return;
+    }
+
+    _player.set_piece(_to_move);
+    _clock.start(_to_move);
+    _search_done = false;
+    _search = thread([this] {
+        auto start = chrono::steady_clock::now();
+        string move = _player.move();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        _clock.stop();
+        Move_analysis chosen = _player.last_move();
+
+        char time[32];
+        snprintf(time, sizeof(time), "%.2f", seconds);
+        send("=== " + move + "/" + value_text(chosen.value) + "/" + time);
+        send("nodestats " + to_string(_player.last_nodes()) + " " + time);
+        _search_done = true;
+    });
+}
+
+void Engine::hint(int count) {
+    Piece piece = _to_move;
+    _search_done = false;
+    _search = thread([this, piece, count] {
+        _player.analyze(piece, [this, count](const vector<Move_analysis> &results) {
+            for(int i = 0; i < count && i < int(results.size()); i++) {
+                const Move_analysis &a = results[i];
+                string depth = a.exact ? "100%" : to_string(a.depth);
+                send("search " + to_string(a.pos) + " " + value_text(a.value) + " 0 " + depth);
+            }
+        });
+        send("status");
+        _search_done = true;
+    });
+}
+
+bool Engine::set_position(const string &squares, const string &side) {
+    if(squares.size() != Board::SIZE * Board::SIZE || side.size() != 1)
+        return false;
+
+    Board_vec board(Board::SIZE, vector<Piece>(Board::SIZE, Piece::EMPTY));
+    for(int i = 0; i < int(squares.size()); i++) {
+        char c = toupper(squares[i]);
+        Piece &square = board[i / Board::SIZE][i % Board::SIZE];
+        if(c == 'X' || c == '*' || c == 'B')
+            square = Piece::P1;
+        else if(c == 'O' || c == 'W')
+            square = Piece::P2;
+        else if(c != '-' && c != '.')
+            return false;
+    }
+
+    char mover = toupper(side[0]);
+    if(mover != 'X' && mover != '*' && mover != 'B' && mover != 'O' && mover != 'W')
+        return false;
+
+    _board.set_board_vec(board);
+    _to_move = (mover == 'O' || mover == 'W') ? Piece::P2 : Piece::P1;
+    return true;
+}
+
+bool Engine::set_game(const string &ggf) {
+    //A GGF record is a list of NAME[value] properties. BO holds the starting board as
+    //"8 <squares> <side>", B and W the moves of each player in order.
+    Board_vec saved_board = _board.get_board_vec();
+    Piece saved_to_move = _to_move;
+    bool have_board = false;
+
+    for(size_t i = 0; i < ggf.size(); ) {
+        size_t open = ggf.find('[', i);
+        if(open == string::npos)
+            break;
+        size_t close = ggf.find(']', open);
+        if(close == string::npos)
+            break;
+
+        size_t name_start = open;
+        while(name_start > i && isupper(ggf[name_start - 1]))
+            name_start--;
+        string name = ggf.substr(name_start, open - name_start);
+        string value = ggf.substr(open + 1, close - open - 1);
+        i = close + 1;
+
+        if(name == "BO") {
+            istringstream fields(value);
+            string size, squares, side;
+            fields >> size;
+            for(string row; int(squares.size()) < Board::SIZE * Board::SIZE && fields >> row; )
+                squares += row;
+            fields >> side;
+            if(size != to_string(Board::SIZE) || !set_position(squares, side))
+                break;
+            have_board = true;
+        } else if((name == "B" || name == "W") && have_board) {
+            Piece mover = name == "B" ? Piece::P1 : Piece::P2;
+            string square = value.substr(0, value.find('/'));
+            Position pos;
+            string lower = square;
+            for(char &c: lower) c = tolower(c);
+
+            if(lower == "pa" || lower == "pass") {
+                _to_move = get_opponent(mover);
+                continue;
+            }
+            if(!parse_square(square, pos) || !_board.is_legal(mover, pos)) {
+                have_board = false;
+                break;
+            }
+            _board.play(mover, pos);
+            _to_move = get_opponent(mover);
+        }
+    }
+
+    if(!have_board) {
+        _board.set_board_vec(saved_board);
+        _to_move = saved_to_move;
+    }
+    return have_board;
+}
+
+string Engine::value_text(int value) {
+    if(value >= INT_MAX / 4)
+        value -= INT_MAX / 2;
+    else if(value <= INT_MIN / 4)
+        value += INT_MAX / 2;
+
+    return (value >= 0 ? "+" : "") + to_string(value);
+}
+
+bool Engine::parse_square(string text, Position &pos) {
+    if(text.size() < 2 || !isalpha(text[0]))
+        return false;
+    for(size_t i = 1; i < text.size(); i++)
+        if(!isdigit(text[i]))
+            return false;
+
+    int col = tolower(text[0]) - 'a';
+    int row = stoi(text.substr(1)) - 1;
+    if(row < 0 || row >= Board::SIZE || col < 0 || col >= Board::SIZE)
+        return false;
+
+    pos = Position(row, col);
+    return true;
+}
+
+
+#endif
@@ -3,8 +3,10 @@
 
 
 #include "Board.h"
+#include "Board_display.h"
 #include "Player.h"
 #include "Game_host.h"
+#include "Clock.h"
 
 #include <iostream>
 #include <string>
@@ -18,8 +20,21 @@ enum class End_state {
     P1_WIN, P2_WIN, DRAW, QUIT
 };
 
-class Game {
+//The outcome of submitting a command to a game with the step API
+enum class Step {
+    PLAYED,       //The move was played
+    ILLEGAL,      //A position, but not a legal move for the active player
+    COMMAND,      //Not a position at all, left for the host to handle
+    OUT_OF_TIME   //The active player's time ran out before the move, and the game is over
+};
+
+//Like Basic_board, the game is a template on the side length of the board.
+//Positions are typed as a column letter and a row number, in either order.
+template<int N>
+class Basic_game {
 private:
+    typedef Basic_board<N> Board;
+
     Game_host *_host;
     Board *_board;
     Player *_first;
@@ -29,42 +44,108 @@ private:
     bool _quit = false;
     Piece _active_player = Piece::P1;
 
+    //Runs for the active player while they have a move. A player who runs out of time loses,
+    //whatever the count of pieces.
+    Chess_clock _clock;
+
     Player* get_player(Piece piece) const;
     void next_turn();
-    void print_score();
+    string score_string() const;
+    string clock_string() const;
+
+    //Reads a position such as "D3", "3D" or "10J" from a command. Returns false if the
+    //command is not a position, the position itself may still be out of range.
+    static bool parse_position(const string &command, int &row, int &col);
 
 public:
-    Game(Game_host *host, Board *board, Player *first, Player *second, bool skip_no_moves);
+    Basic_game(Game_host *host, Board *board, Player *first, Player *second, bool skip_no_moves=false);
+    ~Basic_game();
+
+    //Times the following games, and hands the clock to both players (untimed by default)
+    void set_time_control(const Time_control &control);
+    const Chess_clock& clock() const;
 
     End_state play();
     //Plays the game while only printing the board once the game is finished,
     //Used for testing the computer player
     End_state play_silent();
     void quit();  //Ends the current game in progress early
+
+    //Step API, for hosts that are not driven by blocking Player::move() calls, such as a
+    //server juggling many games. start() sets up a new game and each move is submitted as
+    //it arrives. A player without a legal move is passed automatically, so until the game
+    //is over the active player always has a move. The players are never asked to move and
+    //may be null.
+    void start();
+    Step submit(string command);
+    bool over() const;  //The board is full or blocked, or a player ran out of time
+    End_state result() const;  //The winner of a finished game
+
+    Piece active_player() const;
 };
 
+typedef Basic_game<8> Game;
+
 //Private methods
 
-Player* Game::get_player(Piece piece) const {
+template<int N>
+Player* Basic_game<N>::get_player(Piece piece) const {
     assert(piece != Piece::EMPTY);
     if(piece == Piece::P1) return _first;
     else return _second;
 }
 
-void Game::next_turn() {
+template<int N>
+void Basic_game<N>::next_turn() {
     _active_player = get_opponent(_active_player);
 }
 
-void Game::print_score() {
-    cout << "Pieces:" << endl;
-    cout << _first->name() << ": " << _board->count_pieces(Piece::P1) << "  |  ";
-    cout << _second->name() << ": " << _board->count_pieces(Piece::P2) << endl << endl;
+template<int N>
+bool Basic_game<N>::parse_position(const string &command, int &row, int &col) {
+    if(command.length() < 2 || command.length() > 3)
+        return false;
+
+    string digits;
+    if(isalpha(command.front())) {
+        col = command.front() - 'A';
+        digits = command.substr(1);
+    } else if(isalpha(command.back())) {
+        col = command.back() - 'A';
+        digits = command.substr(0, command.length() - 1);
+    } else {
+        return false;
+    }
+
+    for(char c: digits)
+        if(!isdigit(c))
+            return false;
+
+    row = stoi(digits) - 1;
+    return true;
+}
+
+template<int N>
+string Basic_game<N>::score_string() const {
+    return "Pieces:\n" +
+        _first->name() + ": " + to_string(_board->count_pieces(Piece::P1)) + "  |  " +
+        _second->name() + ": " + to_string(_board->count_pieces(Piece::P2)) + "\n\n" + clock_string();
+}
+
+template<int N>
+string Basic_game<N>::clock_string() const {
+    if(!_clock.timed())
+        return "";
+
+    return "Time:\n" +
+        _first->name() + ": " + _clock.time_string(Piece::P1) + "  |  " +
+        _second->name() + ": " + _clock.time_string(Piece::P2) + "\n\n";
 }
 
 
 //Public mehods
 
-Game::Game(Game_host *host, Board *board, Player *first, Player *second, bool skip_no_moves=false):
+template<int N>
+Basic_game<N>::Basic_game(Game_host *host, Board *board, Player *first, Player *second, bool skip_no_moves):
     _host(host),
     _board(board),
     _first(first),
@@ -72,71 +153,94 @@ Game::Game(Game_host *host, Board *board, Player *first, Player *second, bool sk
     _skip_no_moves(skip_no_moves)
 {}
 
+template<int N>
+Basic_game<N>::~Basic_game() {
+    //The players outlive the game, and must not keep reading its clock
+    set_time_control(Time_control());
+}
+
+template<int N>
+void Basic_game<N>::set_time_control(const Time_control &control) {
+    _clock = Chess_clock(control);
 
-End_state Game::play() {
+    for(Player *player: {_first, _second})
+        if(player)
+            player->set_clock(_clock.timed() ? &_clock : nullptr);
+}
+
+template<int N>
+const Chess_clock& Basic_game<N>::clock() const {
+    return _clock;
+}
+
+
+template<int N>
+End_state Basic_game<N>::play() {
     _board->reset();
+    _clock.reset();
 
-    while(!_board->game_over() && !_quit) {
-        cout << endl;
-        cout << _board->board_string(_active_player) << endl << endl;
-        print_score();
+    //Each turn is sent as one frame: what happened on the last turn, the board and the
+    //prompt. On a capable terminal only the squares that changed are redrawn.
+    Basic_board_display<N> display;
+    string message;
+
+    while(!_board->game_over() && !_quit && _clock.flagged() == Piece::EMPTY) {
         Player *player = get_player(_active_player);
+        string prompt = "\n" + score_string();
+        bool can_move = _board->can_move(_active_player);
+        if(can_move) {
+            prompt += "Go " + player->name() + ": \n";
+        } else {
+            prompt += "No legal moves for " + player->name() + "\n";
+            if(!_skip_no_moves)
+                prompt += "Hit enter to continue\n";
+        }
 
-        if(_board->can_move(_active_player)) {
-            cout << "Go " << player->name() << ": " << endl;
+        display.show(message + "\n", *_board, _active_player, prompt);
+        message.clear();
 
+        if(can_move) {
+            //The clock keeps running through commands and illegal moves, until a move is played
+            _clock.start(_active_player);
             string command = player->move();
 
             for(char &c: command) c = toupper(c);
 
-            bool is_move = false;
             int row = 0;
             int col = 0;
 
-            if(command.length() == 2) {
-                if(isdigit(command[0]) && isalpha(command[1])) {
-                    row = command[0] - '1';
-                    col = command[1] - 'A';
-                    is_move = true;
-                } else if(isalpha(command[0]) && isdigit(command[1])) {
-                    row = command[1] - '1';
-                    col = command[0] - 'A';
-                    is_move = true;
-                }
-            }
-
-            if(is_move) {
-                if(row >= 0 && row <= 7 && col >= 0 && col <= 7) {
-                    cout << "Played: " << command << endl;
+            if(parse_position(command, row, col)) {
+                if(row >= 0 && row < N && col >= 0 && col < N) {
+                    message += "Played: " + command + "\n";
 
                     Position pos(row, col);
                     if(_board->is_legal(_active_player, pos)) {
+                        if(!_clock.stop())
+                            break;
+
                         int flipped = _board->play(_active_player, pos);
-                        cout << "Flipped: " << flipped << endl;
+                        message += "Flipped: " + to_string(flipped) + "\n";
                         next_turn();
 
                     } else {
-                        cout << "Illegal move, please try again" << endl;
+                        message += "Illegal move, please try again\n";
                     }
                 } else {
-                    cout << "Location out of range, please try again" << endl;
+                    message += "Location out of range, please try again\n";
                 }
             } else {
                 _host->handle_command(command);
             }
         } else {
-            cout << "No legal moves for " << player->name() << endl;
             if(_skip_no_moves) {
                 next_turn();
             } else {
-                cout << "Hit enter to continue" << endl;
-
                 string command = player->move();
                 if(command == "") {
                     next_turn();
                 } else {
                     for(char &c: command) c = toupper(c);
-                    _host->handle_command(command);       
+                    _host->handle_command(command);
                 }
             }
         }
@@ -144,77 +248,123 @@ End_state Game::play() {
 
     if(_quit) {
         _quit = false;
+        display.print(message);
+        display.finish();
         return End_state::QUIT;
-    } else {
-        cout << _board->board_string() << endl;
-        print_score();
-        cout << "Game over" << endl;
-        int first_score = _board->count_pieces(Piece::P1);
-        int second_score = _board->count_pieces(Piece::P2);
-        if(first_score > second_score) {
-            cout << _first->name() << " wins!" << endl;
-            return End_state::P1_WIN;
-        } else if(first_score < second_score) {
-            cout << _second->name() << " wins!" << endl;
-            return End_state::P2_WIN;
-        } else {
-            cout << "Draw!" << endl;
-            return End_state::DRAW;
-        }
     }
+
+    End_state state = result();
+    display.show(message, *_board, Piece::EMPTY, "");
+    display.finish();
+
+    string out = score_string() + "Game over\n";
+    string on_time = _clock.flagged() != Piece::EMPTY ? " on time" : "";
+    if(state == End_state::P1_WIN)
+        out += _first->name() + " wins" + on_time + "!\n";
+    else if(state == End_state::P2_WIN)
+        out += _second->name() + " wins" + on_time + "!\n";
+    else
+        out += "Draw!\n";
+    display.print(out);
+
+    return state;
 }
 
-End_state Game::play_silent() {
+template<int N>
+End_state Basic_game<N>::play_silent() {
+    start();
+
+    while(!over()) {
+        string command = get_player(_active_player)->move();
+
+        Step step = submit(command);
+        if(step == Step::OUT_OF_TIME)
+            break;
+        else if(step == Step::ILLEGAL)
+            cmpt::error("Illegal move by computer: " + command);
+        else if(step == Step::COMMAND)
+            cmpt::error("Invalid command by computer: " + command);
+    }
+
+    cout << _board->board_string() << "\n" << score_string();
+    End_state state = result();
+    string on_time = _clock.flagged() != Piece::EMPTY ? " on time" : "";
+    if(state == End_state::P1_WIN)
+        cout << _first->name() << " wins" << on_time << "!\n\n";
+    else if(state == End_state::P2_WIN)
+        cout << _second->name() << " wins" << on_time << "!\n\n";
+    else
+        cout << "Draw!\n\n";
+    cout.flush();
+    return state;
+}
+
+template<int N>
+void Basic_game<N>::start() {
     _board->reset();
+    _active_player = Piece::P1;
+    _quit = false;
 
-    while(!_board->game_over()) {
-        if(_board->can_move(_active_player)) {
-            Player *player = get_player(_active_player);
-            string command = player->move();
+    _clock.reset();
+    _clock.start(_active_player);
+}
 
-            for(char &c: command) c = toupper(c);
+template<int N>
+Step Basic_game<N>::submit(string command) {
+    if(_clock.flagged() != Piece::EMPTY)
+        return Step::OUT_OF_TIME;
 
-            if(command.length() == 2 && isalpha(command[0]) && isdigit(command[1])) {
-                int col = command[0] - 'A';
-                int row = command[1] - '1';
+    for(char &c: command) c = toupper(c);
 
-                if(row >= 0 && row <= 7 && col >= 0 && col <= 7) {
-                    Position pos(row, col);
-                    if(_board->is_legal(_active_player, pos)) {
-                        _board->play(_active_player, pos);
-                        next_turn();
-                    } else {
-                        cmpt::error("Illegal move by computer: " + command);
-                    }
-                } else {
-                    cmpt::error("Illegal placement by computer: " + command);
-                }
-            } else {
-                cmpt::error("Invalid command by computer: " + command);
-            }
-        } else {
-            next_turn();
-        }
-    }
+    int row = 0;
+    int col = 0;
+    if(!parse_position(command, row, col))
+        return Step::COMMAND;
+
+    Position pos(row, col);
+    if(row < 0 || row >= N || col < 0 || col >= N || !_board->is_legal(_active_player, pos))
+        return Step::ILLEGAL;
+    if(!_clock.stop())
+        return Step::OUT_OF_TIME;
+
+    _board->play(_active_player, pos);
+    next_turn();
+    if(!_board->game_over() && !_board->can_move(_active_player))
+        next_turn();
+    if(!_board->game_over())
+        _clock.start(_active_player);
+
+    return Step::PLAYED;
+}
+
+template<int N>
+bool Basic_game<N>::over() const {
+    return _board->game_over() || _clock.flagged() != Piece::EMPTY;
+}
+
+template<int N>
+End_state Basic_game<N>::result() const {
+    if(_clock.flagged() != Piece::EMPTY)
+        return _clock.flagged() == Piece::P1 ? End_state::P2_WIN : End_state::P1_WIN;
 
-    cout << _board->board_string() << endl;
-    print_score();
     int first_score = _board->count_pieces(Piece::P1);
     int second_score = _board->count_pieces(Piece::P2);
-    if(first_score > second_score) {
-        cout << _first->name() << " wins!" << endl << endl;
+    if(first_score > second_score)
         return End_state::P1_WIN;
-    } else if(first_score < second_score) {
-        cout << _second->name() << " wins!" << endl << endl;
+    else if(first_score < second_score)
         return End_state::P2_WIN;
-    } else {
-        cout << "Draw!" << endl << endl;
+    else
         return End_state::DRAW;
-    }
 }
 
-void Game::quit() {
+template<int N>
+void Basic_game<N>::quit() {
     _quit = true;
 }
 
+template<int N>
+Piece Basic_game<N>::active_player() const {
+    return _active_player;
+}
+
 #endif
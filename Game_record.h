@@ -0,0 +1,158 @@
+#ifndef GAME_RECORD_H_INCLUDED
+#define GAME_RECORD_H_INCLUDED
+
+
+#include "Board_state.h"
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cctype>
+#include <cstdlib>
+
+using namespace std;
+
+//A move of a recorded game, with the position it was played in
+struct Recorded_move {
+    Board_state board;  //Before the move
+    Piece player;
+    Position move;
+};
+
+//A game read from a move list ("f5d6c3...", passes may be left out or written "pa") or a GGF
+//record, whose BO board replaces the standard start. Every move is replayed and checked.
+struct Game_record {
+    vector<Recorded_move> moves;
+    Board_state final_board;
+
+    //The final disc margin for the first player (X), from the GGF RE property when it can be
+    //read, otherwise from the discs on the final board
+    int margin = 0;
+};
+
+//Reads a square such as "d3", returning false if the text is not one
+bool parse_square(const string &text, Position &pos);
+
+//Reads a game, returning false with a reason if it cannot be read or has an illegal move
+bool read_game_record(const string &text, Game_record &record, string &error);
+
+bool parse_square(const string &text, Position &pos) {
+    if(text.size() != 2 || !isalpha(text[0]) || !isdigit(text[1]))
+        return false;
+
+    int col = tolower(text[0]) - 'a';
+    int row = text[1] - '1';
+    if(row < 0 || row >= 8 || col < 0 || col >= 8)
+        return false;
+
+    pos = Position(row, col);
+    return true;
+}
+
+//Plays the moves from the start, recording the position before each one. Players without a
+//move pass whether or not the pass was written.
+bool play_record_moves(Board_state start, Piece player, const vector<string> &moves, Game_record &record, string &error) {
+    Board_state board = start;
+    for(const string &text: moves) {
+        string lower = text;
+        for(char &c: lower) c = tolower(c);
+
+        if(!board.can_move(player) && !board.game_over())
+            player = get_opponent(player);
+        if(lower == "pa" || lower == "pass")
+            continue;
+
+        Position pos;
+        if(!parse_square(text, pos) || !board.is_legal(player, pos)) {
+            error = "Illegal move " + text + " at move " + to_string(record.moves.size() + 1);
+            return false;
+        }
+
+        record.moves.push_back({board, player, pos});
+        board.play(player, pos);
+        player = get_opponent(player);
+    }
+
+    record.final_board = board;
+    return true;
+}
+
+bool read_game_record(const string &text, Game_record &record, string &error) {
+    record = Game_record();
+    Board_state start = Board_state::start();
+    Piece player = Piece::P1;
+    vector<string> moves;
+    bool has_result = false;
+
+    if(text.find("B[") == string::npos && text.find("W[") == string::npos) {
+        string squares;
+        for(char c: text)
+            if(isalnum(c))
+                squares += c;
+        if(squares.size() % 2 != 0) {
+            error = "The move list has an odd number of characters";
+            return false;
+        }
+        for(size_t i = 0; i < squares.size(); i += 2)
+            moves.push_back(squares.substr(i, 2));
+    } else {
+        //A GGF record is a list of NAME[value] properties. BO holds the starting board as
+        //"8 <squares> <side>", B and W the moves of each player in order, and RE the margin
+        //for black (the first player), such as "+12.000" or "-4:r".
+        for(size_t i = 0; i < text.size(); ) {
+            size_t open = text.find('[', i);
+            size_t close = open == string::npos ? open : text.find(']', open);
+            if(close == string::npos)
+                break;
+
+            size_t name_start = open;
+            while(name_start > i && isupper(text[name_start - 1]))
+                name_start--;
+            string name = text.substr(name_start, open - name_start);
+            string value = text.substr(open + 1, close - open - 1);
+            i = close + 1;
+
+            if(name == "BO") {
+                istringstream fields(value);
+                string size, squares, side;
+                fields >> size;
+                for(string row; squares.size() < 64 && fields >> row; )
+                    squares += row;
+                fields >> side;
+                if(size != "8" || squares.size() != 64 || side.empty()) {
+                    error = "Cannot read the BO board";
+                    return false;
+                }
+
+                start.p1 = start.p2 = 0;
+                for(int square = 0; square < 64; square++) {
+                    char c = toupper(squares[square]);
+                    if(c == '*' || c == 'X' || c == 'B')
+                        start.p1 |= Bitboard(1) << square;
+                    else if(c == 'O' || c == 'W')
+                        start.p2 |= Bitboard(1) << square;
+                }
+                player = (toupper(side[0]) == 'O' || toupper(side[0]) == 'W') ? Piece::P2 : Piece::P1;
+            } else if(name == "B" || name == "W") {
+                moves.push_back(value.substr(0, value.find('/')));
+            } else if(name == "RE") {
+                char *end = nullptr;
+                double margin = strtod(value.c_str(), &end);
+                if(end != value.c_str()) {
+                    record.margin = int(margin);
+                    has_result = true;
+                }
+            }
+        }
+    }
+
+    if(!play_record_moves(start, player, moves, record, error))
+        return false;
+
+    if(!has_result)
+        record.margin = record.final_board.count(Piece::P1) - record.final_board.count(Piece::P2);
+    return true;
+}
+
+
+#endif
@@ -0,0 +1,373 @@
+#ifndef MCTS_PLAYER_H_INCLUDED
+#define MCTS_PLAYER_H_INCLUDED
+
+
+#include "Board.h"
+#include "Bitboard.h"
+#include "Player.h"
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+using namespace std;
+
+//A node of the search tree. Each node is a position with own being the discs of the
+//player to move, and the statistics are kept from the point of view of the player
+//who made the move leading to the node, so a parent simply picks its best child.
+//
+//Several threads search the tree at once without a lock on the whole of it. The statistics
+//are atomic counters. The children have a slot for every move made when the node is, so
+//the vector never moves: a thread adds a child under the node's lock, and publishes it by
+//raising expanded, and threads walking down only read the children below expanded.
+template<int N>
+struct Mcts_node {
+    Bits<N> own;
+    Bits<N> opp;
+    int move;  //The square played to reach this node, or PASS
+    Mcts_node *parent;
+    vector<unique_ptr<Mcts_node>> children;  //One slot per move, a single one for a pass
+    Bits<N> untried;  //Moves that do not have a child yet, only used under lock
+    bool terminal;
+
+    mutex lock;  //Taken to add a child
+    atomic<int> expanded{0};  //Children ready to be read
+
+    //A node starts with the visit of the thread that made it
+    atomic<int> visits{1};
+    atomic<int> half_wins{0};  //In halves, so a draw is a whole number
+
+    const static int PASS = N * N;
+
+    Mcts_node(Bits<N> own, Bits<N> opp, int move, Mcts_node *parent):
+    own(own),
+    opp(opp),
+    move(move),
+    parent(parent)
+    {
+        untried = legal_moves<N>(own, opp);
+        terminal = !untried && !legal_moves<N>(opp, own);
+
+        //A player with no moves must pass, which is represented by a single child
+        children.resize(terminal ? 0 : untried ? count_bits(untried) : 1);
+    }
+
+    bool fully_expanded() const {
+        return expanded.load(memory_order_acquire) == int(children.size());
+    }
+};
+
+//This computer player uses Monte Carlo Tree Search instead of a position evaluation.
+//It plays thousands of fast random games from the current position, and grows a tree
+//towards the moves that have won the most of them, balancing promising moves against
+//rarely tried ones with the UCT formula. It can be stopped at any time, and plays
+//better the more games it has time to play, so it uses every core available. The threads
+//share one tree (see Mcts_node), each adding a virtual loss to the nodes it passes on the
+//way down, which steers the others towards different parts of the tree.
+//Like Basic_board, it is a template on the side length of the board it plays on.
+template<int N>
+class Basic_mcts_player : public Player {
+private:
+    typedef Basic_board<N> Board;
+    typedef Mcts_node<N> Node;
+    typedef Bits<N> Bitboard;
+
+    Piece _piece;
+    const Board *_board;
+    int _think_ms;  //How long to search for each move
+    //On a clock, each move takes the target time planned from the clock instead of _think_ms
+    const Chess_clock *_clock = nullptr;
+    int _threads;
+    bool _wait;
+    string _name;
+
+    //The tree is kept between moves, so the part of it below the moves that were
+    //actually played does not have to be searched again
+    mutable unique_ptr<Node> _root;
+
+    mutable long long _last_playouts = 0;
+    mutable double _last_seconds = 0;
+
+    //Balances exploiting moves that have won often against exploring moves that have been tried rarely
+    const double EXPLORATION = 0.9;
+
+    //Finds the position to search from, reusing the existing tree if it contains it
+    void update_root(Bitboard own, Bitboard opp) const;
+
+    //Runs selection, expansion, a playout and backpropagation until the deadline
+    void worker(chrono::steady_clock::time_point deadline, unsigned long long seed, long long &playouts) const;
+
+    //Walks down from node by UCT, adding a visit to each node on the way, until it reaches a
+    //node that is not fully expanded, which gets a new child, or the end of the game.
+    //Returns the new child or the terminal node.
+    Node* select(Node *node, unsigned long long &rng) const;
+    //Adds a child for one of the untried moves, or returns null if other threads have
+    //already added the last of them
+    Node* expand(Node *node, unsigned long long &rng) const;
+
+    //Plays random moves to the end of the game and returns 1 if the player to move
+    //at the start wins, 0.5 for a draw and 0 for a loss
+    static double playout(Bitboard own, Bitboard opp, unsigned long long &rng);
+    static int random_square(Bitboard moves, unsigned long long &rng);
+
+public:
+    Basic_mcts_player(Piece piece, const Board *board, int think_ms = 1000, int threads = 0, bool wait = true, string name = "Monty");
+
+    string move() const;
+    string name() const;
+    void set_clock(const Chess_clock *clock);
+
+    //Statistics for the last move, for measuring playout speed and scaling across threads
+    long long last_playouts() const;
+    double playouts_per_second() const;
+};
+
+typedef Basic_mcts_player<8> Mcts_player;
+
+template<int N>
+Basic_mcts_player<N>::Basic_mcts_player(Piece piece, const Board *board, int think_ms, int threads, bool wait, string name):
+    _piece(piece),
+    _board(board),
+    _think_ms(think_ms),
+    _threads(threads),
+    _wait(wait),
+    _name(name)
+{
+    if(_threads <= 0)
+        _threads = max(1u, thread::hardware_concurrency());
+}
+
+template<int N>
+string Basic_mcts_player<N>::move() const {
+    if(!_board->can_move(_piece))
+        return "";
+
+    Bitboard own, opp;
+    to_bitboards<N>(_board->get_board_vec(), _piece, own, opp);
+    update_root(own, opp);
+
+    //The search can stop at any moment, so the target is all the plan is needed for
+    bool timed = _clock && _clock->timed();
+    long long think_us = _think_ms * 1000LL;
+    if(timed) {
+        Time_manager plan(_clock->control(), _clock->remaining(_piece), _board->count_pieces(Piece::EMPTY));
+        think_us = (long long)(plan.target() * 1e6);
+    }
+
+    auto start = chrono::steady_clock::now();
+    auto deadline = start + chrono::microseconds(think_us);
+
+    vector<long long> playouts(_threads, 0);
+    vector<thread> workers;
+    for(int i = 0; i < _threads; i++)
+        workers.emplace_back(&Basic_mcts_player::worker, this, deadline, 0x9e3779b97f4a7c15ULL * (i + 1), ref(playouts[i]));
+    for(thread &t: workers)
+        t.join();
+
+    _last_playouts = 0;
+    for(long long count: playouts)
+        _last_playouts += count;
+    _last_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    //The most visited move is the most reliable choice, as its win rate is based on the most games
+    Node *best = nullptr;
+    for(int i = 0; i < _root->expanded; i++)
+        if(!best || _root->children[i]->visits > best->visits)
+            best = _root->children[i].get();
+
+    //The search always expands at least one child, unless it had no time at all
+    int square = best ? best->move : first_square(legal_moves<N>(own, opp));
+    string out = to_string(square_position<N>(square));
+
+    //On a clock, waiting for enter would use up the computer's own time
+    if(_wait && !timed) {
+        cout << "(Ready... hit enter)";
+        string trash;
+        getline(cin, trash);
+    }
+
+    return out;
+}
+
+template<int N>
+string Basic_mcts_player<N>::name() const {
+    return _name;
+}
+
+template<int N>
+void Basic_mcts_player<N>::set_clock(const Chess_clock *clock) {
+    _clock = clock;
+}
+
+template<int N>
+long long Basic_mcts_player<N>::last_playouts() const {
+    return _last_playouts;
+}
+
+template<int N>
+double Basic_mcts_player<N>::playouts_per_second() const {
+    return _last_seconds > 0 ? _last_playouts / _last_seconds : 0;
+}
+
+template<int N>
+void Basic_mcts_player<N>::update_root(Bitboard own, Bitboard opp) const {
+    //Since the last search, this player and then the opponent (or a pass) have moved, so
+    //the new position is two levels down the old tree
+    if(_root) {
+        for(int i = 0; i < _root->expanded; i++) {
+            Node &child = *_root->children[i];
+            for(int j = 0; j < child.expanded; j++) {
+                unique_ptr<Node> &grandchild = child.children[j];
+                if(grandchild->own == own && grandchild->opp == opp) {
+                    unique_ptr<Node> next = std::move(grandchild);
+                    next->parent = nullptr;
+                    _root = std::move(next);
+                    return;
+                }
+            }
+        }
+    }
+
+    //The root has no thread that made it, each search visits it as it starts
+    _root.reset(new Node(own, opp, Node::PASS, nullptr));
+    _root->visits = 0;
+}
+
+template<int N>
+void Basic_mcts_player<N>::worker(chrono::steady_clock::time_point deadline, unsigned long long seed, long long &playouts) const {
+    unsigned long long rng = seed;
+
+    while(chrono::steady_clock::now() < deadline) {
+        //Checking the clock is expensive compared to a playout, so a few are run at a time
+        for(int i = 0; i < 16; i++) {
+            //Virtual loss: the path is counted as visited and lost until the playout
+            //finishes, which steers other threads towards different parts of the tree
+            Node *leaf = select(_root.get(), rng);
+            int half_points = int(2 * playout(leaf->own, leaf->opp, rng));
+
+            //The result is for the player to move at the leaf, which is the opponent
+            //of the player whose statistics the leaf holds
+            for(Node *node = leaf; node; node = node->parent) {
+                node->half_wins.fetch_add(2 - half_points, memory_order_relaxed);
+                half_points = 2 - half_points;
+            }
+
+            playouts++;
+        }
+    }
+}
+
+template<int N>
+Mcts_node<N>* Basic_mcts_player<N>::select(Node *node, unsigned long long &rng) const {
+    node->visits.fetch_add(1, memory_order_relaxed);
+
+    while(!node->terminal) {
+        if(!node->fully_expanded()) {
+            Node *child = expand(node, rng);
+            if(child)
+                return child;
+        }
+
+        //A node that is not terminal always has a move, if only a pass
+        Node *best = node->children.front().get();
+        double best_score = -1;
+        double log_visits = log(double(node->visits.load(memory_order_relaxed)));
+
+        for(const unique_ptr<Node> &child: node->children) {
+            double visits = child->visits.load(memory_order_relaxed);
+            double score = 0.5 * child->half_wins.load(memory_order_relaxed) / visits + EXPLORATION * sqrt(log_visits / visits);
+            if(score > best_score) {
+                best_score = score;
+                best = child.get();
+            }
+        }
+
+        node = best;
+        node->visits.fetch_add(1, memory_order_relaxed);
+    }
+
+    return node;
+}
+
+template<int N>
+Mcts_node<N>* Basic_mcts_player<N>::expand(Node *node, unsigned long long &rng) const {
+    lock_guard<mutex> lock(node->lock);
+    int count = node->expanded.load(memory_order_relaxed);
+    if(count == int(node->children.size()))
+        return nullptr;
+
+    if(!legal_moves<N>(node->own, node->opp)) {
+        node->children[0].reset(new Node(node->opp, node->own, Node::PASS, node));
+    } else {
+        int square = random_square(node->untried, rng);
+        node->untried &= ~(Bitboard(1) << square);
+
+        Bitboard flips = flipped_discs<N>(node->own, node->opp, square);
+        Bitboard own = node->own | flips | (Bitboard(1) << square);
+        Bitboard opp = node->opp & ~flips;
+        node->children[count].reset(new Node(opp, own, square, node));
+    }
+
+    node->expanded.store(count + 1, memory_order_release);
+    return node->children[count].get();
+}
+
+template<int N>
+double Basic_mcts_player<N>::playout(Bitboard own, Bitboard opp, unsigned long long &rng) {
+    bool first = true;  //Whether own is still the player who was to move at the start
+    bool passed = false;
+
+    while(true) {
+        Bitboard moves = legal_moves<N>(own, opp);
+
+        if(!moves) {
+            if(passed)
+                break;
+            passed = true;
+        } else {
+            passed = false;
+
+            //Lightly guided: a corner is always taken when one is available
+            const Bitboard CORNERS = Board_bits<N>::corners();
+            int square = random_square((moves & CORNERS) ? (moves & CORNERS) : moves, rng);
+            Bitboard flips = flipped_discs<N>(own, opp, square);
+            own |= flips | (Bitboard(1) << square);
+            opp &= ~flips;
+        }
+
+        swap(own, opp);
+        first = !first;
+    }
+
+    int margin = count_bits(own) - count_bits(opp);
+    if(!first)
+        margin = -margin;
+
+    if(margin > 0) return 1;
+    if(margin < 0) return 0;
+    return 0.5;
+}
+
+template<int N>
+int Basic_mcts_player<N>::random_square(Bitboard moves, unsigned long long &rng) {
+    //xorshift64, which is fast and has plenty of quality for choosing random moves
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+
+    int skip = rng % count_bits(moves);
+    for(int i = 0; i < skip; i++)
+        moves &= moves - 1;
+
+    return first_square(moves);
+}
+
+
+#endif
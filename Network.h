@@ -0,0 +1,300 @@
+#ifndef NETWORK_H_INCLUDED
+#define NETWORK_H_INCLUDED
+
+
+#include "Bitboard.h"
+#include "cmpt_error.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+
+//A small quantized neural network that evaluates 8x8 positions, as an alternative to the
+//position weights of the computer player. It follows the design of the NNUE evaluators
+//used by chess engines:
+//
+//  - The inputs are 128 features, one for each square holding a disc of the player to move
+//    and one for each square holding an opponent's disc. Only the occupied squares are
+//    active, so the first layer is the sum of one weight column per disc.
+//  - That sum (the accumulator) is kept from both players' points of view, and a move only
+//    adds and removes the columns of the discs it places and flips, instead of summing
+//    every disc again at each leaf of the search.
+//  - The remaining layers are small and use integer arithmetic: 16 bit accumulators,
+//    8 bit activations and weights, and 32 bit sums, with clipped ReLU activations.
+//
+//The network predicts the final disc margin for the player to move. Weights are trained
+//by the train_network program and read from a binary file.
+class Network {
+public:
+    const static int INPUTS = 128;
+    const static int HIDDEN1 = 64;  //Accumulator size
+    const static int HIDDEN2 = 32;
+
+    //Fixed point scales: an activation of 1.0 is stored as ACTIVATION_SCALE, and hidden and
+    //output weights of 1.0 as WEIGHT_SCALE
+    const static int ACTIVATION_SCALE = 127;
+    const static int WEIGHT_SCALE = 64;
+    const static int WEIGHT_SHIFT = 6;  //log2(WEIGHT_SCALE)
+    //Evaluation units per disc of predicted margin
+    const static int DISC_VALUE = 10;
+
+    //The first layer output for each player (P1 then P2) as the player to move
+    struct Accumulator {
+        int16_t values[2][HIDDEN1];
+    };
+
+    //Quantized weights, filled in by load or directly by the trainer. The hidden weights
+    //are stored one output at a time so each dot product reads contiguous memory.
+    int16_t input_weights[INPUTS][HIDDEN1];
+    int16_t input_biases[HIDDEN1];
+    int8_t hidden_weights[HIDDEN2][HIDDEN1];
+    int32_t hidden_biases[HIDDEN2];
+    int16_t output_weights[HIDDEN2];
+    int32_t output_bias;
+
+    Network();
+
+    //Returns false if the file cannot be opened. A file that is not a network of this
+    //shape is an error.
+    bool load(const string &path);
+    void save(const string &path) const;
+
+    //Computes both accumulators from scratch
+    void refresh(Accumulator &acc, Bitboard p1, Bitboard p2) const;
+    //Updates the accumulators for piece playing at square and flipping flips, and back
+    void play(Accumulator &acc, Piece piece, int square, Bitboard flips) const;
+    void undo(Accumulator &acc, Piece piece, int square, Bitboard flips) const;
+
+    //The value of the position for piece, the player to move
+    int evaluate(const Accumulator &acc, Piece piece) const;
+
+private:
+    const static uint32_t MAGIC = 0x4e4e5652;  //"RVNN"
+    const static uint32_t VERSION = 1;
+
+    static int side(Piece piece);
+    //Adds sign times the weight column of the feature to the accumulator of one side
+    void add_feature(int16_t values[HIDDEN1], int feature, int sign) const;
+    //Applies a move with sign 1 and takes it back with sign -1
+    void update(Accumulator &acc, Piece piece, int square, Bitboard flips, int sign) const;
+};
+
+//The dense layers after the accumulator, in plain and AVX2 versions. Both return the
+//output in the fixed point scale ACTIVATION_SCALE * WEIGHT_SCALE.
+int network_forward_scalar(const Network &network, const int16_t acc[Network::HIDDEN1]);
+
+typedef int (*Network_forward_kernel)(const Network &network, const int16_t acc[Network::HIDDEN1]);
+
+Network::Network() {
+    memset(input_weights, 0, sizeof(input_weights));
+    memset(input_biases, 0, sizeof(input_biases));
+    memset(hidden_weights, 0, sizeof(hidden_weights));
+    memset(hidden_biases, 0, sizeof(hidden_biases));
+    memset(output_weights, 0, sizeof(output_weights));
+    output_bias = 0;
+}
+
+bool Network::load(const string &path) {
+    ifstream in(path, ios::binary);
+    if(!in)
+        return false;
+
+    uint32_t header[4];
+    in.read((char*)header, sizeof(header));
+    if(!in || header[0] != MAGIC || header[1] != VERSION)
+        cmpt::error("Not a network weights file: " + path);
+    if(header[2] != HIDDEN1 || header[3] != HIDDEN2)
+        cmpt::error("Network in " + path + " has different layer sizes");
+
+    in.read((char*)input_weights, sizeof(input_weights));
+    in.read((char*)input_biases, sizeof(input_biases));
+    in.read((char*)hidden_weights, sizeof(hidden_weights));
+    in.read((char*)hidden_biases, sizeof(hidden_biases));
+    in.read((char*)output_weights, sizeof(output_weights));
+    in.read((char*)&output_bias, sizeof(output_bias));
+    if(!in)
+        cmpt::error("Network weights file is truncated: " + path);
+
+    return true;
+}
+
+void Network::save(const string &path) const {
+    ofstream out(path, ios::binary);
+
+    uint32_t header[4] = {MAGIC, VERSION, HIDDEN1, HIDDEN2};
+    out.write((const char*)header, sizeof(header));
+    out.write((const char*)input_weights, sizeof(input_weights));
+    out.write((const char*)input_biases, sizeof(input_biases));
+    out.write((const char*)hidden_weights, sizeof(hidden_weights));
+    out.write((const char*)hidden_biases, sizeof(hidden_biases));
+    out.write((const char*)output_weights, sizeof(output_weights));
+    out.write((const char*)&output_bias, sizeof(output_bias));
+
+    if(!out)
+        cmpt::error("Could not write network weights to " + path);
+}
+
+int Network::side(Piece piece) {
+    return piece == Piece::P1 ? 0 : 1;
+}
+
+void Network::add_feature(int16_t values[HIDDEN1], int feature, int sign) const {
+    const int16_t *column = input_weights[feature];
+    if(sign > 0) {
+        for(int i = 0; i < HIDDEN1; i++)
+            values[i] += column[i];
+    } else {
+        for(int i = 0; i < HIDDEN1; i++)
+            values[i] -= column[i];
+    }
+}
+
+void Network::refresh(Accumulator &acc, Bitboard p1, Bitboard p2) const {
+    for(int s = 0; s < 2; s++) {
+        memcpy(acc.values[s], input_biases, sizeof(input_biases));
+
+        //Features 0 to 63 are the discs of the side the accumulator is for
+        Bitboard own = s == 0 ? p1 : p2;
+        Bitboard opp = s == 0 ? p2 : p1;
+        for(Bitboard bits = own; bits; bits &= bits - 1)
+            add_feature(acc.values[s], first_square(bits), 1);
+        for(Bitboard bits = opp; bits; bits &= bits - 1)
+            add_feature(acc.values[s], 64 + first_square(bits), 1);
+    }
+}
+
+void Network::update(Accumulator &acc, Piece piece, int square, Bitboard flips, int sign) const {
+    int16_t *mover = acc.values[side(piece)];
+    int16_t *other = acc.values[1 - side(piece)];
+
+    add_feature(mover, square, sign);
+    add_feature(other, 64 + square, sign);
+
+    //A flipped disc moves from the opponent's features to the mover's in both views
+    for(; flips; flips &= flips - 1) {
+        int flipped = first_square(flips);
+        add_feature(mover, flipped, sign);
+        add_feature(mover, 64 + flipped, -sign);
+        add_feature(other, 64 + flipped, sign);
+        add_feature(other, flipped, -sign);
+    }
+}
+
+void Network::play(Accumulator &acc, Piece piece, int square, Bitboard flips) const {
+    update(acc, piece, square, flips, 1);
+}
+
+void Network::undo(Accumulator &acc, Piece piece, int square, Bitboard flips) const {
+    update(acc, piece, square, flips, -1);
+}
+
+int network_forward_scalar(const Network &network, const int16_t acc[Network::HIDDEN1]) {
+    const int top = Network::ACTIVATION_SCALE;
+
+    uint8_t input[Network::HIDDEN1];
+    for(int i = 0; i < Network::HIDDEN1; i++)
+        input[i] = uint8_t(min(max(int(acc[i]), 0), top));
+
+    int output = network.output_bias;
+    for(int j = 0; j < Network::HIDDEN2; j++) {
+        int sum = network.hidden_biases[j];
+        for(int i = 0; i < Network::HIDDEN1; i++)
+            sum += input[i] * network.hidden_weights[j][i];
+
+        int hidden = min(max(sum >> Network::WEIGHT_SHIFT, 0), top);
+        output += hidden * network.output_weights[j];
+    }
+
+    return output;
+}
+
+#if defined(__x86_64__)
+
+//The clipped accumulator is packed into 64 unsigned bytes, and each hidden output is a
+//dot product with a row of signed byte weights, using the unsigned by signed byte multiply
+//that adds adjacent pairs into 16 bits. Activations and weights are both at most 127, so
+//the pair sums cannot saturate.
+__attribute__((target("avx2")))
+int network_forward_avx2(const Network &network, const int16_t acc[Network::HIDDEN1]) {
+    static_assert(Network::HIDDEN1 == 64, "The AVX2 kernel packs the accumulator into two registers");
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i top = _mm256_set1_epi16(Network::ACTIVATION_SCALE);
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    __m256i a0 = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)acc), zero), top);
+    __m256i a1 = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(acc + 16)), zero), top);
+    __m256i a2 = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(acc + 32)), zero), top);
+    __m256i a3 = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(acc + 48)), zero), top);
+
+    //Packing works within 128 bit halves, so the 64 bit blocks are put back in order after it
+    __m256i input0 = _mm256_permute4x64_epi64(_mm256_packus_epi16(a0, a1), 0xd8);
+    __m256i input1 = _mm256_permute4x64_epi64(_mm256_packus_epi16(a2, a3), 0xd8);
+
+    alignas(32) int32_t sums[Network::HIDDEN2];
+    for(int j = 0; j < Network::HIDDEN2; j += 8) {
+        //Eight outputs at a time: each row's products are reduced to one 32 bit lane per
+        //128 bit half, then the rows are combined with horizontal adds
+        __m256i row_sums[8];
+        for(int k = 0; k < 8; k++) {
+            const int8_t *weights = network.hidden_weights[j + k];
+            __m256i w0 = _mm256_loadu_si256((const __m256i*)weights);
+            __m256i w1 = _mm256_loadu_si256((const __m256i*)(weights + 32));
+            __m256i products = _mm256_add_epi32(
+                _mm256_madd_epi16(_mm256_maddubs_epi16(input0, w0), ones),
+                _mm256_madd_epi16(_mm256_maddubs_epi16(input1, w1), ones));
+            row_sums[k] = products;
+        }
+
+        __m256i s01 = _mm256_hadd_epi32(row_sums[0], row_sums[1]);
+        __m256i s23 = _mm256_hadd_epi32(row_sums[2], row_sums[3]);
+        __m256i s45 = _mm256_hadd_epi32(row_sums[4], row_sums[5]);
+        __m256i s67 = _mm256_hadd_epi32(row_sums[6], row_sums[7]);
+        __m256i s0123 = _mm256_hadd_epi32(s01, s23);
+        __m256i s4567 = _mm256_hadd_epi32(s45, s67);
+
+        //Each half now holds partial sums of rows 0 to 3 and 4 to 7, and the halves are added
+        __m256i low = _mm256_permute2x128_si256(s0123, s4567, 0x20);
+        __m256i high = _mm256_permute2x128_si256(s0123, s4567, 0x31);
+        __m256i total = _mm256_add_epi32(low, high);
+
+        total = _mm256_add_epi32(total, _mm256_loadu_si256((const __m256i*)(network.hidden_biases + j)));
+        _mm256_store_si256((__m256i*)(sums + j), total);
+    }
+
+    const int highest = Network::ACTIVATION_SCALE;
+    int output = network.output_bias;
+    for(int j = 0; j < Network::HIDDEN2; j++)
+        output += min(max(sums[j] >> Network::WEIGHT_SHIFT, 0), highest) * network.output_weights[j];
+
+    return output;
+}
+
+#endif
+
+Network_forward_kernel best_network_forward_kernel() {
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2"))
+        return network_forward_avx2;
+#endif
+
+    return network_forward_scalar;
+}
+
+const static Network_forward_kernel NETWORK_FORWARD_KERNEL = best_network_forward_kernel();
+
+int Network::evaluate(const Accumulator &acc, Piece piece) const {
+    int output = NETWORK_FORWARD_KERNEL(*this, acc.values[side(piece)]);
+
+    //Rounded division, as the output scale is much finer than the evaluation units
+    long long scaled = (long long)output * DISC_VALUE;
+    long long divisor = ACTIVATION_SCALE * WEIGHT_SCALE;
+    return int(scaled >= 0 ? (scaled + divisor / 2) / divisor : -((-scaled + divisor / 2) / divisor));
+}
+
+
+#endif
@@ -0,0 +1,394 @@
+#ifndef NUMA_H_INCLUDED
+#define NUMA_H_INCLUDED
+
+
+#include "cmpt_error.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+//Where threads run and where large tables live, for machines with several NUMA nodes
+//(sockets). Memory on a thread's own node is faster than memory on another, and a table of
+//gigabytes on 4 KiB pages misses the TLB on nearly every probe, so a search that shares one
+//big table between the threads of several sockets can lose much of its speedup to both.
+//
+//Threads can be pinned to CPUs: SPREAD deals them out to the nodes in turn, so a few threads
+//already use every socket's memory bandwidth, COMPACT fills one node before the next, so a
+//few threads share one socket's cache. Tables can be backed by huge pages: explicit ones,
+//which the administrator must reserve (vm.nr_hugepages), fall back to transparent ones,
+//which are asked for with madvise and in turn fall back to small pages when the kernel has
+//them turned off. And a table's pages can be interleaved over every node, so each socket
+//sees the same mix of local and remote accesses, instead of all of the table landing on the
+//node of the thread that happened to touch it first.
+//
+//Everything here is Linux only, and a machine without NUMA information is one node.
+
+enum class Pinning {
+    NONE, SPREAD, COMPACT
+};
+
+enum class Page_size {
+    SMALL, TRANSPARENT, EXPLICIT
+};
+
+struct Placement {
+    Pinning pinning = Pinning::NONE;
+    Page_size pages = Page_size::SMALL;
+    bool interleave = false;
+};
+
+//Reads words separated by commas, such as "spread,huge,interleave": none, spread or compact;
+//small, transparent or huge; interleave or local. Words left out keep their defaults.
+//Returns false if a word is not one of these.
+bool parse_placement(const string &text, Placement &placement);
+string to_string(const Placement &placement);
+string to_string(Page_size pages);
+
+//The NUMA nodes of the machine and the CPUs of each that this process may run on
+class Numa_topology {
+private:
+    vector<int> _node_ids;
+    vector<vector<int>> _cpus;
+
+    Numa_topology();
+
+public:
+    static const Numa_topology& get();
+
+    int nodes() const;
+    //The kernel's number for a node, as the memory policy calls want it
+    int node_id(int node) const;
+    const vector<int>& cpus(int node) const;
+    int cpu_count() const;
+
+    //The CPU the thread with the given index should run on, -1 for no pinning
+    int cpu_for(int index, Pinning pinning) const;
+};
+
+//Pins the calling thread to the CPU cpu_for picks. Returns false if there is no pinning or
+//the CPU could not be set.
+bool pin_thread(int index, Pinning pinning);
+
+//Saves the calling thread's CPUs, and restores them when destroyed, so a thread borrowed
+//for pinned work gets its freedom back
+class Affinity_guard {
+private:
+    cpu_set_t _saved;
+    bool _valid;
+
+public:
+    Affinity_guard();
+    ~Affinity_guard();
+
+    Affinity_guard(const Affinity_guard&) = delete;
+    Affinity_guard& operator=(const Affinity_guard&) = delete;
+};
+
+//A fixed size array in a memory mapping of its own, with the pages and NUMA policy of a
+//placement. Every element is constructed in place when the array is made, which faults every
+//page in before any search starts, and T must not need its destructor run.
+template<typename T>
+class Large_array {
+private:
+    static_assert(is_trivially_destructible<T>::value, "Elements are never destroyed");
+
+    const static size_t HUGE_PAGE = size_t(1) << 21;
+
+    T *_data = nullptr;
+    size_t _count = 0;
+    size_t _bytes = 0;  //Of the mapping
+    Page_size _pages = Page_size::SMALL;
+    bool _interleaved = false;
+
+    void release();
+
+public:
+    Large_array() {}
+    Large_array(size_t count, const Placement &placement);
+    ~Large_array();
+
+    Large_array(Large_array &&other);
+    Large_array& operator=(Large_array &&other);
+    Large_array(const Large_array&) = delete;
+    Large_array& operator=(const Large_array&) = delete;
+
+    T& operator[](size_t i) { return _data[i]; }
+    const T& operator[](size_t i) const { return _data[i]; }
+    T* begin() { return _data; }
+    T* end() { return _data + _count; }
+    size_t size() const { return _count; }
+    bool empty() const { return _count == 0; }
+
+    //The pages actually obtained, which may be smaller than those asked for
+    Page_size pages() const { return _pages; }
+    bool interleaved() const { return _interleaved; }
+};
+
+bool parse_placement(const string &text, Placement &placement) {
+    stringstream words(text);
+    string word;
+    while(getline(words, word, ',')) {
+        for(char &c: word) c = tolower(c);
+
+        if(word == "none") placement.pinning = Pinning::NONE;
+        else if(word == "spread") placement.pinning = Pinning::SPREAD;
+        else if(word == "compact") placement.pinning = Pinning::COMPACT;
+        else if(word == "small") placement.pages = Page_size::SMALL;
+        else if(word == "transparent") placement.pages = Page_size::TRANSPARENT;
+        else if(word == "huge") placement.pages = Page_size::EXPLICIT;
+        else if(word == "interleave") placement.interleave = true;
+        else if(word == "local") placement.interleave = false;
+        else return false;
+    }
+
+    return true;
+}
+
+string to_string(Page_size pages) {
+    return pages == Page_size::SMALL ? "small" : pages == Page_size::TRANSPARENT ? "transparent" : "huge";
+}
+
+string to_string(const Placement &placement) {
+    string pinning = placement.pinning == Pinning::NONE ? "none" : placement.pinning == Pinning::SPREAD ? "spread" : "compact";
+    return pinning + "," + to_string(placement.pages) + "," + (placement.interleave ? "interleave" : "local");
+}
+
+//Reads a kernel CPU list such as "0-3,8-11"
+vector<int> read_cpu_list(const string &text) {
+    vector<int> out;
+    stringstream ranges(text);
+    string range;
+    while(getline(ranges, range, ',')) {
+        int first, last;
+        char dash;
+        stringstream parts(range);
+        if(!(parts >> first))
+            continue;
+        if(!(parts >> dash >> last))
+            last = first;
+        for(int cpu = first; cpu <= last; cpu++)
+            out.push_back(cpu);
+    }
+    return out;
+}
+
+Numa_topology::Numa_topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_allowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    auto usable = [&](int cpu) {return !have_allowed || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed));};
+
+    //Node numbers can have gaps, so every possible one is tried
+    const static int MAX_NODES = 1024;
+    for(int id = 0; id < MAX_NODES; id++) {
+        ifstream file("/sys/devices/system/node/node" + to_string(id) + "/cpulist");
+        string text;
+        if(!file || !getline(file, text))
+            continue;
+
+        vector<int> cpus;
+        for(int cpu: read_cpu_list(text))
+            if(usable(cpu))
+                cpus.push_back(cpu);
+        if(!cpus.empty()) {
+            _node_ids.push_back(id);
+            _cpus.push_back(cpus);
+        }
+    }
+
+    if(_cpus.empty()) {
+        vector<int> cpus;
+        int count = max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+        for(int cpu = 0; cpu < count; cpu++)
+            if(usable(cpu))
+                cpus.push_back(cpu);
+        _node_ids.push_back(0);
+        _cpus.push_back(cpus.empty() ? vector<int>{0} : cpus);
+    }
+}
+
+const Numa_topology& Numa_topology::get() {
+    static const Numa_topology topology;
+    return topology;
+}
+
+int Numa_topology::nodes() const {
+    return _cpus.size();
+}
+
+int Numa_topology::node_id(int node) const {
+    return _node_ids[node];
+}
+
+const vector<int>& Numa_topology::cpus(int node) const {
+    return _cpus[node];
+}
+
+int Numa_topology::cpu_count() const {
+    int count = 0;
+    for(const vector<int> &cpus: _cpus)
+        count += cpus.size();
+    return count;
+}
+
+int Numa_topology::cpu_for(int index, Pinning pinning) const {
+    if(pinning == Pinning::NONE)
+        return -1;
+
+    //More threads than CPUs start again from the first
+    index %= cpu_count();
+    if(pinning == Pinning::COMPACT) {
+        for(const vector<int> &cpus: _cpus) {
+            if(index < int(cpus.size()))
+                return cpus[index];
+            index -= cpus.size();
+        }
+    }
+
+    //Spread: thread i goes to node i % nodes, taking that node's CPUs in order. Nodes with
+    //fewer CPUs run out first, and are then skipped.
+    vector<size_t> used(_cpus.size(), 0);
+    for(int node = 0; ; node = (node + 1) % nodes()) {
+        if(used[node] == _cpus[node].size())
+            continue;
+        if(index-- == 0)
+            return _cpus[node][used[node]];
+        used[node]++;
+    }
+}
+
+bool pin_thread(int index, Pinning pinning) {
+    int cpu = Numa_topology::get().cpu_for(index, pinning);
+    if(cpu < 0 || cpu >= CPU_SETSIZE)
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+Affinity_guard::Affinity_guard() {
+    _valid = pthread_getaffinity_np(pthread_self(), sizeof(_saved), &_saved) == 0;
+}
+
+Affinity_guard::~Affinity_guard() {
+    if(_valid)
+        pthread_setaffinity_np(pthread_self(), sizeof(_saved), &_saved);
+}
+
+template<typename T>
+Large_array<T>::Large_array(size_t count, const Placement &placement) {
+    if(count == 0)
+        return;
+
+    size_t bytes = count * sizeof(T);
+    size_t rounded = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    void *mapped = MAP_FAILED;
+
+    if(placement.pages == Page_size::EXPLICIT) {
+        mapped = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(mapped != MAP_FAILED) {
+            _bytes = rounded;
+            _pages = Page_size::EXPLICIT;
+        }
+    }
+
+    if(mapped == MAP_FAILED && placement.pages != Page_size::SMALL) {
+        //Transparent huge pages need 2 MiB aligned memory, so a huge page more is mapped and
+        //the ends trimmed off
+        void *wide = mmap(nullptr, rounded + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(wide != MAP_FAILED) {
+            uintptr_t start = reinterpret_cast<uintptr_t>(wide);
+            uintptr_t aligned = (start + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+            if(aligned > start)
+                munmap(wide, aligned - start);
+            if(aligned + rounded < start + rounded + HUGE_PAGE)
+                munmap(reinterpret_cast<void *>(aligned + rounded), start + HUGE_PAGE - aligned);
+
+            mapped = reinterpret_cast<void *>(aligned);
+            _bytes = rounded;
+            _pages = madvise(mapped, rounded, MADV_HUGEPAGE) == 0 ? Page_size::TRANSPARENT : Page_size::SMALL;
+        }
+    }
+
+    if(mapped == MAP_FAILED) {
+        mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mapped == MAP_FAILED)
+            cmpt::error("Cannot map " + to_string(bytes >> 20) + " MiB: " + strerror(errno));
+        _bytes = bytes;
+        _pages = Page_size::SMALL;
+    }
+
+    //The policy only applies to pages not touched yet, so it is set before the elements are made
+    const Numa_topology &topology = Numa_topology::get();
+    if(placement.interleave && topology.nodes() > 1) {
+        const static int MPOL_INTERLEAVE_MODE = 3;
+        const static int MASK_BITS = 1024;
+        unsigned long mask[MASK_BITS / (8 * sizeof(unsigned long))] = {0};
+        const int bits = 8 * sizeof(unsigned long);
+        for(int node = 0; node < topology.nodes(); node++)
+            if(topology.node_id(node) < MASK_BITS)
+                mask[topology.node_id(node) / bits] |= 1UL << (topology.node_id(node) % bits);
+        _interleaved = syscall(SYS_mbind, mapped, _bytes, MPOL_INTERLEAVE_MODE, mask, MASK_BITS, 0) == 0;
+    }
+
+    _data = static_cast<T *>(mapped);
+    _count = count;
+    for(size_t i = 0; i < count; i++)
+        new(&_data[i]) T();
+}
+
+template<typename T>
+void Large_array<T>::release() {
+    if(_data)
+        munmap(_data, _bytes);
+    _data = nullptr;
+    _count = 0;
+    _bytes = 0;
+}
+
+template<typename T>
+Large_array<T>::~Large_array() {
+    release();
+}
+
+template<typename T>
+Large_array<T>::Large_array(Large_array &&other) {
+    *this = move(other);
+}
+
+template<typename T>
+Large_array<T>& Large_array<T>::operator=(Large_array &&other) {
+    if(this != &other) {
+        release();
+        _data = other._data;
+        _count = other._count;
+        _bytes = other._bytes;
+        _pages = other._pages;
+        _interleaved = other._interleaved;
+        other._data = nullptr;
+        other._count = 0;
+        other._bytes = 0;
+    }
+    return *this;
+}
+
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef PIECE_H_INCLUDED
+#define PIECE_H_INCLUDED
+
+
+//The basic types shared by the board, its bitboard helpers and the players:
+//positions on the board, the pieces that can occupy them and the plain
+//vector representation of a board's contents.
+
+
+#include <string>
+#include <vector>
+#include <cassert>
+
+using namespace std;
+
+struct Position {
+    unsigned char row = -1;
+    unsigned char col = -1;
+
+    Position() {}
+
+    Position(unsigned char row, unsigned char col):
+    row(row),
+    col(col)
+    {}
+
+    Position(const Position &other, const int (&offset)[2]):
+    Position(other.row, other.col)
+    {
+        row += offset[0];
+        col += offset[1];
+    }
+};
+
+string to_string(Position pos) {
+    string out;
+    out += 'A' + pos.col;
+    out += to_string(pos.row + 1);
+
+    return out;
+}
+
+//These are the possible states that can be stored on the board,
+//and they are also used to keep track of which player controls
+//which pieces.
+enum class Piece : char {
+    EMPTY, P1, P2
+};
+
+inline Piece get_piece(bool first_player) {
+    if(first_player) return Piece::P1;
+    else return Piece::P2;
+}
+
+inline Piece get_opponent(Piece player) {
+    switch(player) {
+        case Piece::P1: return Piece::P2;
+        case Piece::P2: return Piece::P1;
+        case Piece::EMPTY: return Piece::EMPTY;
+        //Default case is unreachable
+        default: assert(false); return Piece::EMPTY;
+    }
+}
+
+typedef vector<vector<Piece>> Board_vec;
+
+
+#endif
@@ -3,6 +3,7 @@
 
 
 #include "Board.h"
+#include "Clock.h"
 
 using namespace std;
 
@@ -12,6 +13,10 @@ public:
 
     virtual string move() const = 0;
     virtual string name() const = 0;
+
+    //The clock of the game being played, for players that plan their time (null when the
+    //game is untimed). Players that do not plan their time ignore it.
+    virtual void set_clock(const Chess_clock *) {}
 };
 
 
@@ -0,0 +1,472 @@
+#ifndef POSITION_INDEX_H_INCLUDED
+#define POSITION_INDEX_H_INCLUDED
+
+
+#include "Board_state.h"
+#include "Bitboard.h"
+#include "Game_record.h"
+#include "Record_file.h"
+#include "cmpt_error.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+//An index from positions to the archived games that passed through them. The archive is a
+//text file of games, one per line, as move lists or GGF records (see Game_record.h). Games
+//are numbered from 0 in the order they appear, leaving out lines that cannot be read.
+//
+//Every position of every game is keyed by the position_hash of its canonical form (the
+//smallest of its 8 symmetries, seen from the player to move), so a position and its
+//rotations and reflections are found together. A posting records the game, the colour to
+//move and the move played next, turned to the canonical orientation. Two positions sharing
+//a 64 bit key would have their postings mixed, which is unlikely below billions of positions.
+//A finished position is keyed from the view of X, as no one is to move in it.
+//
+//The file holds, after its header, a table of games (where each line starts in the archive
+//and its final margin for X), then the postings sorted by key in blocks of BLOCK_POSTINGS,
+//then a directory of the first key and offset of each block. Within a block each key is
+//written as the difference from the one before, and each posting of the same key as the
+//difference from the one before, as variable length integers. The file is mapped into
+//memory, so a lookup reads the directory and a block or two, and nothing is loaded up front.
+
+const static char POSITION_INDEX_MAGIC[4] = {'R', 'V', 'X', '1'};
+
+//Where a game starts in the archive and how it ended, as stored in the index
+struct Indexed_game {
+    uint64_t archive_offset;
+    int32_t margin;  //Final disc margin for X
+    int32_t unused;
+};
+
+//The games through a position, with the results from the point of view of the player to
+//move in it and the moves played next
+struct Position_stats {
+    vector<uint64_t> games;
+    long long wins = 0;
+    long long draws = 0;
+    long long losses = 0;
+    long long total_margin = 0;
+
+    struct Next_move {
+        Position pos;
+        long long games = 0;
+        long long wins = 0;
+        long long draws = 0;
+    };
+    vector<Next_move> next_moves;  //Most played first. Symmetric moves in a symmetric position count together.
+    long long finished = 0;  //Games that ended in the position
+};
+
+//What the builder did
+struct Index_build_stats {
+    uint64_t games = 0;
+    uint64_t skipped = 0;  //Lines that were not readable games
+    uint64_t postings = 0;
+    uint64_t keys = 0;  //Distinct positions
+    uint64_t blocks = 0;
+    uint64_t bytes = 0;
+    int runs = 0;
+    int merge_passes = 0;
+};
+
+class Position_index {
+private:
+    const static int BLOCK_POSTINGS = 256;
+    const static int NO_MOVE = 64;
+
+    struct Header {
+        char magic[4];
+        uint32_t block_postings;
+        uint64_t games;
+        uint64_t postings;
+        uint64_t blocks;
+        uint64_t games_offset;
+        uint64_t data_offset;
+        uint64_t directory_offset;
+    };
+
+    struct Block_entry {
+        uint64_t first_key;
+        uint64_t offset;  //Of the block's data in the file, the entry after the last one holds the end
+
+        friend bool operator==(const Block_entry &a, const Block_entry &b) {
+            return a.first_key == b.first_key && a.offset == b.offset;
+        }
+    };
+
+    //A key and posting while the index is built: game << 8 | mover is P2 << 7 | next square
+    struct Key_posting {
+        uint64_t key;
+        uint64_t posting;
+
+        friend bool operator<(const Key_posting &a, const Key_posting &b) {
+            return a.key < b.key || (a.key == b.key && a.posting < b.posting);
+        }
+        friend bool operator==(const Key_posting &a, const Key_posting &b) {
+            return a.key == b.key && a.posting == b.posting;
+        }
+    };
+
+    const unsigned char *_data = nullptr;
+    size_t _size = 0;
+    Header _header;
+
+    //The key of a position and the symmetry that turns it to its canonical orientation
+    static uint64_t key(Bitboard own, Bitboard opp, int &symmetry_index);
+
+    static void put_varint(uint64_t value, string &out);
+    static uint64_t get_varint(const unsigned char *&in);
+
+    Block_entry block_entry(uint64_t block) const;
+
+public:
+    //Maps an index file into memory. Throws if it cannot be read.
+    explicit Position_index(const string &path);
+    ~Position_index();
+
+    Position_index(const Position_index&) = delete;
+    Position_index& operator=(const Position_index&) = delete;
+
+    uint64_t games() const;
+    uint64_t postings() const;
+    Indexed_game game(uint64_t id) const;
+
+    //Every game through the position with the given player to move. A player who has to pass
+    //is replaced by the opponent, as in the games.
+    Position_stats lookup(const Board_state &board, Piece to_move) const;
+
+    //Replays every game of the archive and writes its index. Sorting the postings takes about
+    //memory_records of 16 bytes, spilling to temporary files next to the index.
+    static Index_build_stats build(const string &archive, const string &index_path, size_t memory_records);
+};
+
+//Private methods
+
+uint64_t Position_index::key(Bitboard own, Bitboard opp, int &symmetry_index) {
+    symmetry_index = canonical(own, opp);
+    return position_hash(own, opp);
+}
+
+void Position_index::put_varint(uint64_t value, string &out) {
+    while(value >= 0x80) {
+        out += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+uint64_t Position_index::get_varint(const unsigned char *&in) {
+    uint64_t value = 0;
+    for(int shift = 0; ; shift += 7) {
+        unsigned char byte = *in++;
+        value |= uint64_t(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return value;
+    }
+}
+
+Position_index::Block_entry Position_index::block_entry(uint64_t block) const {
+    Block_entry entry;
+    memcpy(&entry, _data + _header.directory_offset + block * sizeof(Block_entry), sizeof(entry));
+    return entry;
+}
+
+
+//Public methods
+
+Position_index::Position_index(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        cmpt::error("Cannot open " + path + ": " + strerror(errno));
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(Header)) {
+        close(fd);
+        cmpt::error(path + " is not a position index");
+    }
+
+    _size = info.st_size;
+    void *mapped = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        cmpt::error("Cannot map " + path + ": " + strerror(errno));
+    _data = static_cast<const unsigned char *>(mapped);
+
+    memcpy(&_header, _data, sizeof(Header));
+    bool valid = memcmp(_header.magic, POSITION_INDEX_MAGIC, 4) == 0 &&
+        _header.games_offset + _header.games * sizeof(Indexed_game) <= _size &&
+        _header.directory_offset + (_header.blocks + 1) * sizeof(Block_entry) <= _size;
+    if(!valid) {
+        munmap(const_cast<unsigned char *>(_data), _size);
+        cmpt::error(path + " is not a position index");
+    }
+}
+
+Position_index::~Position_index() {
+    munmap(const_cast<unsigned char *>(_data), _size);
+}
+
+uint64_t Position_index::games() const {
+    return _header.games;
+}
+
+uint64_t Position_index::postings() const {
+    return _header.postings;
+}
+
+Indexed_game Position_index::game(uint64_t id) const {
+    if(id >= _header.games)
+        cmpt::error("No game " + to_string(id) + " in the index");
+
+    Indexed_game out;
+    memcpy(&out, _data + _header.games_offset + id * sizeof(Indexed_game), sizeof(out));
+    return out;
+}
+
+Position_stats Position_index::lookup(const Board_state &board, Piece to_move) const {
+    Position_stats stats;
+
+    bool finished = board.game_over();
+    if(!finished && !board.can_move(to_move))
+        to_move = get_opponent(to_move);
+    if(finished)
+        to_move = Piece::P1;
+
+    int symmetry_index;
+    uint64_t wanted = key(board.discs(to_move), board.discs(get_opponent(to_move)), symmetry_index);
+
+    //The postings of a key can start in the block before the first one whose first key it is
+    uint64_t low = 0, high = _header.blocks;
+    while(low < high) {
+        uint64_t mid = (low + high) / 2;
+        if(block_entry(mid).first_key < wanted)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    long long counts[NO_MOVE + 1] = {0}, wins[NO_MOVE + 1] = {0}, draws[NO_MOVE + 1] = {0};
+    bool past = false;
+    for(uint64_t block = low > 0 ? low - 1 : 0; block < _header.blocks && !past; block++) {
+        Block_entry entry = block_entry(block);
+        if(entry.first_key > wanted)
+            break;
+
+        const unsigned char *in = _data + entry.offset;
+        const unsigned char *end = _data + block_entry(block + 1).offset;
+        uint64_t current = entry.first_key, posting = 0;
+        bool first = true;
+        while(in < end) {
+            uint64_t key_step = get_varint(in);
+            uint64_t value = get_varint(in);
+            current += key_step;
+            posting = (key_step == 0 && !first) ? posting + value : value;
+            first = false;
+
+            if(current > wanted) {
+                past = true;
+                break;
+            }
+            if(current < wanted)
+                continue;
+
+            uint64_t id = posting >> 8;
+            Piece mover = (posting & 0x80) ? Piece::P2 : Piece::P1;
+            int next = posting & 0x7f;
+            int margin = game(id).margin * (mover == Piece::P1 ? 1 : -1);
+
+            stats.games.push_back(id);
+            stats.total_margin += margin;
+            if(margin > 0) stats.wins++;
+            else if(margin == 0) stats.draws++;
+            else stats.losses++;
+
+            counts[next]++;
+            wins[next] += margin > 0;
+            draws[next] += margin == 0;
+        }
+    }
+
+    stats.finished = counts[NO_MOVE];
+    for(int square = 0; square < NO_MOVE; square++) {
+        if(!counts[square])
+            continue;
+
+        //The square in the position as asked about, which the symmetry takes to this one
+        int asked = 0;
+        while(symmetry(Bitboard(1) << asked, symmetry_index) != Bitboard(1) << square)
+            asked++;
+
+        Position_stats::Next_move move;
+        move.pos = square_position(asked);
+        move.games = counts[square];
+        move.wins = wins[square];
+        move.draws = draws[square];
+        stats.next_moves.push_back(move);
+    }
+    stable_sort(stats.next_moves.begin(), stats.next_moves.end(),
+        [](const Position_stats::Next_move &a, const Position_stats::Next_move &b) {return a.games > b.games;});
+
+    return stats;
+}
+
+Index_build_stats Position_index::build(const string &archive, const string &index_path, size_t memory_records) {
+    Index_build_stats stats;
+
+    ifstream in(archive, ios::binary);
+    if(!in)
+        cmpt::error("Cannot open " + archive);
+
+    //The games table goes straight to the index, right after the header, while the postings
+    //are sorted in runs
+    FILE *out = fopen(index_path.c_str(), "wb");
+    if(!out)
+        cmpt::error("Cannot create " + index_path + ": " + strerror(errno));
+    auto write = [&](const void *data, size_t size) {
+        if(size && fwrite(data, size, 1, out) != 1)
+            cmpt::error("Cannot write " + index_path + ": " + strerror(errno));
+        stats.bytes += size;
+    };
+
+    Header header = {};
+    memcpy(header.magic, POSITION_INDEX_MAGIC, 4);
+    header.block_postings = BLOCK_POSTINGS;
+    header.games_offset = sizeof(Header);
+    write(&header, sizeof(header));
+
+    string temp_prefix = index_path + ".run";
+    vector<string> runs;
+    vector<Key_posting> buffer;
+    buffer.reserve(max(memory_records, MIN_RECORD_BUFFER));
+
+    auto add = [&](Bitboard own, Bitboard opp, Piece mover, int next) {
+        int symmetry_index;
+        uint64_t k = key(own, opp, symmetry_index);
+        if(next != NO_MOVE)
+            next = first_square(symmetry(Bitboard(1) << next, symmetry_index));
+
+        buffer.push_back({k, stats.games << 8 | uint64_t(mover == Piece::P2) << 7 | uint64_t(next)});
+        if(buffer.size() == buffer.capacity()) {
+            runs.push_back(temp_prefix + to_string(runs.size()));
+            write_run(buffer, runs.back(), false);
+            buffer.clear();
+        }
+    };
+
+    string line;
+    uint64_t offset = 0;
+    Game_record record;
+    string error;
+    while(getline(in, line)) {
+        uint64_t line_offset = offset;
+        offset += line.size() + 1;
+
+        if(line.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        if(!read_game_record(line, record, error)) {
+            stats.skipped++;
+            continue;
+        }
+
+        for(const Recorded_move &move: record.moves) {
+            const Board_state &board = move.board;
+            add(board.discs(move.player), board.discs(get_opponent(move.player)), move.player,
+                move.move.row * 8 + move.move.col);
+        }
+
+        const Board_state &last = record.final_board;
+        if(last.game_over()) {
+            add(last.p1, last.p2, Piece::P1, NO_MOVE);
+        } else if(!record.moves.empty()) {
+            Piece next = get_opponent(record.moves.back().player);
+            if(!last.can_move(next))
+                next = get_opponent(next);
+            add(last.discs(next), last.discs(get_opponent(next)), next, NO_MOVE);
+        }
+
+        Indexed_game game = {line_offset, int32_t(record.margin), 0};
+        write(&game, sizeof(game));
+        stats.games++;
+    }
+
+    if(!buffer.empty()) {
+        runs.push_back(temp_prefix + to_string(runs.size()));
+        write_run(buffer, runs.back(), false);
+    }
+    vector<Key_posting>().swap(buffer);
+    stats.runs = runs.size();
+
+    //The merged postings are cut into blocks as they arrive
+    header.games = stats.games;
+    header.data_offset = stats.bytes;
+    string directory_path = index_path + ".directory";
+    Record_writer<Block_entry> directory(directory_path, memory_records / (MERGE_FAN_IN + 1), false);
+    string block;
+    int in_block = 0;
+    uint64_t last_key = 0, last_posting = 0;  //Of the block
+
+    auto end_block = [&]() {
+        write(block.data(), block.size());
+        block.clear();
+        in_block = 0;
+    };
+
+    stats.merge_passes = merge_runs<Key_posting>(runs, index_path + ".merge", memory_records, false, [&](const Key_posting &entry) {
+        if(in_block == BLOCK_POSTINGS)
+            end_block();
+        if(in_block == 0) {
+            //A key carried over from the last block is not a new one
+            if(stats.postings > 0 && entry.key != last_key)
+                stats.keys++;
+            directory.write({entry.key, stats.bytes});
+            last_key = entry.key;
+            stats.blocks++;
+        }
+
+        if(stats.postings == 0 || (in_block > 0 && entry.key != last_key))
+            stats.keys++;
+
+        bool same_key = entry.key == last_key && in_block > 0;
+        put_varint(entry.key - last_key, block);
+        put_varint(same_key ? entry.posting - last_posting : entry.posting, block);
+
+        last_key = entry.key;
+        last_posting = entry.posting;
+        in_block++;
+        stats.postings++;
+    });
+    end_block();
+    directory.write({~uint64_t(0), stats.bytes});
+    directory.close();
+
+    //The directory is copied to the end, then the header is written again with the offsets
+    header.postings = stats.postings;
+    header.blocks = stats.blocks;
+    header.directory_offset = stats.bytes;
+    {
+        Record_reader<Block_entry> entries(directory_path, memory_records / 2);
+        Block_entry entry;
+        while(entries.next(entry))
+            write(&entry, sizeof(entry));
+    }
+    remove(directory_path.c_str());
+
+    if(fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1 || fclose(out) != 0)
+        cmpt::error("Cannot write " + index_path + ": " + strerror(errno));
+    return stats;
+}
+
+
+#endif
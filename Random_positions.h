@@ -0,0 +1,159 @@
+#ifndef RANDOM_POSITIONS_H_INCLUDED
+#define RANDOM_POSITIONS_H_INCLUDED
+
+
+#include "Piece.h"
+#include "Bitboard.h"
+#include "Board_state.h"
+
+#include <random>
+#include <climits>
+
+using namespace std;
+
+//Positions from random games on the 8x8 board, for the benchmarks and calibration tools.
+//The games are played on bitboards from the standard starting position, so a generator
+//seeded the same way gives the same positions in every program.
+
+//A position of a random game, with the discs of the player to move, who is piece, first
+struct Random_position {
+    Bitboard own;
+    Bitboard opp;
+    Piece piece;
+
+    int empties() const { return 64 - count_bits(own | opp); }
+    Board_vec board_vec() const;
+};
+
+//Returns one of the squares of moves, each as likely as the others
+template<typename Generator>
+int random_square(Generator &generator, Bitboard moves);
+
+//Chooses the move with the best 1 move search value of engine, which has the search_value
+//of Computer_player, with probability greedy and a random move otherwise, for games that
+//look more like real ones than purely random games do
+template<typename Engine>
+struct Engine_move {
+    Engine &engine;
+    double greedy;
+
+    template<typename Generator>
+    int operator()(Generator &generator, const Random_position &position, Bitboard moves) const;
+};
+
+//Plays a game from the starting position. visit(position, moves) is called on every
+//position reached, with the legal moves of the player to move, so with 0 before a pass
+//and at the end; the game stops early when it returns false. choose(generator, position,
+//moves) returns the square of each move, random_square if it is not given.
+template<typename Generator, typename Visit, typename Choose>
+void play_random_game(Generator &generator, Visit visit, Choose choose);
+template<typename Generator, typename Visit>
+void play_random_game(Generator &generator, Visit visit);
+
+//Plays random games until one reaches the given number of empty squares with the player
+//to move able to move, and returns that position. Games that end or pass there are
+//dropped, so the number of empty squares must be one a game can reach.
+template<typename Generator, typename Choose>
+Random_position random_position(Generator &generator, int empties, Choose choose);
+template<typename Generator>
+Random_position random_position(Generator &generator, int empties);
+
+
+inline Board_vec Random_position::board_vec() const {
+    Basic_board_state<8> state;
+    state.p1 = piece == Piece::P1 ? own : opp;
+    state.p2 = piece == Piece::P1 ? opp : own;
+    return state.to_vec();
+}
+
+template<typename Generator>
+int random_square(Generator &generator, Bitboard moves) {
+    int skip = generator() % count_bits(moves);
+    for(int i = 0; i < skip; i++)
+        moves &= moves - 1;
+    return first_square(moves);
+}
+
+template<typename Engine>
+template<typename Generator>
+int Engine_move<Engine>::operator()(Generator &generator, const Random_position &position, Bitboard moves) const {
+    int choice = random_square(generator, moves);
+    if(uniform_real_distribution<double>(0, 1)(generator) >= greedy)
+        return choice;
+
+    int best = INT_MIN;
+    for(; moves; moves &= moves - 1) {
+        int square = first_square(moves);
+        Bitboard flips = flipped_discs(position.own, position.opp, square);
+        Random_position next = {position.opp & ~flips, position.own | flips | (Bitboard(1) << square),
+            get_opponent(position.piece)};
+
+        int value = -1 * engine.search_value(next.board_vec(), next.piece, 0);
+        if(value > best) {
+            best = value;
+            choice = square;
+        }
+    }
+
+    return choice;
+}
+
+template<typename Generator, typename Visit, typename Choose>
+void play_random_game(Generator &generator, Visit visit, Choose choose) {
+    Basic_board_state<8> start = Basic_board_state<8>::start();
+    Random_position position = {start.p1, start.p2, Piece::P1};
+
+    while(true) {
+        Bitboard moves = legal_moves(position.own, position.opp);
+        if(!visit(position, moves))
+            return;
+
+        if(!moves) {
+            if(!legal_moves(position.opp, position.own))
+                return;
+            swap(position.own, position.opp);
+            position.piece = get_opponent(position.piece);
+            continue;
+        }
+
+        int square = choose(generator, position, moves);
+        Bitboard flips = flipped_discs(position.own, position.opp, square);
+        position.own |= flips | (Bitboard(1) << square);
+        position.opp &= ~flips;
+        swap(position.own, position.opp);
+        position.piece = get_opponent(position.piece);
+    }
+}
+
+template<typename Generator, typename Visit>
+void play_random_game(Generator &generator, Visit visit) {
+    play_random_game(generator, visit, [](Generator &g, const Random_position &, Bitboard moves) {
+        return random_square(g, moves);
+    });
+}
+
+template<typename Generator, typename Choose>
+Random_position random_position(Generator &generator, int empties, Choose choose) {
+    while(true) {
+        Random_position found;
+        Bitboard found_moves = 0;
+        play_random_game(generator, [&](const Random_position &position, Bitboard moves) {
+            found = position;
+            found_moves = moves;
+            return position.empties() > empties;
+        }, choose);
+
+        if(found.empties() == empties && found_moves)
+            return found;
+    }
+}
+
+template<typename Generator>
+Random_position random_position(Generator &generator, int empties) {
+    return random_position(generator, empties, [](Generator &g, const Random_position &, Bitboard moves) {
+        return random_square(g, moves);
+    });
+}
+
+
+#endif
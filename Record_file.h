@@ -0,0 +1,249 @@
+#ifndef RECORD_FILE_H_INCLUDED
+#define RECORD_FILE_H_INCLUDED
+
+
+#include "cmpt_error.h"
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+using namespace std;
+
+//Files of fixed size records, written as they are in memory, and the external sort built on
+//them: data too large for memory is sorted in runs that fit (write_run), and the runs are
+//merged (merge_runs). The record type needs operator< and operator==.
+
+//Fewest records buffered for any file
+const static size_t MIN_RECORD_BUFFER = 1 << 12;
+
+//Most runs merged at once. Each needs a buffer, so more would leave each a smaller share of memory.
+const static size_t MERGE_FAN_IN = 64;
+
+//Reads a file of records through a buffer
+template<typename T>
+class Record_reader {
+private:
+    static_assert(is_trivially_copyable<T>::value, "Records are read as raw bytes");
+
+    FILE *_file;
+    string _path;
+    vector<T> _buffer;
+    size_t _next = 0;
+    size_t _filled = 0;
+
+public:
+    Record_reader(const string &path, size_t buffer_records);
+    ~Record_reader();
+
+    //Returns false at the end of the file
+    bool next(T &record);
+    //Reads up to count records, returning how many were read
+    size_t read(T *out, size_t count);
+};
+
+//Writes records through a buffer. A unique writer leaves out any record equal to the one just
+//written, so writing a sorted sequence leaves no duplicates.
+template<typename T>
+class Record_writer {
+private:
+    static_assert(is_trivially_copyable<T>::value, "Records are written as raw bytes");
+
+    FILE *_file;
+    string _path;
+    bool _unique;
+    vector<T> _buffer;
+    T _last;
+    long long _written = 0;
+
+    void flush();
+
+public:
+    Record_writer(const string &path, size_t buffer_records, bool unique);
+    ~Record_writer();
+
+    //Returns false if a unique writer left the record out
+    bool write(const T &record);
+    void close();
+    long long written() const { return _written; }
+};
+
+//Sorts the records and writes them to a new file
+template<typename T>
+void write_run(vector<T> &records, const string &path, bool unique);
+
+//Merges sorted runs and hands every record, in order, to consume. Runs are merged into new
+//runs MERGE_FAN_IN at a time, named temp_prefix followed by a number, until one more pass can
+//merge them all. The memory is shared out between the buffers of the runs being merged. The
+//runs are deleted as they are used. Returns the number of merge passes.
+template<typename T, typename Consume>
+int merge_runs(vector<string> runs, const string &temp_prefix, size_t memory_records, bool unique, Consume consume);
+
+template<typename T>
+Record_reader<T>::Record_reader(const string &path, size_t buffer_records):
+    _path(path),
+    _buffer(max(buffer_records, MIN_RECORD_BUFFER))
+{
+    _file = fopen(path.c_str(), "rb");
+    if(!_file)
+        cmpt::error("Cannot open " + path + ": " + strerror(errno));
+}
+
+template<typename T>
+Record_reader<T>::~Record_reader() {
+    fclose(_file);
+}
+
+template<typename T>
+bool Record_reader<T>::next(T &record) {
+    if(_next == _filled) {
+        _filled = fread(_buffer.data(), sizeof(T), _buffer.size(), _file);
+        _next = 0;
+        if(_filled == 0) {
+            if(ferror(_file))
+                cmpt::error("Cannot read " + _path + ": " + strerror(errno));
+            return false;
+        }
+    }
+
+    record = _buffer[_next++];
+    return true;
+}
+
+template<typename T>
+size_t Record_reader<T>::read(T *out, size_t count) {
+    size_t done = 0;
+    while(done < count && next(out[done]))
+        done++;
+    return done;
+}
+
+template<typename T>
+Record_writer<T>::Record_writer(const string &path, size_t buffer_records, bool unique):
+    _path(path),
+    _unique(unique)
+{
+    _buffer.reserve(max(buffer_records, MIN_RECORD_BUFFER));
+    _file = fopen(path.c_str(), "wb");
+    if(!_file)
+        cmpt::error("Cannot create " + path + ": " + strerror(errno));
+}
+
+template<typename T>
+Record_writer<T>::~Record_writer() {
+    if(_file)
+        fclose(_file);
+}
+
+template<typename T>
+void Record_writer<T>::flush() {
+    if(!_buffer.empty() && fwrite(_buffer.data(), sizeof(T), _buffer.size(), _file) != _buffer.size())
+        cmpt::error("Cannot write " + _path + ": " + strerror(errno));
+    _buffer.clear();
+}
+
+template<typename T>
+bool Record_writer<T>::write(const T &record) {
+    if(_unique && _written > 0 && record == _last)
+        return false;
+
+    _buffer.push_back(record);
+    _last = record;
+    _written++;
+    if(_buffer.size() == _buffer.capacity())
+        flush();
+    return true;
+}
+
+template<typename T>
+void Record_writer<T>::close() {
+    flush();
+    if(fclose(_file) != 0)
+        cmpt::error("Cannot write " + _path + ": " + strerror(errno));
+    _file = nullptr;
+}
+
+template<typename T>
+void write_run(vector<T> &records, const string &path, bool unique) {
+    sort(records.begin(), records.end());
+
+    Record_writer<T> writer(path, 0, unique);
+    for(const T &record: records)
+        writer.write(record);
+    writer.close();
+}
+
+//Merges the runs in one pass, handing the records to consume
+template<typename T, typename Consume>
+void merge_pass(const vector<string> &runs, size_t buffer_records, Consume consume) {
+    vector<unique_ptr<Record_reader<T>>> readers;
+    for(const string &path: runs)
+        readers.emplace_back(new Record_reader<T>(path, buffer_records));
+
+    typedef pair<T, size_t> Head;
+    auto later = [](const Head &a, const Head &b) {return b.first < a.first;};
+    priority_queue<Head, vector<Head>, decltype(later)> heads(later);
+
+    T record;
+    for(size_t i = 0; i < readers.size(); i++)
+        if(readers[i]->next(record))
+            heads.push({record, i});
+
+    while(!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        consume(head.first);
+
+        if(readers[head.second]->next(record))
+            heads.push({record, head.second});
+    }
+}
+
+template<typename T, typename Consume>
+int merge_runs(vector<string> runs, const string &temp_prefix, size_t memory_records, bool unique, Consume consume) {
+    size_t buffer_records = memory_records / (MERGE_FAN_IN + 1);
+    int passes = 1;
+    int next_name = 0;
+
+    while(runs.size() > MERGE_FAN_IN) {
+        vector<string> merged;
+        for(size_t first = 0; first < runs.size(); first += MERGE_FAN_IN) {
+            vector<string> group(runs.begin() + first, runs.begin() + min(runs.size(), first + MERGE_FAN_IN));
+            string path = temp_prefix + to_string(next_name++);
+
+            Record_writer<T> writer(path, buffer_records, unique);
+            merge_pass<T>(group, buffer_records, [&](const T &record) {writer.write(record);});
+            writer.close();
+
+            for(const string &run: group)
+                remove(run.c_str());
+            merged.push_back(path);
+        }
+        runs = merged;
+        passes++;
+    }
+
+    //The last pass drops duplicates itself, as there is no writer to do it
+    bool first = true;
+    T last;
+    merge_pass<T>(runs, buffer_records, [&](const T &record) {
+        if(unique && !first && record == last)
+            return;
+        consume(record);
+        last = record;
+        first = false;
+    });
+
+    for(const string &run: runs)
+        remove(run.c_str());
+    return passes;
+}
+
+
+#endif
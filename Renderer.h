@@ -0,0 +1,338 @@
+#ifndef RENDERER_H_INCLUDED
+#define RENDERER_H_INCLUDED
+
+
+#include "cmpt_error.h"
+#include "Piece.h"
+#include "Board_state.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+const static string RESET = "\033[0m";
+const static string BLINK = "\033[5m";
+const static string BLINK_OFF = "\033[25m";
+
+//Draws boards for the terminal. The drawing templates and palette colours are built once
+//for each combination of size and palette and shared by every board using them, so boards
+//themselves carry only a pointer to their renderer. Renderers are never changed after
+//they are built and can be used from any thread.
+template<int N>
+class Basic_renderer {
+public:
+    //What a square shows. Legal moves are drawn in the colour of the player who can play them.
+    enum Cell : unsigned char {
+        EMPTY, P1, P2, P1_MOVE, P2_MOVE, CELLS
+    };
+
+private:
+    bool _large_board;
+    string _BG_COLOR;
+    string _BOARD_COLOR;
+    string _EMPTY_COLOR;
+    string _P1_COLOR;
+    string _P2_COLOR;
+
+    //Row labels are padded to the same width, so boards with 10 rows stay aligned
+    const static int LABEL_WIDTH = N < 10 ? 1 : 2;
+
+    //Small Board Drawing Instructions:
+    //The column labels and the board frame are generated for the size of the board,
+    //for 8x8 each row is "║ # # # # # # # # ║" framed by "╔═...═╗" and "╚═...═╝".
+    const string _S_EMPTY = "·";
+    const string _S_POSSIBLE = "•";
+    const string _S_Piece = "■";
+    const string _S_COL_LABELS = col_labels(2);
+    const string _S_BOARD_TOP = frame("╔", "╗", 2 * N + 1);
+    const string _S_BOARD_BOTTOM = frame("╚", "╝", 2 * N + 1);
+
+    //Large Board Drawing Instructions:
+    const string _L_COL_LABELS = col_labels(3);
+    const string _L_BOARD_TOP = frame("╔", "╗", 3 * N + 2);
+    const string _L_BOARD_BOTTOM = frame("╚", "╝", 3 * N + 2);
+
+    const string _L_POSSIBLE[2] = {
+        " _ ",
+        "   "
+    };
+    const string _L_EMPTY[2] = {
+        "┌─┐",
+        "└─┘"
+    };
+    const string _L_Piece[2] = {
+        "╔═╗",
+        "╚═╝"
+    };
+
+    //Every part of a frame is put together with its colours once, when the renderer is
+    //built, so drawing only appends precomputed strings. A tile is indexed by its Cell and,
+    //on the large board, by which of its two lines it is.
+    string _header;
+    string _footer;
+    string _line_start[N][2];
+    string _line_end[N][2];
+    string _tiles[CELLS][2];
+
+    Basic_renderer(bool large_board, int palette);
+
+    //Drawing template helpers
+    static string col_labels(int spacing);
+    static string frame(const string &left, const string &right, int width);
+    static string row_label(int row, bool left);
+
+    //Display helper methods
+    static int color_code(vector<int> rgb);
+    static string foreground(int grayscale);
+    static string foreground(vector<int> rgb);
+    static string background(int grayscale);
+    static string background(vector<int> rgb);
+
+    //Lines of the frame for each row of squares
+    int lines_per_row() const { return _large_board ? 2 : 1; }
+
+public:
+    const static int PALETTES = 3;  //The number of colour palettes available
+
+    //The shared renderer for a size and palette
+    static const Basic_renderer& get(bool large_board, int palette);
+
+    Basic_renderer(const Basic_renderer &other) = delete;
+    Basic_renderer& operator=(const Basic_renderer &other) = delete;
+
+    bool large() const { return _large_board; }
+
+    //Gets the display string for a board, showing the legal moves of the given player
+    //(none for Piece::EMPTY)
+    string render(const Basic_board_state<N> &board, Piece active_player) const;
+    //Appends the display string to out, with the legal moves already found. Drawing into
+    //the same string each time reuses its memory.
+    void render(const Basic_board_state<N> &board, Bits<N> moves, Piece active_player, string &out) const;
+
+    static Cell cell(const Basic_board_state<N> &board, Bits<N> moves, Piece active_player, int row, int col);
+
+    //The number of lines in a frame, which has no newline after the last one
+    int lines() const { return N * lines_per_row() + 4; }
+    //Appends escape codes that redraw one square of a frame whose top line is on screen
+    //line top (counting from 1), leaving the colours reset
+    void render_cell(Cell cell, int row, int col, int top, string &out) const;
+};
+
+typedef Basic_renderer<8> Renderer;
+
+//Private Methods:
+
+template<int N>
+Basic_renderer<N>::Basic_renderer(bool large_board, int palette): _large_board{large_board} {
+    switch(palette) {
+        case 0:
+            _BG_COLOR = background({1,2,0});
+            _BOARD_COLOR = foreground(6);
+            _EMPTY_COLOR = foreground({1, 3, 0});
+            _P1_COLOR = foreground(0);
+            _P2_COLOR = foreground(23);
+            break;
+
+        case 1:
+            _BG_COLOR = background(2);
+            _BOARD_COLOR = foreground(23);
+            _EMPTY_COLOR = foreground({1, 0, 0});
+            _P1_COLOR = foreground({1,1,5});
+            _P2_COLOR = foreground({1,5,1});
+            break;
+
+        case 2:
+            _BG_COLOR = "";
+            _BOARD_COLOR = foreground(23);
+            _EMPTY_COLOR = foreground(6);
+            _P1_COLOR = foreground({1, 1, 5});
+            _P2_COLOR = foreground({1, 5, 1});
+            break;
+
+        default:
+            cmpt::error("Color palette does not exist");
+    }
+
+    string padding(LABEL_WIDTH, ' ');
+    const string &labels = _large_board ? _L_COL_LABELS : _S_COL_LABELS;
+    const string &top = _large_board ? _L_BOARD_TOP : _S_BOARD_TOP;
+    const string &bottom = _large_board ? _L_BOARD_BOTTOM : _S_BOARD_BOTTOM;
+
+    _header = " " + labels + "\n" + padding + _BG_COLOR + _BOARD_COLOR + top + RESET + "\n";
+    _footer = padding + _BG_COLOR + _BOARD_COLOR + bottom + RESET + "\n " + labels;
+
+    for(int row = 0; row < N; row++) {
+        if(_large_board) {
+            _line_start[row][0] = row_label(row, true) + _BG_COLOR + _BOARD_COLOR + "║ ";
+            _line_start[row][1] = padding + _BG_COLOR + _BOARD_COLOR + "║ ";
+            _line_end[row][0] = _BOARD_COLOR + " ║" + RESET + padding + "\n";
+            _line_end[row][1] = _BOARD_COLOR + " ║" + RESET + row_label(row, false) + "\n";
+        } else {
+            _line_start[row][0] = row_label(row, true) + _BG_COLOR + _BOARD_COLOR + "║";
+            _line_end[row][0] = " ║" + RESET + row_label(row, false) + "\n";
+        }
+    }
+
+    for(int line = 0; line < 2; line++) {
+        if(_large_board) {
+            _tiles[EMPTY][line] = _EMPTY_COLOR + _L_EMPTY[line];
+            _tiles[P1][line] = _P1_COLOR + _L_Piece[line];
+            _tiles[P2][line] = _P2_COLOR + _L_Piece[line];
+            _tiles[P1_MOVE][line] = BLINK + _P1_COLOR + _L_POSSIBLE[line] + BLINK_OFF;
+            _tiles[P2_MOVE][line] = BLINK + _P2_COLOR + _L_POSSIBLE[line] + BLINK_OFF;
+        } else {
+            //Each small tile follows a space and puts the frame colour back after itself
+            _tiles[EMPTY][line] = " " + _EMPTY_COLOR + _S_EMPTY + _BOARD_COLOR;
+            _tiles[P1][line] = " " + _P1_COLOR + _S_Piece + _BOARD_COLOR;
+            _tiles[P2][line] = " " + _P2_COLOR + _S_Piece + _BOARD_COLOR;
+            _tiles[P1_MOVE][line] = " " + _P1_COLOR + BLINK + _S_POSSIBLE + BLINK_OFF + _BOARD_COLOR;
+            _tiles[P2_MOVE][line] = " " + _P2_COLOR + BLINK + _S_POSSIBLE + BLINK_OFF + _BOARD_COLOR;
+        }
+    }
+}
+
+template<int N>
+string Basic_renderer<N>::col_labels(int spacing) {
+    string out(spacing, ' ');
+    for(int col = 0; col < N; col++) {
+        out += char('A' + col);
+        out += string(spacing - 1, ' ');
+    }
+    out += ' ';
+
+    return string(LABEL_WIDTH - 1, ' ') + out;
+}
+
+template<int N>
+string Basic_renderer<N>::frame(const string &left, const string &right, int width) {
+    string out = left;
+    for(int i = 0; i < width; i++)
+        out += "═";
+
+    return out + right;
+}
+
+template<int N>
+string Basic_renderer<N>::row_label(int row, bool left) {
+    string label = to_string(row + 1);
+    string padding(LABEL_WIDTH - label.length(), ' ');
+
+    if(left) return padding + label;
+    else return label + padding;
+}
+
+template<int N>
+int Basic_renderer<N>::color_code(vector<int> rgb) {
+    int r = rgb[0];
+    int g = rgb[1];
+    int b = rgb[2];
+
+    if((r < 0) || (r > 5) ||
+        (g < 0) || (g > 5) ||
+        (b < 0) || (b > 5))
+        cmpt::error("RGB value out of range");
+
+    return 16 + (36 * r) + (6 * g) + b;
+}
+
+template<int N>
+string Basic_renderer<N>::foreground(int grayscale) {
+    if((grayscale < 0) || (grayscale > 23))
+        cmpt::error("Grayscale value out of range");
+
+    string graycode = to_string(grayscale + 232);
+    return "\033[38;5;" + graycode + "m";
+}
+
+template<int N>
+string Basic_renderer<N>::foreground(vector<int> rgb) {
+    return "\033[38;5;" + to_string(color_code(rgb)) + "m";
+}
+
+template<int N>
+string Basic_renderer<N>::background(int grayscale) {
+    if((grayscale < 0) || (grayscale > 23))
+        cmpt::error("Grayscale value out of range");
+
+    string graycode = to_string(grayscale + 232);
+    return "\033[48;5;" + graycode + "m";
+}
+
+template<int N>
+string Basic_renderer<N>::background(vector<int> rgb) {
+    return "\033[48;5;" + to_string(color_code(rgb)) + "m";
+}
+
+
+//Public Methods
+
+template<int N>
+const Basic_renderer<N>& Basic_renderer<N>::get(bool large_board, int palette) {
+    if(palette < 0 || palette >= PALETTES)
+        cmpt::error("Color palette does not exist");
+
+    //Built on first use, which C++11 makes thread safe. The renderers are never destroyed,
+    //so boards in other static objects can still draw during shutdown.
+    static const Basic_renderer *renderers[2][PALETTES] = {};
+    static bool built = [] {
+        for(int large = 0; large < 2; large++)
+            for(int p = 0; p < PALETTES; p++)
+                renderers[large][p] = new Basic_renderer(large, p);
+        return true;
+    }();
+    (void) built;
+
+    return *renderers[large_board][palette];
+}
+
+template<int N>
+string Basic_renderer<N>::render(const Basic_board_state<N> &board, Piece active_player) const {
+    Bits<N> moves = active_player == Piece::EMPTY ? 0 : board.legal_moves(active_player);
+
+    string out;
+    render(board, moves, active_player, out);
+    return out;
+}
+
+template<int N>
+void Basic_renderer<N>::render(const Basic_board_state<N> &board, Bits<N> moves, Piece active_player, string &out) const {
+    out += _header;
+
+    for(int row = 0; row < N; row++) {
+        for(int line = 0; line < lines_per_row(); line++) {
+            out += _line_start[row][line];
+            for(int col = 0; col < N; col++)
+                out += _tiles[cell(board, moves, active_player, row, col)][line];
+            out += _line_end[row][line];
+        }
+    }
+
+    out += _footer;
+}
+
+template<int N>
+typename Basic_renderer<N>::Cell Basic_renderer<N>::cell(const Basic_board_state<N> &board, Bits<N> moves, Piece active_player, int row, int col) {
+    if(moves & square_bit<N>(row, col))
+        return active_player == Piece::P1 ? P1_MOVE : P2_MOVE;
+
+    switch(board.at(row, col)) {
+        case Piece::P1: return P1;
+        case Piece::P2: return P2;
+        default: return EMPTY;
+    }
+}
+
+template<int N>
+void Basic_renderer<N>::render_cell(Cell cell, int row, int col, int top, string &out) const {
+    //Squares start after the row label, the frame and a space, and are 2 or 3 columns apart
+    int x = LABEL_WIDTH + (_large_board ? 3 + 3 * col : 2 + 2 * col);
+    int y = top + 2 + row * lines_per_row();
+
+    for(int line = 0; line < lines_per_row(); line++) {
+        out += "\033[" + to_string(y + line) + ";" + to_string(x) + "H";
+        out += _BG_COLOR + _BOARD_COLOR + _tiles[cell][line] + RESET;
+    }
+}
+
+
+#endif
@@ -11,6 +11,8 @@
 #include "Player.h"
 #include "Human_player.h"
 #include "Computer_player.h"
+#include "Mcts_player.h"
+#include "Network.h"
 #include "Game.h"
 #include "Game_host.h"
 
@@ -42,6 +44,41 @@ using namespace std;
 const static int BOT_SEARCH_DEPTH = 7;  //Can be set to 10 on native linux when not using valgrind
 const static int BOT_END_SEARCH_DEPTH = 11;  //Can be set to 15 in the same conditions as above
 
+//BOT_SOLVE_TIME replaces BOT_END_SEARCH_DEPTH for the bots' own moves (HINT and ANALYZE still
+//use the fixed depth). Instead of switching at a fixed number of empty squares, the bot predicts
+//how long searching to the end would take from the empty squares, the moves available and how
+//fast it has been searching, and only does so when that fits in this many milliseconds. When
+//proving a win, loss or draw fits but finding the exact margin does not, it proves that instead.
+//Set it to 0 to use BOT_END_SEARCH_DEPTH.
+const static int BOT_SOLVE_TIME = 3000;
+
+//BOT_SELECTIVITY sets how aggressively the bot prunes moves that a shallow search predicts
+//are not worth searching deeply (Multi-ProbCut). 0 turns this off and searches every move in
+//full, higher values (up to 4) search faster and allow the depth values above to be raised,
+//but occasionally miss the best move.
+const static int BOT_SELECTIVITY = 2;
+
+//The Monte Carlo bot thinks for a fixed time instead of to a fixed depth, and gets stronger
+//the more random games it can play in that time. BOT_MCTS_THREADS is the number of threads it
+//plays them on, with 0 using every core.
+const static int BOT_MCTS_TIME = 2000;  //In milliseconds
+const static int BOT_MCTS_THREADS = 0;
+
+//Weights for the neural network bot, written by the train_network program. The bot is only
+//offered when this file is found.
+const static string BOT_NETWORK_FILE = "reversi.net";
+
+//BOT_TIME_LIMIT is a hard limit on how long the searching bots (and HINT and ANALYZE) think
+//about a move, in milliseconds, with 0 for no limit. A search that runs out of time plays the
+//best move it has found so far. Typing STOP while the bot is thinking does the same at once.
+const static int BOT_TIME_LIMIT = 30000;
+
+//BOT_TIME_CONTROL is the clock games start with, changed with the CLOCK command: "none" for
+//untimed games, "5" for 5 minutes each, "3+2" for 3 minutes and 2 more seconds after each
+//move, or "10/move" for 10 seconds on every move. On a clock, the bots share their time out
+//between the moves left instead of searching to a fixed depth, and never run out of it.
+const static string BOT_TIME_CONTROL = "none";
+
 //If this flag is set to true, the computer will wait for the user
 //to hit enter before it plays its move. If it is set to false, it will
 //play as soon as it is done processing its move.
@@ -54,6 +91,11 @@ private:
     Player *_second = nullptr;
     Game *_game = nullptr;
 
+    Network _network;
+    bool _network_loaded = false;
+
+    Time_control _time_control = Time_control::parse(BOT_TIME_CONTROL);
+
     bool _exit = false;
 
 public:
@@ -67,12 +109,19 @@ public:
     void choose_size();
     void choose_palette();
     void choose_players();
+    void choose_clock();
 
     void handle_command(string s);
     void list_commands() const;
+
+    //Searches the current position for the player to move. A hint only shows the
+    //best move, a full analysis ranks every legal move after each search depth.
+    void analyze(bool hint_only);
 };
 
 Reversi::Reversi(bool default_display) {
+    _network_loaded = _network.load(BOT_NETWORK_FILE);
+
     if(!default_display) {
         choose_size();
         choose_palette();
@@ -105,6 +154,7 @@ void Reversi::run() {
 
 void Reversi::play() {
     _game = new Game(this, &_board, _first, _second);
+    _game->set_time_control(_time_control);
     _game->play();
     delete _game;
     _game = nullptr;
@@ -227,20 +277,82 @@ void Reversi::choose_players() {
             }
         }
 
-        if(selection == "1") {
+        bool play_first = selection == "1";
+        if(play_first) {
             cout << "Playing first" << endl << endl;
-            _first = new Human_player(Piece::P1, name);
-            _second = new Computer_player(Piece::P2, &_board, BOT_SEARCH_DEPTH, BOT_END_SEARCH_DEPTH, BOT_WAIT);
+        } else {
+            cout << "Playing second." << endl << endl;
         }
 
-        if(selection == "2") {
-            cout << "Playing second." << endl << endl;
-            _first = new Computer_player(Piece::P1, &_board, BOT_SEARCH_DEPTH, BOT_END_SEARCH_DEPTH, BOT_WAIT);
+        selected = false;
+        while(!selected) {
+            cout << "Choose your opponent:" << endl;
+            cout << "1) Robo (searches ahead and evaluates positions)" << endl;
+            cout << "2) Monty (plays out random games, Monte Carlo tree search)" << endl;
+            if(_network_loaded)
+                cout << "3) Neo (searches ahead and evaluates positions with a neural network)" << endl;
+
+            getline(cin, selection);
+
+            if(selection == "1" || selection == "2" || (_network_loaded && selection == "3")) {
+                selected = true;
+            } else if(_network_loaded) {
+                cout << "Invalid selection, please type \"1\", \"2\" or \"3\"" << endl << endl;
+            } else {
+                cout << "Invalid selection, please type \"1\" or \"2\"" << endl << endl;
+            }
+        }
+
+        Piece computer_piece = play_first ? Piece::P2 : Piece::P1;
+        Player *computer;
+        if(selection == "1") {
+            Computer_player *robo = new Computer_player(computer_piece, &_board, BOT_SEARCH_DEPTH, BOT_END_SEARCH_DEPTH, BOT_WAIT);
+            robo->set_selectivity(BOT_SELECTIVITY);
+            robo->set_time_limit(BOT_TIME_LIMIT);
+            robo->set_solve_budget(BOT_SOLVE_TIME);
+            computer = robo;
+        } else if(selection == "2") {
+            computer = new Mcts_player(computer_piece, &_board, BOT_MCTS_TIME, BOT_MCTS_THREADS, BOT_WAIT);
+        } else {
+            Computer_player *neo = new Computer_player(computer_piece, &_board, BOT_SEARCH_DEPTH, BOT_END_SEARCH_DEPTH, BOT_WAIT, "Neo");
+            neo->set_network(&_network);
+            neo->set_time_limit(BOT_TIME_LIMIT);
+            neo->set_solve_budget(BOT_SOLVE_TIME);
+            computer = neo;
+        }
+        cout << endl;
+
+        if(play_first) {
+            _first = new Human_player(Piece::P1, name);
+            _second = computer;
+        } else {
+            _first = computer;
             _second = new Human_player(Piece::P2, name);
         }
     }
 }
 
+void Reversi::choose_clock() {
+    bool selected = false;
+    while(!selected) {
+        cout << "Current clock: " << to_string(_time_control) << endl;
+        cout << "Enter a time control: NONE, minutes each (5), minutes plus seconds per move (3+2)" << endl;
+        cout << "or seconds for every move (10/MOVE)" << endl;
+
+        string selection;
+        getline(cin, selection);
+
+        try {
+            _time_control = Time_control::parse(selection);
+            selected = true;
+        } catch(const exception &e) {
+            cout << e.what() << endl << endl;
+        }
+    }
+
+    cout << "Clock set to " << to_string(_time_control) << endl << endl;
+}
+
 void Reversi::handle_command(string s) {
 
 
@@ -261,12 +373,26 @@ void Reversi::handle_command(string s) {
         } else {
             cout << "There is no game to quit" << endl;
         }
+    } else if(s == "HINT" || s == "ANALYZE") {
+        if(_game) {
+            analyze(s == "HINT");
+        } else {
+            cout << "There is no game to analyze" << endl;
+        }
+    } else if(s == "STOP") {
+        cout << "The computer is not thinking" << endl;
     } else if(s == "PLAYERS") {
         if(!_game) {
             choose_players();
         } else {
             cout << "Cannot change players while in game, please quit first" << endl;
         }
+    } else if(s == "CLOCK") {
+        if(!_game) {
+            choose_clock();
+        } else {
+            cout << "Cannot change the clock while in game, please quit first" << endl;
+        }
     } else if(s == "PLAY") {
         if(!_game) {
             play();
@@ -287,12 +413,16 @@ void Reversi::list_commands() const {
     out += "\n";
     out += "IN GAME COMMANDS - \n";
     out += "QUIT: Quit current game\n";
+    out += "HINT: Suggest a move for the current player\n";
+    out += "ANALYZE: Score every legal move for the current player\n";
+    out += "STOP: Make the computer play the best move it has found so far\n";
     out += "Instructions:\n";
     out += "-Type the row and column of a position to place a piece there\n";
     out += "-It does not matter whether you put the row or the column first\n";
     out += "\n";
     out += "OUT OF GAME COMMANDS - \n";
     out += "PLAYERS: Change players\n";
+    out += "CLOCK: Change the time control\n";
     out += "PLAY: Start new game\n";
 
     cout << endl << out << endl;
@@ -304,5 +434,53 @@ void Reversi::list_commands() const {
     }
 }
 
+void Reversi::analyze(bool hint_only) {
+    Piece piece = _game->active_player();
+    Computer_player analyst(piece, &_board, BOT_SEARCH_DEPTH, BOT_END_SEARCH_DEPTH, false, "Analysis");
+    analyst.set_time_limit(BOT_TIME_LIMIT);
+
+    if(!_board.can_move(piece)) {
+        cout << "No legal moves to analyze" << endl;
+        return;
+    }
+
+    auto print_line = [](const Move_analysis &analysis) {
+        cout << to_string(analysis.pos) << "  " << value_string(analysis.value, analysis.exact) << "  (";
+        for(unsigned int i = 0; i < analysis.line.size(); i++) {
+            if(i > 0) cout << " ";
+            cout << to_string(analysis.line[i]);
+        }
+        cout << ")" << endl;
+    };
+
+    cout << "Analyzing..." << endl;
+
+    if(hint_only) {
+        vector<Move_analysis> results = analyst.analyze(piece);
+        if(results.empty()) {
+            cout << "Ran out of time before finding a move" << endl;
+        } else {
+            cout << "Suggested move: ";
+            print_line(results.front());
+        }
+    } else {
+        analyst.analyze(piece, [&](const vector<Move_analysis> &results) {
+            if(results.front().exact)
+                cout << endl << "Searched to end of game:" << endl;
+            else
+                cout << endl << "Depth " << results.front().depth << ":" << endl;
+
+            for(unsigned int i = 0; i < results.size(); i++) {
+                cout << i + 1 << ") ";
+                print_line(results[i]);
+            }
+        });
+    }
+
+    cout << endl << "Hit enter to continue..." << endl;
+    string trash;
+    getline(cin, trash);
+}
+
 
 #endif
@@ -0,0 +1,219 @@
+#ifndef SOCKET_H_INCLUDED
+#define SOCKET_H_INCLUDED
+
+
+//Sockets for the programs that talk to each other. An address is either "unix:<path>"
+//for a Unix domain socket or "<host>:<port>" for TCP. Messages travel in frames: a 4 byte
+//big endian length followed by that many bytes, so the reader always knows where one
+//message ends and the next begins.
+
+
+#include "cmpt_error.h"
+
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+//Returns a socket listening on the address. A Unix socket file left behind by an earlier
+//run is replaced.
+int listen_socket(const string &address);
+//Returns a socket connected to the address, or -1 if nothing is listening there
+int connect_socket(const string &address);
+void set_nonblocking(int fd);
+
+//A socket carrying frames. Sends block until the whole frame is written, receives only
+//read what has already arrived, so a loop waiting on poll never blocks on a slow peer.
+class Connection {
+private:
+    int _fd;
+    string _input;  //Bytes received but not yet taken as frames
+
+    //Larger frames mean the peer is not speaking the protocol
+    const static size_t MAX_FRAME = 1 << 20;
+
+public:
+    explicit Connection(int fd);
+    ~Connection();
+    Connection(const Connection &) = delete;
+    Connection& operator=(const Connection &) = delete;
+
+    int fd() const;
+
+    //Returns false if the connection has failed
+    bool send_frame(const string &payload);
+    //Reads whatever has arrived. Returns false once the peer has closed the connection
+    //or it has failed.
+    bool receive();
+    //Takes the next complete frame that has been received, if there is one
+    bool next_frame(string &payload);
+};
+
+//Splits "unix:<path>" or "<host>:<port>" into its parts. Returns true for a Unix address.
+bool parse_address(const string &address, string &host, string &port) {
+    if(address.compare(0, 5, "unix:") == 0) {
+        host = address.substr(5);
+        port = "";
+        return true;
+    }
+
+    size_t colon = address.rfind(':');
+    if(colon == string::npos)
+        cmpt::error("Addresses are unix:<path> or <host>:<port>, not " + address);
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+    return false;
+}
+
+int listen_socket(const string &address) {
+    string host, port;
+    int fd = -1;
+
+    if(parse_address(address, host, port)) {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if(host.size() >= sizeof(addr.sun_path))
+            cmpt::error("Socket path too long: " + host);
+        strcpy(addr.sun_path, host.c_str());
+
+        unlink(host.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0 || ::bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+            cmpt::error("Cannot listen on " + address + ": " + strerror(errno));
+    } else {
+        addrinfo hints = {}, *found;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        if(getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0)
+            cmpt::error("Cannot resolve " + address);
+
+        fd = socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+        int on = 1;
+        if(fd >= 0)
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        bool bound = fd >= 0 && ::bind(fd, found->ai_addr, found->ai_addrlen) == 0;
+        freeaddrinfo(found);
+        if(!bound)
+            cmpt::error("Cannot listen on " + address + ": " + strerror(errno));
+    }
+
+    if(listen(fd, SOMAXCONN) < 0)
+        cmpt::error("Cannot listen on " + address + ": " + strerror(errno));
+    return fd;
+}
+
+int connect_socket(const string &address) {
+    string host, port;
+
+    if(parse_address(address, host, port)) {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if(host.size() >= sizeof(addr.sun_path))
+            return -1;
+        strcpy(addr.sun_path, host.c_str());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd >= 0 && connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0)
+            return fd;
+        if(fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    addrinfo hints = {}, *found;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0)
+        return -1;
+
+    int fd = -1;
+    for(addrinfo *a = found; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if(fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+Connection::Connection(int fd):
+_fd(fd)
+{}
+
+Connection::~Connection() {
+    if(_fd >= 0)
+        close(_fd);
+}
+
+int Connection::fd() const {
+    return _fd;
+}
+
+bool Connection::send_frame(const string &payload) {
+    string frame(4, '\0');
+    for(int i = 0; i < 4; i++)
+        frame[i] = char((payload.size() >> (24 - 8 * i)) & 0xff);
+    frame += payload;
+
+    //MSG_NOSIGNAL turns a peer that has gone away into an error instead of SIGPIPE
+    for(size_t sent = 0; sent < frame.size(); ) {
+        ssize_t n = send(_fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        sent += n;
+    }
+
+    return true;
+}
+
+bool Connection::receive() {
+    char buffer[4096];
+    ssize_t n = recv(_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if(n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    if(n == 0)
+        return false;
+
+    _input.append(buffer, n);
+    return true;
+}
+
+bool Connection::next_frame(string &payload) {
+    if(_input.size() < 4)
+        return false;
+
+    size_t length = 0;
+    for(int i = 0; i < 4; i++)
+        length = (length << 8) | (unsigned char)_input[i];
+    if(length > MAX_FRAME) {
+        //Nothing more can be read from this stream, so the connection is as good as closed
+        shutdown(_fd, SHUT_RDWR);
+        _input.clear();
+        return false;
+    }
+    if(_input.size() < 4 + length)
+        return false;
+
+    payload = _input.substr(4, length);
+    _input.erase(0, 4 + length);
+    return true;
+}
+
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef TRANSPOSITION_TABLE_H_INCLUDED
+#define TRANSPOSITION_TABLE_H_INCLUDED
+
+
+#include "Board.h"
+#include "Const_table.h"
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+//Describes how a cached value relates to the true value of a position.
+//A search that fails high only proves a lower bound, and one that fails
+//low only proves an upper bound.
+enum class Bound : char {
+    EXACT, LOWER, UPPER
+};
+
+struct Cache_entry {
+    uint64_t key = 0;
+    int value = 0;
+    signed char depth = -1;  //The remaining search depth the value is valid for
+    Bound bound = Bound::EXACT;
+    Position best;  //Best move found from this position, if any
+};
+
+//The first COUNT outputs of mt19937_64 with the given seed, following the standard's
+//definition of the engine, so tables built at compile time hold the same numbers as
+//std::mt19937_64 would give. COUNT must be at most the state size of 312.
+template<int COUNT>
+constexpr Const_table<uint64_t, COUNT> mt19937_64_outputs(uint64_t seed) {
+    const int STATE = 312;
+    const int SHIFT = 156;
+    const uint64_t LOWER = (uint64_t(1) << 31) - 1;
+    static_assert(COUNT <= STATE, "Only one twist of the state is done");
+
+    Const_table<uint64_t, STATE> state{};
+    state[0] = seed;
+    for(int i = 1; i < STATE; i++)
+        state[i] = 6364136223846793005ULL * (state[i - 1] ^ (state[i - 1] >> 62)) + i;
+
+    for(int i = 0; i < STATE; i++) {
+        uint64_t x = (state[i] & ~LOWER) | (state[(i + 1) % STATE] & LOWER);
+        uint64_t twisted = (x >> 1) ^ (x & 1 ? 0xb5026f5aa96619e9ULL : 0);
+        state[i] = state[(i + SHIFT) % STATE] ^ twisted;
+    }
+
+    Const_table<uint64_t, COUNT> out{};
+    for(int i = 0; i < COUNT; i++) {
+        uint64_t y = state[i];
+        y ^= (y >> 29) & 0x5555555555555555ULL;
+        y ^= (y << 17) & 0x71d67fffeda60000ULL;
+        y ^= (y << 37) & 0xfff7eee000000000ULL;
+        out[i] = y ^ (y >> 43);
+    }
+
+    return out;
+}
+
+//A fixed size hash table of previously searched positions. Positions are
+//identified by a Zobrist hash of the board and the player to move, so the
+//same position reached through different move orders is only searched once.
+class Transposition_table {
+private:
+    vector<Cache_entry> _entries;
+    uint64_t _mask;
+
+    const static int MAX_SQUARES = 10 * 10;
+    const static int KEY_COUNT = MAX_SQUARES * 2 + 1;
+    //Random keys for each (square, piece) pair on the largest board, followed by one key for
+    //the second player being the one to move. A fixed seed keeps hashes (and therefore search
+    //results) reproducible between runs.
+    constexpr static Const_table<uint64_t, KEY_COUNT> ZOBRIST_KEYS = mt19937_64_outputs<KEY_COUNT>(0x5eed0f0e110ULL);
+
+public:
+    //The table holds 2^size_bits entries
+    Transposition_table(int size_bits = 18);
+
+    template<int N = 8>
+    static uint64_t hash(const Board_vec &board, Piece piece);
+
+    //Returns true and fills entry if the position with the given key is cached
+    bool probe(uint64_t key, Cache_entry &entry) const;
+    void store(uint64_t key, int depth, int value, Bound bound, Position best);
+
+    void clear();
+};
+
+constexpr Const_table<uint64_t, Transposition_table::KEY_COUNT> Transposition_table::ZOBRIST_KEYS;
+
+Transposition_table::Transposition_table(int size_bits):
+    _entries(size_t(1) << size_bits),
+    _mask((uint64_t(1) << size_bits) - 1)
+{}
+
+template<int N>
+uint64_t Transposition_table::hash(const Board_vec &board, Piece piece) {
+    const Const_table<uint64_t, KEY_COUNT> &keys = ZOBRIST_KEYS;
+
+    uint64_t out = 0;
+    for(int row = 0; row < N; row++) {
+        for(int col = 0; col < N; col++) {
+            if(board[row][col] == Piece::P1)
+                out ^= keys[(row * N + col) * 2];
+            else if(board[row][col] == Piece::P2)
+                out ^= keys[(row * N + col) * 2 + 1];
+        }
+    }
+
+    if(piece == Piece::P2)
+        out ^= keys[KEY_COUNT - 1];
+
+    return out;
+}
+
+bool Transposition_table::probe(uint64_t key, Cache_entry &entry) const {
+    const Cache_entry &slot = _entries[key & _mask];
+    if(slot.depth < 0 || slot.key != key)
+        return false;
+
+    entry = slot;
+    return true;
+}
+
+void Transposition_table::store(uint64_t key, int depth, int value, Bound bound, Position best) {
+    Cache_entry &slot = _entries[key & _mask];
+
+    //Results for the same position are only replaced by results from a search
+    //that is at least as deep, other positions always replace the old entry
+    if(slot.key == key && slot.depth > depth)
+        return;
+
+    slot.key = key;
+    slot.value = value;
+    slot.depth = depth;
+    slot.bound = bound;
+    slot.best = best;
+}
+
+void Transposition_table::clear() {
+    for(Cache_entry &entry: _entries)
+        entry = Cache_entry();
+}
+
+
+#endif
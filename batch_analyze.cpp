@@ -0,0 +1,468 @@
+//Batch analysis of positions
+//
+//Reads positions one at a time from a file (or standard input) and writes the computer's move
+//and value for each. Positions are handed to a pool of worker threads, each with its own
+//computer player, through a queue of fixed size: once it is full the reader waits, so the
+//memory used does not grow with the input however large it is. Results are written in input
+//order, holding back at most one queue's worth that finished early, or as they finish.
+//
+//Text input has one position per line, blank lines and lines starting with # are skipped:
+//  <64 squares of X, O and -> <X or O to move> [depth=<moves>] [time=<ms>] [nodes=<count>]
+//The optional fields override the defaults below for that position alone.
+//
+//Binary input is the 4 bytes "RVB1" followed by 32 byte records, all little endian:
+//  X discs (8 bytes, bit row * 8 + col), O discs (8), node limit (8), time limit in ms (4),
+//  depth (1), player to move (1, 1 for X and 2 for O), 2 bytes of zero
+//A limit of 0 uses the default. "batch_analyze pack" converts text input to binary.
+//
+//Each result is a line:
+//  <position number> <move> <value> <depth> <nodes> <milliseconds>
+//numbered from 0 in input order. The move is PA when the player must pass and -- when the
+//game is over. Values of positions searched to the end are final disc margins and the depth
+//is "end" ("wld" when only a win, loss or draw was proven), otherwise they are evaluations.
+//A position that cannot be read gets "<position number> error <reason>" instead. Workers keep
+//their caches from one position to the next, so a value can differ slightly with the number
+//of threads, as a deeper result cached for an earlier position may be found.
+//
+//Usage: batch_analyze [input] [threads] [ordered|unordered] [depth] [time ms] [nodes]
+//       batch_analyze pack [input]
+//The input is standard input if missing or "-". 0 threads uses every core.
+
+#include "Board.h"
+#include "Computer_player.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+const static char MAGIC[4] = {'R', 'V', 'B', '1'};
+const static int RECORD_SIZE = 32;
+
+const static int DEFAULT_DEPTH = 8;
+const static int END_GAME_DEPTH = 14;  //Used when there is no time limit to budget solves by
+const static int CACHE_BITS = 18;  //For each worker
+
+struct Limits {
+    int depth = 0;
+    int milliseconds = 0;
+    long long nodes = 0;
+};
+
+struct Job {
+    long long id;
+    Board_state board;
+    Piece piece;
+    Limits limits;
+    string error;  //Set if the position could not be read
+};
+
+//Reads either format, one position at a time
+class Position_reader {
+private:
+    istream &_in;
+    bool _binary = false;
+    long long _next_id = 0;
+
+    bool read_text(Job &job);
+    bool read_binary(Job &job);
+
+public:
+    explicit Position_reader(istream &in);
+
+    bool binary() const { return _binary; }
+    //Returns false at the end of the input
+    bool next(Job &job);
+};
+
+//The queue between the reader and the workers, and the window of results waiting to be written
+//in order. push() blocks while the queue is full, or while the results that would have to be
+//held back are already a queue's worth.
+class Pipeline {
+private:
+    mutex _lock;
+    condition_variable _space;
+    condition_variable _work;
+
+    deque<Job> _jobs;
+    size_t _capacity;
+    bool _closed = false;
+
+    bool _ordered;
+    long long _next_write = 0;
+    size_t _window;
+    vector<string> _waiting;  //Finished results by id % _window
+    vector<bool> _ready;
+
+    void write(const string &line);
+
+public:
+    Pipeline(size_t capacity, size_t workers, bool ordered);
+
+    void push(Job job);
+    //Returns false once the queue is closed and empty
+    bool pop(Job &job);
+    void finish(long long id, const string &line);
+    //No more jobs will be pushed
+    void close();
+};
+
+Position_reader::Position_reader(istream &in):
+    _in(in)
+{
+    if(_in.peek() == MAGIC[0]) {
+        char magic[4];
+        if(!_in.read(magic, 4) || memcmp(magic, MAGIC, 4) != 0)
+            cmpt::error("Unknown input format");
+        _binary = true;
+    }
+}
+
+bool Position_reader::next(Job &job) {
+    job = Job();
+    job.id = _next_id;
+    bool read = _binary ? read_binary(job) : read_text(job);
+    if(read)
+        _next_id++;
+    return read;
+}
+
+bool Position_reader::read_text(Job &job) {
+    string line;
+    do {
+        if(!getline(_in, line))
+            return false;
+    } while(line.find_first_not_of(" \t\r") == string::npos || line[line.find_first_not_of(" \t")] == '#');
+
+    istringstream fields(line);
+    string squares, side, option;
+    fields >> squares >> side;
+
+    if(squares.size() != 64) {
+        job.error = "expected 64 squares";
+        return true;
+    }
+
+    Board_state &board = job.board;
+    board.p1 = board.p2 = 0;
+    for(int i = 0; i < 64; i++) {
+        char c = toupper(squares[i]);
+        if(c == 'X' || c == '*' || c == 'B')
+            board.p1 |= Bitboard(1) << i;
+        else if(c == 'O' || c == 'W')
+            board.p2 |= Bitboard(1) << i;
+        else if(c != '-' && c != '.') {
+            job.error = "unknown square " + string(1, squares[i]);
+            return true;
+        }
+    }
+
+    char mover = side.size() == 1 ? toupper(side[0]) : '?';
+    if(mover == 'X' || mover == '*' || mover == 'B')
+        job.piece = Piece::P1;
+    else if(mover == 'O' || mover == 'W')
+        job.piece = Piece::P2;
+    else {
+        job.error = "expected X or O to move";
+        return true;
+    }
+
+    while(fields >> option) {
+        size_t equals = option.find('=');
+        string name = option.substr(0, equals);
+        string value = equals == string::npos ? "" : option.substr(equals + 1);
+        try {
+            if(name == "depth")
+                job.limits.depth = stoi(value);
+            else if(name == "time")
+                job.limits.milliseconds = stoi(value);
+            else if(name == "nodes")
+                job.limits.nodes = stoll(value);
+            else
+                job.error = "unknown option " + name;
+        } catch(const exception &) {
+            job.error = "bad value for " + name;
+        }
+    }
+
+    if(job.limits.depth < 0 || job.limits.depth > 60 || job.limits.milliseconds < 0 || job.limits.nodes < 0)
+        job.error = "limit out of range";
+    return true;
+}
+
+bool Position_reader::read_binary(Job &job) {
+    unsigned char record[RECORD_SIZE];
+    if(!_in.read(reinterpret_cast<char *>(record), RECORD_SIZE))
+        return false;
+
+    auto little_endian = [&](int offset, int bytes) {
+        uint64_t out = 0;
+        for(int i = bytes - 1; i >= 0; i--)
+            out = out << 8 | record[offset + i];
+        return out;
+    };
+
+    job.board.p1 = little_endian(0, 8);
+    job.board.p2 = little_endian(8, 8);
+    job.limits.nodes = min(little_endian(16, 8), uint64_t(LLONG_MAX));
+    job.limits.milliseconds = min(little_endian(24, 4), uint64_t(INT_MAX));
+    job.limits.depth = record[28];
+    job.piece = record[29] == 2 ? Piece::P2 : Piece::P1;
+
+    if(job.board.p1 & job.board.p2)
+        job.error = "a square holds both colours";
+    else if(record[29] != 1 && record[29] != 2)
+        job.error = "expected 1 or 2 to move";
+    else if(job.limits.depth > 60)
+        job.error = "limit out of range";
+    return true;
+}
+
+Pipeline::Pipeline(size_t capacity, size_t workers, bool ordered):
+    _capacity(capacity),
+    _ordered(ordered),
+    _window(capacity + workers),
+    _waiting(ordered ? _window : 0),
+    _ready(ordered ? _window : 0, false)
+{}
+
+void Pipeline::push(Job job) {
+    unique_lock<mutex> lock(_lock);
+    //Every job from _next_write up is queued, running or waiting to be written, so keeping
+    //them within the window bounds the results held back
+    _space.wait(lock, [&] {
+        return _jobs.size() < _capacity && (!_ordered || job.id < _next_write + (long long)(_window));
+    });
+
+    _jobs.push_back(job);
+    _work.notify_one();
+}
+
+bool Pipeline::pop(Job &job) {
+    unique_lock<mutex> lock(_lock);
+    if(_jobs.empty() && !_closed)
+        cout.flush();  //Nothing more to do for now, so what is written so far is sent
+    _work.wait(lock, [&] { return !_jobs.empty() || _closed; });
+
+    if(_jobs.empty())
+        return false;
+
+    job = _jobs.front();
+    _jobs.pop_front();
+    _space.notify_one();
+    return true;
+}
+
+void Pipeline::finish(long long id, const string &line) {
+    lock_guard<mutex> lock(_lock);
+    if(!_ordered) {
+        write(line);
+        return;
+    }
+
+    _waiting[id % _window] = line;
+    _ready[id % _window] = true;
+
+    bool wrote = false;
+    while(_ready[_next_write % _window]) {
+        size_t slot = _next_write % _window;
+        write(_waiting[slot]);
+        _waiting[slot].clear();
+        _ready[slot] = false;
+        _next_write++;
+        wrote = true;
+    }
+
+    if(wrote)
+        _space.notify_all();
+}
+
+void Pipeline::close() {
+    lock_guard<mutex> lock(_lock);
+    _closed = true;
+    _work.notify_all();
+}
+
+void Pipeline::write(const string &line) {
+    cout << line << '\n';
+}
+
+//Disc margins for positions searched to the end, evaluations otherwise, with a sign
+string value_text(int value) {
+    if(value >= INT_MAX / 4)
+        value -= INT_MAX / 2;
+    else if(value <= INT_MIN / 4)
+        value += INT_MAX / 2;
+
+    return (value >= 0 ? "+" : "") + to_string(value);
+}
+
+string analyze(const Job &job, const Limits &defaults, Board &board, Computer_player &player) {
+    string id = to_string(job.id);
+    if(!job.error.empty())
+        return id + " error " + job.error;
+
+    int depth = job.limits.depth > 0 ? job.limits.depth : defaults.depth;
+    int milliseconds = job.limits.milliseconds > 0 ? job.limits.milliseconds : defaults.milliseconds;
+    long long nodes = job.limits.nodes > 0 ? job.limits.nodes : defaults.nodes;
+
+    board.set_state(job.board);
+    Piece piece = job.piece;
+    if(board.game_over()) {
+        int margin = board.count_pieces(piece) - board.count_pieces(get_opponent(piece));
+        return id + " -- " + value_text(margin) + " end 0 0";
+    }
+
+    //A player without a move passes, and the position is searched for the opponent
+    bool pass = !board.can_move(piece);
+    if(pass)
+        piece = get_opponent(piece);
+
+    player.set_piece(piece);
+    player.set_depth(depth);
+    player.set_time_limit(milliseconds);
+    player.set_solve_budget(milliseconds);
+    player.set_node_limit(nodes);
+
+    auto start = chrono::steady_clock::now();
+    string move = player.move();
+    long long elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+
+    Move_analysis chosen = player.last_move();
+    string depth_text = chosen.exact ? "end" : chosen.depth >= 64 ? "wld" : to_string(chosen.depth);
+    return id + " " + (pass ? "PA" : move) + " " + value_text(pass ? -chosen.value : chosen.value) + " " +
+        depth_text + " " + to_string(player.last_nodes()) + " " + to_string(elapsed);
+}
+
+void work(Pipeline &pipeline, const Limits &defaults) {
+    Board board;
+    Computer_player player(Piece::P1, &board, defaults.depth, END_GAME_DEPTH, false);
+    //The workers already keep every core busy
+    player.set_solver_threads(1);
+    player.set_cache_size(CACHE_BITS);
+
+    Job job;
+    while(pipeline.pop(job))
+        pipeline.finish(job.id, analyze(job, defaults, board, player));
+}
+
+//Writes text input as binary, for inputs read many times
+int pack(istream &in) {
+    Position_reader reader(in);
+    if(reader.binary()) {
+        cerr << "The input is already binary" << endl;
+        return 1;
+    }
+
+    cout.write(MAGIC, 4);
+    Job job;
+    while(reader.next(job)) {
+        if(!job.error.empty()) {
+            cerr << "Position " << job.id << ": " << job.error << endl;
+            return 1;
+        }
+
+        unsigned char record[RECORD_SIZE] = {};
+        auto put = [&](int offset, int bytes, uint64_t value) {
+            for(int i = 0; i < bytes; i++, value >>= 8)
+                record[offset + i] = value & 0xff;
+        };
+        put(0, 8, job.board.p1);
+        put(8, 8, job.board.p2);
+        put(16, 8, job.limits.nodes);
+        put(24, 4, job.limits.milliseconds);
+        put(28, 1, job.limits.depth);
+        put(29, 1, job.piece == Piece::P1 ? 1 : 2);
+        cout.write(reinterpret_cast<char *>(record), RECORD_SIZE);
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    ios::sync_with_stdio(false);
+
+    bool packing = argc > 1 && string(argv[1]) == "pack";
+    int first = packing ? 2 : 1;
+    string input = argc > first ? argv[first] : "-";
+
+    int threads = 0;
+    string order = argc > 3 ? argv[3] : "ordered";
+    Limits defaults;
+    defaults.depth = DEFAULT_DEPTH;
+    try {
+        if(!packing && argc > 2)
+            threads = stoi(argv[2]);
+        if(!packing && argc > 4)
+            defaults.depth = stoi(argv[4]);
+        if(!packing && argc > 5)
+            defaults.milliseconds = stoi(argv[5]);
+        if(!packing && argc > 6)
+            defaults.nodes = stoll(argv[6]);
+    } catch(const exception &) {
+        cerr << "Usage: batch_analyze [input] [threads] [ordered|unordered] [depth] [time ms] [nodes]" << endl;
+        cerr << "       batch_analyze pack [input]" << endl;
+        return 1;
+    }
+
+    ifstream file;
+    if(input != "-") {
+        file.open(input, ios::binary);
+        if(!file) {
+            cerr << "Cannot open " << input << endl;
+            return 1;
+        }
+    }
+    istream &in = input != "-" ? file : cin;
+
+    try {
+        if(packing)
+            return pack(in);
+
+        if(threads <= 0)
+            threads = max(1, int(thread::hardware_concurrency()));
+        if(order != "ordered" && order != "unordered") {
+            cerr << "The order must be ordered or unordered" << endl;
+            return 1;
+        }
+
+        if(defaults.depth < 1 || defaults.depth > 60) {
+            cerr << "The depth must be from 1 to 60" << endl;
+            return 1;
+        }
+
+        Position_reader reader(in);
+        Pipeline pipeline(2 * threads, threads, order == "ordered");
+
+        vector<thread> workers;
+        for(int i = 0; i < threads; i++)
+            workers.emplace_back(work, ref(pipeline), cref(defaults));
+
+        Job job;
+        while(reader.next(job))
+            pipeline.push(job);
+
+        pipeline.close();
+        for(thread &t: workers)
+            t.join();
+    } catch(const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    cout.flush();
+    return 0;
+}
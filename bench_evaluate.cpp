@@ -0,0 +1,104 @@
+//Benchmark for the batch evaluation in Computer_player.h
+//
+//Collects positions from random games, checks that evaluate_batch gives every one of
+//them the same value as the search's own evaluation, then times evaluating them one at
+//a time against evaluating them as a batch on one thread and on every core. With a network
+//file (see Network.h) the positions are valued by the network instead.
+//
+//Usage: bench_evaluate [positions] [repeats] [network file]
+
+#include "Board.h"
+#include "Random_positions.h"
+#include "Computer_player.h"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+//Adds every position of random games, including finished ones
+Position_batch random_positions(int count, mt19937_64 &generator) {
+    Position_batch out;
+
+    while(int(out.size()) < count) {
+        play_random_game(generator, [&](const Random_position &position, Bitboard) {
+            out.add(position.own, position.opp);
+            return int(out.size()) < count;
+        });
+    }
+
+    return out;
+}
+
+Board_vec to_board_vec(Bitboard own, Bitboard opp) {
+    Board_vec board(8, vector<Piece>(8, Piece::EMPTY));
+    for(int square = 0; square < 64; square++) {
+        Position pos = square_position(square);
+        if(own & (Bitboard(1) << square))
+            board[pos.row][pos.col] = Piece::P1;
+        else if(opp & (Bitboard(1) << square))
+            board[pos.row][pos.col] = Piece::P2;
+    }
+    return board;
+}
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    int positions = argc > 1 ? stoi(argv[1]) : 100000;
+    int repeats = argc > 2 ? stoi(argv[2]) : 20;
+
+    mt19937_64 generator(1);
+    Position_batch batch = random_positions(positions, generator);
+
+    Board board;
+    Computer_player engine(Piece::P1, &board, 1, 0, false);
+    Network network;
+    if(argc > 3) {
+        if(!network.load(argv[3])) {
+            cerr << "Cannot open " << argv[3] << endl;
+            return 1;
+        }
+        engine.set_network(&network);
+    }
+
+    vector<Board_vec> boards;
+    for(int i = 0; i < positions; i++)
+        boards.push_back(to_board_vec(batch.own[i], batch.opp[i]));
+
+    //A search with no moves ahead returns the evaluation of the position itself
+    vector<int> expected(positions), scores(positions);
+    auto start = chrono::steady_clock::now();
+    for(int i = 0; i < positions; i++)
+        expected[i] = engine.search_value(boards[i], Piece::P1, 0);
+    double single_seconds = seconds_since(start);
+
+    engine.evaluate_batch(batch, scores.data());
+    for(int i = 0; i < positions; i++) {
+        if(scores[i] != expected[i]) {
+            cout << "Position " << i << ": batch value " << scores[i] << ", expected " << expected[i] << endl;
+            return 1;
+        }
+    }
+
+    printf("%-20s %8.2f M positions/s\n", "one at a time", positions / single_seconds / 1e6);
+
+    unsigned int cores = max(1u, thread::hardware_concurrency());
+    for(unsigned int threads: {1u, cores}) {
+        start = chrono::steady_clock::now();
+        for(int r = 0; r < repeats; r++)
+            engine.evaluate_batch(batch, scores.data(), threads);
+        double seconds = seconds_since(start);
+
+        string label = "batch, " + to_string(threads) + " thread" + (threads > 1 ? "s" : "");
+        printf("%-20s %8.2f M positions/s\n", label.c_str(), double(positions) * repeats / seconds / 1e6);
+
+        if(cores == 1)
+            break;
+    }
+}
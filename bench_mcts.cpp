@@ -0,0 +1,74 @@
+//Benchmark for the tree parallel search in Mcts_player.h
+//
+//Runs the Monte Carlo player for a fixed time on positions from random games with 1, 2,
+//4... threads up to the given count, and prints the playouts per second of each and the
+//speedup over 1 thread. Every search starts from a new tree. Playouts are counted when
+//they finish, so the speedup shows how well the threads share the tree, and on a machine
+//with fewer cores than threads only the cost of sharing it.
+//
+//Usage: bench_mcts [max threads] [milliseconds per move] [positions]
+
+#include "Board.h"
+#include "Random_positions.h"
+#include "Mcts_player.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdio>
+
+using namespace std;
+
+struct Sample {
+    Board_vec board;
+    Piece piece;
+};
+
+//Takes positions from random games from a fixed seed, at empties spread from 56 down to 16
+vector<Sample> make_samples(int count) {
+    mt19937_64 generator(1);
+    vector<Sample> out;
+
+    while(int(out.size()) < count) {
+        int empties = 56 - int(out.size()) * 40 / max(1, count - 1);
+        Random_position position = random_position(generator, empties);
+        out.push_back({position.board_vec(), position.piece});
+    }
+
+    return out;
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = argc > 1 ? stoi(argv[1]) : int(thread::hardware_concurrency());
+    int milliseconds = argc > 2 ? stoi(argv[2]) : 1000;
+    int positions = argc > 3 ? stoi(argv[3]) : 4;
+    if(max_threads < 1 || milliseconds < 1 || positions < 1) {
+        cerr << "Usage: bench_mcts [max threads] [milliseconds per move] [positions]" << endl;
+        return 1;
+    }
+
+    vector<Sample> samples = make_samples(positions);
+    double serial_rate = 0;
+
+    for(int threads = 1; threads <= max_threads; threads *= 2) {
+        long long playouts = 0;
+        double seconds = 0;
+
+        for(const Sample &sample: samples) {
+            Board board;
+            board.set_board_vec(sample.board);
+            Mcts_player player(sample.piece, &board, milliseconds, threads, false, "Bench");
+            player.move();
+
+            playouts += player.last_playouts();
+            seconds += player.last_playouts() / player.playouts_per_second();
+        }
+
+        double rate = playouts / seconds;
+        if(threads == 1)
+            serial_rate = rate;
+        printf("%2d threads: %10lld playouts  %9.0f playouts/s  speedup %5.2f\n", threads, playouts, rate, rate / serial_rate);
+        fflush(stdout);
+    }
+}
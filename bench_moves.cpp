@@ -0,0 +1,99 @@
+//Benchmark for the 8x8 move generation kernels in Bitboard.h
+//
+//Collects positions from random games, checks that every available kernel agrees with
+//the scalar version on all of them, then times legal move generation and flipping with
+//each kernel. The kernel the game actually uses is chosen at startup and shown first.
+//
+//Usage: bench_moves [positions] [repeats]
+
+#include "Bitboard.h"
+#include "Random_positions.h"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+struct Sample {
+    Bitboard own;
+    Bitboard opp;
+    int square;  //A legal move in the position
+};
+
+//Takes every position of random games with a move to play, and the move played
+vector<Sample> random_samples(int count, mt19937_64 &generator) {
+    vector<Sample> out;
+
+    while(int(out.size()) < count) {
+        play_random_game(generator, [&](const Random_position &, Bitboard) {
+            return int(out.size()) < count;
+        }, [&](mt19937_64 &g, const Random_position &position, Bitboard moves) {
+            int square = random_square(g, moves);
+            out.push_back({position.own, position.opp, square});
+            return square;
+        });
+    }
+
+    return out;
+}
+
+bool check(const Move_kernels &kernels, const vector<Sample> &samples) {
+    for(const Sample &s: samples) {
+        if(kernels.legal_moves(s.own, s.opp) != legal_moves_scalar(s.own, s.opp))
+            return false;
+        for(int square = 0; square < 64; square++)
+            if(kernels.flipped_discs(s.own, s.opp, square) != flipped_discs_scalar(s.own, s.opp, square))
+                return false;
+    }
+
+    return true;
+}
+
+void bench(const Move_kernels &kernels, const vector<Sample> &samples, int repeats) {
+    //The results are summed and printed so the compiler cannot skip the work
+    Bitboard sink = 0;
+
+    auto start = chrono::steady_clock::now();
+    for(int r = 0; r < repeats; r++)
+        for(const Sample &s: samples)
+            sink += kernels.legal_moves(s.own, s.opp);
+    double legal_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for(int r = 0; r < repeats; r++)
+        for(const Sample &s: samples)
+            sink += kernels.flipped_discs(s.own, s.opp, s.square);
+    double flip_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double calls = double(samples.size()) * repeats;
+    printf("%-8s legal moves: %7.1f M/s   flips: %7.1f M/s   (%016llx)\n", kernels.name,
+        calls / legal_seconds / 1e6, calls / flip_seconds / 1e6, (unsigned long long)sink);
+}
+
+int main(int argc, char *argv[]) {
+    int positions = argc > 1 ? stoi(argv[1]) : 100000;
+    int repeats = argc > 2 ? stoi(argv[2]) : 20;
+
+    mt19937_64 generator(1);
+    vector<Sample> samples = random_samples(positions, generator);
+
+    vector<Move_kernels> kernels = {MOVE_KERNELS, SCALAR_KERNELS};
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2"))
+        kernels.push_back(AVX2_KERNELS);
+#endif
+
+    cout << "Selected kernel: " << MOVE_KERNELS.name << endl;
+    for(const Move_kernels &k: kernels) {
+        if(!check(k, samples)) {
+            cout << k.name << " does not match the scalar kernel" << endl;
+            return 1;
+        }
+    }
+
+    for(unsigned int i = 1; i < kernels.size(); i++)
+        bench(kernels[i], samples, repeats);
+}
@@ -0,0 +1,116 @@
+//Benchmark for the search in Computer_player.h
+//
+//Plays the computer's move in a fixed set of positions, from the opening to the end game,
+//with a node limit and in deterministic mode, so every run searches exactly the same tree.
+//Each run prints its speed and a signature of every move, value and node count. The runs
+//must all have the same signature, and a build that changes the signature has changed what
+//the search does, while one that only changes the speed has not. A new player is made for
+//each position, so no cache is carried from one to the next.
+//
+//Usage: bench_search [nodes per position] [solver threads] [positions] [runs]
+//0 solver threads uses every core.
+
+#include "Board.h"
+#include "Random_positions.h"
+#include "Computer_player.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+using namespace std;
+
+const static int DEPTH = 12;
+//Deep enough that the last positions are solved, on the solver's threads
+const static int END_GAME_DEPTH = 20;
+
+struct Sample {
+    Board_vec board;
+    Piece piece;
+    int empties;
+};
+
+struct Result {
+    Position move;
+    int value;
+    long long nodes;
+};
+
+//Takes positions from random games from a fixed seed, at empties spread from 50 down to 14
+vector<Sample> make_samples(int count) {
+    mt19937_64 generator(1);
+    vector<Sample> out;
+
+    while(int(out.size()) < count) {
+        int empties = 50 - int(out.size()) * 36 / max(1, count - 1);
+        Random_position position = random_position(generator, empties);
+        out.push_back({position.board_vec(), position.piece, empties});
+    }
+
+    return out;
+}
+
+Result run_sample(const Sample &sample, long long nodes, int threads) {
+    Board board;
+    board.set_board_vec(sample.board);
+
+    Computer_player player(sample.piece, &board, DEPTH, END_GAME_DEPTH, false, "Bench");
+    player.set_deterministic(true);
+    player.set_node_limit(nodes);
+    player.set_solver_threads(threads);
+    player.move();
+
+    Move_analysis chosen = player.last_move();
+    return {chosen.pos, chosen.value, player.last_nodes()};
+}
+
+int main(int argc, char *argv[]) {
+    long long nodes = argc > 1 ? stoll(argv[1]) : 1000000;
+    int threads = argc > 2 ? stoi(argv[2]) : 0;
+    int positions = argc > 3 ? stoi(argv[3]) : 16;
+    int runs = argc > 4 ? stoi(argv[4]) : 2;
+    if(nodes < 1 || threads < 0 || positions < 1 || runs < 1) {
+        cerr << "Usage: bench_search [nodes per position] [solver threads] [positions] [runs]" << endl;
+        return 1;
+    }
+
+    vector<Sample> samples = make_samples(positions);
+    uint64_t first_signature = 0;
+
+    for(int run = 1; run <= runs; run++) {
+        uint64_t signature = 14695981039346656037ULL;
+        long long total_nodes = 0;
+        double seconds = 0;
+
+        if(run == 1)
+            printf(" #  Empties  Move  %-16s  Nodes\n", "Value");
+        for(unsigned int i = 0; i < samples.size(); i++) {
+            auto start = chrono::steady_clock::now();
+            Result result = run_sample(samples[i], nodes, threads);
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            total_nodes += result.nodes;
+
+            for(long long part: {(long long)(result.move.row * 8 + result.move.col), (long long)result.value, result.nodes})
+                signature = (signature ^ uint64_t(part)) * 1099511628211ULL;
+
+            if(run == 1)
+                printf("%2u  %7d  %-4s  %-16s  %lld\n", i + 1, samples[i].empties, to_string(result.move).c_str(),
+                    value_string(result.value).c_str(), result.nodes);
+        }
+
+        printf("Run %d: %lld nodes in %.3f s, %.2f M nodes/s, signature %016llx\n", run, total_nodes, seconds,
+            total_nodes / seconds / 1e6, (unsigned long long)signature);
+        fflush(stdout);
+
+        if(run == 1) {
+            first_signature = signature;
+        } else if(signature != first_signature) {
+            cout << "Run " << run << " searched differently from run 1" << endl;
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,172 @@
+//Benchmark for the parallel end game solver in Endgame_solver.h
+//
+//Solves a set of positions exactly with 1, 2, 4... threads up to the given count, checks
+//that every thread count finds the same margins, and prints the time and speedup of each.
+//Positions are read from a file with one per line: 64 squares of X, O and - (or .) and
+//then the player to move, as in the FFO test suite. Without a file, positions with the
+//given number of empty squares are taken from random games.
+//
+//With placements (see Numa.h) the whole curve is run once for each, printing the pages the
+//table actually got, the speedup over 1 thread of the same placement and the time against
+//the first placement at the same thread count. "all" runs a preset of placements. A large
+//table shows the effect of the pages best.
+//
+//Usage: bench_solve [max threads] [positions file | empties] [positions] [hash bits] [placement... | all]
+
+#include "Endgame_solver.h"
+#include "Random_positions.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+
+using namespace std;
+
+struct Sample {
+    Bitboard own;  //Discs of the player to move
+    Bitboard opp;
+};
+
+//Reads positions in the FFO format, skipping lines that are not positions
+vector<Sample> read_samples(const string &file_name) {
+    vector<Sample> out;
+    ifstream file(file_name);
+    string line;
+
+    while(getline(file, line)) {
+        Bitboard x = 0, o = 0;
+        int square = 0;
+        size_t i = 0;
+        for(; i < line.size() && square < 64; i++) {
+            char c = toupper(line[i]);
+            if(c == 'X' || c == '*')
+                x |= Bitboard(1) << square++;
+            else if(c == 'O')
+                o |= Bitboard(1) << square++;
+            else if(c == '-' || c == '.')
+                square++;
+        }
+
+        size_t side = line.find_first_not_of(" \t", i);
+        if(square < 64 || side == string::npos)
+            continue;
+
+        char mover = toupper(line[side]);
+        if(mover == 'X' || mover == '*')
+            out.push_back({x, o});
+        else if(mover == 'O')
+            out.push_back({o, x});
+    }
+
+    return out;
+}
+
+//Takes count positions with the given number of empty squares from random games
+vector<Sample> random_samples(int empties, int count, mt19937_64 &generator) {
+    vector<Sample> out;
+
+    while(int(out.size()) < count) {
+        Random_position position = random_position(generator, empties);
+        out.push_back({position.own, position.opp});
+    }
+
+    return out;
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = argc > 1 ? stoi(argv[1]) : int(thread::hardware_concurrency());
+    string source = argc > 2 ? argv[2] : "20";
+    int positions = argc > 3 ? stoi(argv[3]) : 10;
+
+    vector<Sample> samples;
+    if(!source.empty() && all_of(source.begin(), source.end(), [](char c) {return isdigit(c);})) {
+        mt19937_64 generator(1);
+        samples = random_samples(stoi(source), positions, generator);
+    } else {
+        samples = read_samples(source);
+    }
+
+    if(samples.empty()) {
+        cout << "No positions to solve" << endl;
+        return 1;
+    }
+
+    int hash_bits = argc > 4 ? stoi(argv[4]) : 20;
+    vector<Placement> placements;
+    for(int i = 5; i < argc; i++) {
+        if(string(argv[i]) == "all") {
+            for(const char *preset: {"none,small", "spread,small", "spread,transparent", "spread,huge,interleave"}) {
+                placements.emplace_back();
+                parse_placement(preset, placements.back());
+            }
+        } else {
+            placements.emplace_back();
+            if(!parse_placement(argv[i], placements.back())) {
+                cerr << "Cannot read the placement " << argv[i] << endl;
+                return 1;
+            }
+        }
+    }
+    if(placements.empty())
+        placements.emplace_back();
+    if(hash_bits < 1 || hash_bits > 32) {
+        cerr << "Usage: bench_solve [max threads] [positions file | empties] [positions] [hash bits] [placement... | all]" << endl;
+        return 1;
+    }
+
+    cout << Numa_topology::get().nodes() << " NUMA nodes, " << Numa_topology::get().cpu_count() << " CPUs" << endl;
+
+    atomic<bool> stop{false};
+    vector<int> margins;
+    vector<double> first_seconds;  //Of the first placement, by thread count
+
+    for(unsigned int p = 0; p < placements.size(); p++) {
+        double serial_seconds = 0;
+        int step = 0;
+
+        for(int threads = 1; threads <= max(1, max_threads); threads *= 2, step++) {
+            Endgame_solver solver(threads, hash_bits);
+            solver.set_placement(placements[p]);
+
+            //The table is allocated and its pages touched by the first solve, so a finished
+            //game is solved first to keep that out of the time
+            int best;
+            solver.solve(~Bitboard(0), 0, -65, 65, best, stop, chrono::steady_clock::time_point::max());
+            if(threads == 1)
+                printf("Placement %s, table on %s pages\n", to_string(placements[p]).c_str(), to_string(solver.table_pages()).c_str());
+
+            long long nodes = 0;
+            double seconds = 0;
+
+            for(unsigned int i = 0; i < samples.size(); i++) {
+                //Each position starts from an empty table, as it would in a real game
+                solver.clear();
+                auto start = chrono::steady_clock::now();
+                int margin = solver.solve(samples[i].own, samples[i].opp, -65, 65, best, stop, chrono::steady_clock::time_point::max());
+                seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                nodes += solver.last_nodes();
+
+                if(margins.size() < samples.size()) {
+                    margins.push_back(margin);
+                } else if(margin != margins[i]) {
+                    cout << "Position " << i + 1 << " solved as " << margin << " with " << threads
+                        << " threads and " << to_string(placements[p]) << " but " << margins[i] << " before" << endl;
+                    return 1;
+                }
+            }
+
+            if(threads == 1)
+                serial_seconds = seconds;
+            if(p == 0)
+                first_seconds.push_back(seconds);
+            printf("%2d threads: %8.3f s  %7.2f M nodes/s  speedup %5.2f  vs first %5.2f\n", threads, seconds,
+                nodes / seconds / 1e6, serial_seconds / seconds, first_seconds[step] / seconds);
+            fflush(stdout);
+        }
+    }
+}
@@ -0,0 +1,94 @@
+//Checks that every board size can be played, by the players as well as the board
+//
+//The board, the game and both computer players are templates on the side length, but the
+//programs only ever use the 8x8 board, so code that only works on it can break the other
+//sizes without anything else noticing. For the 6x6, 8x8 and 10x10 boards this plays games
+//of the search player against the Monte Carlo player with the game's step API, each player
+//taking each side, with an end game depth that makes the search player solve the last
+//moves. Partway through, every legal move is analysed to the end. Every move a player
+//makes must be legal, and the games must end with a full or blocked board.
+//
+//Usage: check_sizes [search depth] [milliseconds per Monte Carlo move]
+
+#include "Board.h"
+#include "Game.h"
+#include "Computer_player.h"
+#include "Mcts_player.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <exception>
+#include <cstdio>
+
+using namespace std;
+
+//The search player solves from this many empty squares
+const static int END_GAME_DEPTH = 8;
+
+//Plays one game, the search player taking the side search_piece. Returns false if a move
+//is not legal or the analysis finds nothing.
+template<int N>
+bool play_game(Piece search_piece, int depth, int mcts_ms) {
+    typedef Basic_board<N> Board;
+
+    Board board;
+    Basic_computer_player<N> search(search_piece, &board, depth, END_GAME_DEPTH, false, "Search");
+    Basic_mcts_player<N> mcts(get_opponent(search_piece), &board, mcts_ms, 2, false, "Monte Carlo");
+    Player *first = search_piece == Piece::P1 ? (Player *)&search : (Player *)&mcts;
+    Player *second = search_piece == Piece::P1 ? (Player *)&mcts : (Player *)&search;
+    Basic_game<N> game(nullptr, &board, first, second);
+
+    bool analysed = false;
+    game.start();
+    while(!game.over()) {
+        Piece active = game.active_player();
+
+        //The analysis searches to the end on every board size once the end game depth is reached
+        if(!analysed && active == search_piece && board.count_pieces(Piece::EMPTY) <= END_GAME_DEPTH) {
+            vector<Move_analysis> results = search.analyze(active);
+            if(results.empty() || !results.front().exact) {
+                printf("%dx%d: the analysis with %d empty squares is not exact\n", N, N, board.count_pieces(Piece::EMPTY));
+                return false;
+            }
+            analysed = true;
+        }
+
+        string command = active == search_piece ? search.move() : mcts.move();
+        if(game.submit(command) != Step::PLAYED) {
+            printf("%dx%d: %s played %s, which is not a legal move\n", N, N,
+                active == search_piece ? "the search player" : "the Monte Carlo player", command.c_str());
+            return false;
+        }
+    }
+
+    int empties = board.count_pieces(Piece::EMPTY);
+    printf("%dx%d: search player as %s, %d to %d with %d empty squares left%s\n", N, N,
+        search_piece == Piece::P1 ? "P1" : "P2", board.count_pieces(Piece::P1), board.count_pieces(Piece::P2),
+        empties, analysed ? ", analysed the end" : "");
+    fflush(stdout);
+    return true;
+}
+
+template<int N>
+bool check_size(int depth, int mcts_ms) {
+    return play_game<N>(Piece::P1, depth, mcts_ms) && play_game<N>(Piece::P2, depth, mcts_ms);
+}
+
+int main(int argc, char *argv[]) {
+    int depth, mcts_ms;
+    try {
+        depth = argc > 1 ? stoi(argv[1]) : 3;
+        mcts_ms = argc > 2 ? stoi(argv[2]) : 20;
+    } catch(const exception &) {
+        depth = mcts_ms = 0;
+    }
+    if(depth < 1 || mcts_ms < 1) {
+        cerr << "Usage: check_sizes [search depth] [milliseconds per Monte Carlo move]" << endl;
+        return 1;
+    }
+
+    bool ok = check_size<6>(depth, mcts_ms) && check_size<8>(depth, mcts_ms) && check_size<10>(depth, mcts_ms);
+    cout << (ok ? "Every board size played" : "A board size failed") << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+//Checks the lookup tables built at compile time against runtime builders
+//
+//The edge stability table, the base 3 values of edge lines and the line masks in
+//Bitboard.h, and the Zobrist keys in Transposition_table.h, are made by constexpr functions
+//(see Const_table.h). Each is built again here the plain way, as the programs once did at
+//startup, and compared entry by entry. The Zobrist keys are compared with std::mt19937_64
+//itself, read back through Transposition_table::hash. The time the runtime builders take is
+//what the compile time tables save every program on startup.
+//
+//Usage: check_tables
+
+#include "Bitboard.h"
+#include "Transposition_table.h"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+using namespace std;
+
+//Edge stability by the same search, with memoisation in vectors
+int reference_edge_stable(int own, int opp, vector<int> &table) {
+    int index = 0;
+    for(int i = 7; i >= 0; i--)
+        index = index * 3 + ((own >> i) & 1) + 2 * ((opp >> i) & 1);
+    if(table[index] >= 0)
+        return table[index];
+
+    int stable = own;
+    int empty = ~(own | opp) & 0xff;
+    for(int x = 0; x < 8 && stable; x++) {
+        if(!((empty >> x) & 1))
+            continue;
+
+        for(int mover = 0; mover < 2; mover++) {
+            int next_own = own;
+            int next_opp = opp;
+            if(mover == 0)
+                play_edge(next_own, next_opp, x);
+            else
+                play_edge(next_opp, next_own, x);
+            stable &= reference_edge_stable(next_own, next_opp, table);
+        }
+    }
+
+    table[index] = stable;
+    return stable;
+}
+
+vector<int> reference_edge_stability() {
+    vector<int> table(6561, -1);
+    for(int own = 0; own < 256; own++)
+        for(int opp = 0; opp < 256; opp++)
+            if(!(own & opp))
+                reference_edge_stable(own, opp, table);
+
+    return table;
+}
+
+//Every line mask, rows then columns then both kinds of diagonal
+vector<Bitboard> reference_line_masks() {
+    vector<Bitboard> out(8 + 8 + 15 + 15, 0);
+    for(int row = 0; row < 8; row++) {
+        for(int col = 0; col < 8; col++) {
+            Bitboard bit = Bitboard(1) << (row * 8 + col);
+            out[row] |= bit;
+            out[8 + col] |= bit;
+            out[16 + row - col + 7] |= bit;
+            out[31 + row + col] |= bit;
+        }
+    }
+
+    return out;
+}
+
+int main() {
+    int failures = 0;
+    auto fail = [&](const string &what) {
+        if(++failures <= 20)
+            cout << what << endl;
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<int> stability = reference_edge_stability();
+    vector<Bitboard> masks = reference_line_masks();
+    mt19937_64 generator(0x5eed0f0e110ULL);
+    vector<uint64_t> keys(10 * 10 * 2 + 1);
+    for(uint64_t &key: keys)
+        key = generator();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int checked = 0;
+    for(int own = 0; own < 256; own++) {
+        for(int opp = 0; opp < 256; opp++) {
+            if(own & opp)
+                continue;
+
+            int index = 0;
+            for(int i = 7; i >= 0; i--)
+                index = index * 3 + ((own >> i) & 1) + 2 * ((opp >> i) & 1);
+            if(edge_index(own, opp) != index)
+                fail("Edge index of " + to_string(own) + ", " + to_string(opp) + " is " + to_string(edge_index(own, opp)) + ", not " + to_string(index));
+            if(EDGE_STABILITY[index] != stability[index])
+                fail("Edge stability of " + to_string(own) + ", " + to_string(opp) + " is " + to_string(EDGE_STABILITY[index]) + ", not " + to_string(stability[index]));
+            checked++;
+        }
+    }
+
+    const Bitboard *tables[] = {LINE_MASKS.rows, LINE_MASKS.cols, LINE_MASKS.diagonals, LINE_MASKS.anti_diagonals};
+    const int sizes[] = {8, 8, 15, 15};
+    for(int t = 0, offset = 0; t < 4; offset += sizes[t], t++) {
+        for(int i = 0; i < sizes[t]; i++, checked++)
+            if(tables[t][i] != masks[offset + i])
+                fail("Line mask " + to_string(offset + i) + " differs");
+    }
+
+    //A board with one disc hashes to the key of that disc, and an empty one with the second
+    //player to move to the last key
+    Board_vec board(10, vector<Piece>(10, Piece::EMPTY));
+    for(int square = 0; square < 10 * 10; square++) {
+        for(int p = 0; p < 2; p++, checked++) {
+            board[square / 10][square % 10] = p == 0 ? Piece::P1 : Piece::P2;
+            if(Transposition_table::hash<10>(board, Piece::P1) != keys[square * 2 + p])
+                fail("Zobrist key " + to_string(square * 2 + p) + " differs");
+        }
+        board[square / 10][square % 10] = Piece::EMPTY;
+    }
+    if(Transposition_table::hash<10>(board, Piece::P2) != keys.back())
+        fail("Zobrist key of the second player to move differs");
+    checked++;
+
+    printf("%d entries checked, %d differ. Building them at runtime takes %.3f ms\n", checked, failures, seconds * 1000);
+    return failures > 0;
+}
@@ -0,0 +1,10 @@
+//Headless engine for GUIs and scripts, speaking the line based protocol described in Engine.h
+//
+//Usage: engine
+
+#include "Engine.h"
+
+int main() {
+    Engine engine(cin, cout);
+    engine.run();
+}
@@ -0,0 +1,231 @@
+//Enumerator of the distinct positions reachable from the start
+//
+//Writes every distinct position after each number of moves, one file per ply, without ever
+//holding a whole ply in memory. Each ply is made from the one before it in three steps:
+//  expand  worker threads read the last ply in chunks and play every legal move of each
+//          position. The children are collected in a buffer per worker, and each time one
+//          is full it is sorted, cleared of duplicates and written out as a run.
+//  merge   runs are merged MERGE_FAN_IN at a time, dropping duplicates, until few enough are
+//          left to merge in one pass straight into the new ply (see Record_file.h).
+//  rename  the new ply is written under a temporary name and renamed once complete, so an
+//          interrupted enumeration continues from the last complete ply when run again.
+//The memory used is the given budget for the expansion buffers, plus one buffer per run
+//being merged, and does not depend on the number of positions.
+//
+//A position is the discs of the player to move and of the opponent, so a pass is not a ply
+//and ply N holds the positions with N + 4 discs. After a move the opponent is to move, or the
+//same player if the opponent has to pass. Finished games are kept, seen from the opponent of
+//the last player to move, but have no children. With "symmetry", each position is replaced
+//by the smallest of its 8 rotations and reflections (see canonical() in Bitboard.h).
+//
+//Each ply file is <directory>/ply_<N>.pos: 16 byte records of the two bitboards, mover's
+//first, as little endian 64 bit integers (bit row * 8 + col), sorted and without duplicates.
+//
+//Usage: enumerate_positions <directory> <plies> [threads] [memory MiB] [symmetry|plain]
+//0 threads uses every core.
+
+#include "Board.h"
+#include "Bitboard.h"
+#include "Record_file.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+
+using namespace std;
+
+struct Record {
+    Bitboard own;  //Discs of the player to move
+    Bitboard opp;
+};
+
+bool operator<(const Record &a, const Record &b) {
+    return a.own < b.own || (a.own == b.own && a.opp < b.opp);
+}
+
+bool operator==(const Record &a, const Record &b) {
+    return a.own == b.own && a.opp == b.opp;
+}
+
+static_assert(sizeof(Record) == 16, "Records are written to disk as they are in memory");
+
+const static size_t CHUNK = 1 << 16;  //Records handed to an expansion worker at a time
+
+string ply_path(const string &directory, int ply) {
+    return directory + "/ply_" + to_string(ply) + ".pos";
+}
+
+bool file_exists(const string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+Record make_record(Bitboard own, Bitboard opp, bool symmetry) {
+    if(symmetry)
+        canonical(own, opp);
+    return {own, opp};
+}
+
+//Adds the position after each legal move of the player to move
+void add_children(const Record &parent, bool symmetry, vector<Record> &out) {
+    Bitboard moves = legal_moves<8>(parent.own, parent.opp);
+    while(moves) {
+        int square = first_square(moves);
+        moves &= moves - 1;
+
+        Bitboard flips = flipped_discs<8>(parent.own, parent.opp, square);
+        Bitboard own = parent.own | flips | (Bitboard(1) << square);
+        Bitboard opp = parent.opp & ~flips;
+
+        //The opponent moves next, unless only the player who just moved can
+        if(!legal_moves<8>(opp, own) && legal_moves<8>(own, opp))
+            out.push_back(make_record(own, opp, symmetry));
+        else
+            out.push_back(make_record(opp, own, symmetry));
+    }
+}
+
+//Everything the expansion workers share
+struct Expansion {
+    Record_reader<Record> *input;
+    mutex input_lock;
+
+    string directory;
+    bool symmetry;
+    size_t buffer_records;  //For each worker
+
+    mutex runs_lock;
+    vector<string> runs;
+    atomic<int> next_run{0};
+    atomic<long long> children{0};
+};
+
+void add_run(Expansion &expansion, vector<Record> &buffer) {
+    string path = expansion.directory + "/run_" + to_string(expansion.next_run++) + ".tmp";
+    write_run(buffer, path, true);
+
+    lock_guard<mutex> lock(expansion.runs_lock);
+    expansion.runs.push_back(path);
+}
+
+void expand(Expansion &expansion) {
+    vector<Record> chunk(CHUNK);
+    vector<Record> buffer;
+    buffer.reserve(expansion.buffer_records);
+
+    while(true) {
+        size_t count;
+        {
+            lock_guard<mutex> lock(expansion.input_lock);
+            count = expansion.input->read(chunk.data(), chunk.size());
+        }
+        if(count == 0)
+            break;
+
+        for(size_t i = 0; i < count; i++) {
+            //A position has at most 33 moves, so the buffer is written out before it could overflow
+            if(buffer.size() + 33 > expansion.buffer_records) {
+                expansion.children += buffer.size();
+                add_run(expansion, buffer);
+                buffer.clear();
+            }
+            add_children(chunk[i], expansion.symmetry, buffer);
+        }
+    }
+
+    if(!buffer.empty()) {
+        expansion.children += buffer.size();
+        add_run(expansion, buffer);
+    }
+}
+
+//Makes the next ply from the last one
+void next_ply(const string &directory, int ply, int threads, size_t memory_records, bool symmetry) {
+    auto start = chrono::steady_clock::now();
+
+    Record_reader<Record> input(ply_path(directory, ply - 1), CHUNK);
+    Expansion expansion;
+    expansion.input = &input;
+    expansion.directory = directory;
+    expansion.symmetry = symmetry;
+    expansion.buffer_records = max(memory_records / threads, MIN_RECORD_BUFFER);
+
+    vector<thread> workers;
+    for(int i = 0; i < threads; i++)
+        workers.emplace_back(expand, ref(expansion));
+    for(thread &t: workers)
+        t.join();
+
+    //The merge's last pass writes the ply, and is the one pass that sees every position
+    string path = ply_path(directory, ply);
+    string temporary = path + ".tmp";
+    Record_writer<Record> writer(temporary, memory_records / (MERGE_FAN_IN + 1), true);
+    long long game_overs = 0;
+    int passes = merge_runs<Record>(expansion.runs, directory + "/merge_", memory_records, true, [&](const Record &record) {
+        writer.write(record);
+        if(!legal_moves<8>(record.own, record.opp) && !legal_moves<8>(record.opp, record.own))
+            game_overs++;
+    });
+    writer.close();
+    long long positions = writer.written();
+    if(rename(temporary.c_str(), path.c_str()) != 0)
+        cmpt::error("Cannot rename " + temporary + ": " + strerror(errno));
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("Ply %2d: %lld positions (%lld finished games) from %lld children, %zu runs, %d merge passes, %.2f s\n",
+        ply, positions, game_overs, expansion.children.load(), expansion.runs.size(), passes, seconds);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 3) {
+        cerr << "Usage: enumerate_positions <directory> <plies> [threads] [memory MiB] [symmetry|plain]" << endl;
+        return 1;
+    }
+
+    string directory = argv[1];
+    int plies = stoi(argv[2]);
+    int threads = argc > 3 ? stoi(argv[3]) : 0;
+    long long memory_mib = argc > 4 ? stoll(argv[4]) : 1024;
+    string mode = argc > 5 ? argv[5] : "symmetry";
+    if(threads <= 0)
+        threads = max(1, int(thread::hardware_concurrency()));
+    if(plies < 0 || plies > 60 || memory_mib < 1 || (mode != "symmetry" && mode != "plain")) {
+        cerr << "Usage: enumerate_positions <directory> <plies> [threads] [memory MiB] [symmetry|plain]" << endl;
+        return 1;
+    }
+
+    try {
+        if(mkdir(directory.c_str(), 0777) != 0 && errno != EEXIST)
+            cmpt::error("Cannot create " + directory + ": " + strerror(errno));
+
+        bool symmetry = mode == "symmetry";
+        size_t memory_records = memory_mib * (1 << 20) / sizeof(Record);
+
+        //Plies already in the directory were finished by an earlier run, with the same mode
+        if(!file_exists(ply_path(directory, 0))) {
+            Board_state start = Board_state::start();
+            Record_writer<Record> writer(ply_path(directory, 0), 1, true);
+            writer.write(make_record(start.p1, start.p2, symmetry));
+            writer.close();
+        }
+
+        for(int ply = 1; ply <= plies; ply++) {
+            if(file_exists(ply_path(directory, ply)))
+                continue;
+            next_ply(directory, ply, threads, memory_records, symmetry);
+        }
+    } catch(const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,616 @@
+//Differential fuzzer for move generation and play
+//
+//Plays games through a reference that walks the Board_vec one square at a time in each of
+//the 8 directions, as the board first did, and through every faster implementation: the
+//static Board_vec functions of Basic_board, Basic_board_state, and on the 8x8 board each
+//move kernel in Bitboard.h that the processor supports. At every ply, passes and the end of
+//the game included, they must agree on the legal moves, the discs a move on each square
+//would flip, which players can move, whether the game is over, the winner, and the board
+//after the move.
+//
+//Games come in four kinds: uniformly random moves, greedy moves that flip the most or the
+//fewest discs, moves on the edges first (where shifts can wrap around), and random moves
+//from a random scatter of discs, which gives odd shapes, early passes and early ends. Game i
+//always comes from the same seed, whatever the number of threads, and the failing game with
+//the lowest number is the one reported. It is shrunk to a minimal reproducer: the position
+//before the failing ply, with every disc taken away that the failure does not need.
+//
+//Usage: fuzz_moves [games] [threads] [board size | all] [seed]
+//0 threads uses every core.
+
+#include "Board.h"
+#include "Board_state.h"
+#include "Bitboard.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+
+using namespace std;
+
+const static int NO_MOVE = -1;  //A pass, or no move at the end of the game
+const static int KINDS = 4;
+const static char *const KIND_NAMES[KINDS] = {"random", "greedy", "edges first", "random start"};
+const static int SIZES[] = {4, 6, 8, 10};
+const static int SIZE_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+
+//What an implementation says about one ply: a position, the player to move, and the move
+//played in it (NO_MOVE if there is none)
+struct Ply_result {
+    vector<int> legal;  //The legal squares, lowest first
+    vector<int> flips;  //For every square, the discs a move there would flip
+    bool can_move[2];  //Of P1 and P2
+    bool game_over;
+    Piece winner;
+    int played_flips;
+    Board_vec after;
+};
+
+//A game that failed, and where
+struct Failure {
+    uint64_t game = UINT64_MAX;
+    int size;
+    int kind;
+    Board_vec start;
+    Piece first;
+    vector<int> moves;  //Played before the failing ply, NO_MOVE for passes
+    Board_vec board;  //Before the failing ply
+    Piece piece;
+    int move;
+    string difference;
+};
+
+int square_index(int size, Position pos) {
+    return pos.row * size + pos.col;
+}
+
+string square_name(int size, int square) {
+    if(square == NO_MOVE)
+        return "pass";
+    return to_string(Position(square / size, square % size));
+}
+
+//Reference
+
+//The discs a move at (row, col) flips in one direction: the opponent's discs up to the
+//first of the player's own, none if an empty square or the edge comes first
+template<int N>
+int reference_line(const Board_vec &board, Piece piece, int row, int col, int row_step, int col_step) {
+    int count = 0;
+    for(row += row_step, col += col_step; row >= 0 && row < N && col >= 0 && col < N; row += row_step, col += col_step) {
+        if(board[row][col] == Piece::EMPTY)
+            return 0;
+        if(board[row][col] == piece)
+            return count;
+        count++;
+    }
+    return 0;
+}
+
+template<int N>
+int reference_count_move(const Board_vec &board, Piece piece, int row, int col) {
+    if(board[row][col] != Piece::EMPTY)
+        return 0;
+
+    int total = 0;
+    for(int row_step = -1; row_step <= 1; row_step++)
+        for(int col_step = -1; col_step <= 1; col_step++)
+            if(row_step != 0 || col_step != 0)
+                total += reference_line<N>(board, piece, row, col, row_step, col_step);
+    return total;
+}
+
+template<int N>
+int reference_play(Board_vec &board, Piece piece, int row, int col) {
+    int total = 0;
+    for(int row_step = -1; row_step <= 1; row_step++) {
+        for(int col_step = -1; col_step <= 1; col_step++) {
+            if(row_step == 0 && col_step == 0)
+                continue;
+
+            int count = reference_line<N>(board, piece, row, col, row_step, col_step);
+            for(int i = 1; i <= count; i++)
+                board[row + i * row_step][col + i * col_step] = piece;
+            total += count;
+        }
+    }
+
+    board[row][col] = piece;
+    return total;
+}
+
+//The ply before a move is chosen, with the board left as it is
+template<int N>
+Ply_result reference_ply(const Board_vec &board, Piece piece) {
+    Ply_result out;
+    out.flips.assign(N * N, 0);
+    out.can_move[0] = out.can_move[1] = false;
+    int discs[2] = {0, 0};
+
+    for(int row = 0; row < N; row++) {
+        for(int col = 0; col < N; col++) {
+            int square = row * N + col;
+            if(board[row][col] != Piece::EMPTY) {
+                discs[board[row][col] == Piece::P1 ? 0 : 1]++;
+                continue;
+            }
+
+            int p1_flips = reference_count_move<N>(board, Piece::P1, row, col);
+            int p2_flips = reference_count_move<N>(board, Piece::P2, row, col);
+            out.can_move[0] = out.can_move[0] || p1_flips > 0;
+            out.can_move[1] = out.can_move[1] || p2_flips > 0;
+
+            out.flips[square] = piece == Piece::P1 ? p1_flips : p2_flips;
+            if(out.flips[square] > 0)
+                out.legal.push_back(square);
+        }
+    }
+
+    out.game_over = !out.can_move[0] && !out.can_move[1];
+    out.winner = discs[0] > discs[1] ? Piece::P1 : discs[0] < discs[1] ? Piece::P2 : Piece::EMPTY;
+    out.after = board;
+    out.played_flips = 0;
+    return out;
+}
+
+template<int N>
+Ply_result reference_ply(const Board_vec &board, Piece piece, int move) {
+    Ply_result out = reference_ply<N>(board, piece);
+    if(move != NO_MOVE)
+        out.played_flips = reference_play<N>(out.after, piece, move / N, move % N);
+    return out;
+}
+
+
+//Candidates
+
+template<int N>
+Ply_result board_ply(const Board_vec &board, Piece piece, int move) {
+    typedef Basic_board<N> Board_n;
+    Ply_result out;
+
+    for(Position pos: Board_n::get_legal_positions(board, piece))
+        out.legal.push_back(square_index(N, pos));
+    for(int square = 0; square < N * N; square++)
+        out.flips.push_back(Board_n::count_move(board, piece, square_position<N>(square)));
+
+    out.can_move[0] = Board_n::can_move(board, Piece::P1);
+    out.can_move[1] = Board_n::can_move(board, Piece::P2);
+    out.game_over = Board_n::game_over(board);
+    out.winner = Board_n::get_winner(board);
+    out.after = board;
+    out.played_flips = move == NO_MOVE ? 0 : Board_n::play(out.after, piece, square_position<N>(move));
+    return out;
+}
+
+template<int N>
+Ply_result state_ply(const Board_vec &board, Piece piece, int move) {
+    Basic_board_state<N> state = Basic_board_state<N>::from_vec(board);
+    Ply_result out;
+
+    for(Bits<N> moves = state.legal_moves(piece); moves; moves &= moves - 1)
+        out.legal.push_back(first_square(moves));
+    for(int square = 0; square < N * N; square++) {
+        Basic_board_state<N> next = state;
+        out.flips.push_back(next.play(piece, square_position<N>(square)));
+    }
+
+    out.can_move[0] = state.can_move(Piece::P1);
+    out.can_move[1] = state.can_move(Piece::P2);
+    out.game_over = state.game_over();
+    int p1 = state.count(Piece::P1), p2 = state.count(Piece::P2);
+    out.winner = p1 > p2 ? Piece::P1 : p1 < p2 ? Piece::P2 : Piece::EMPTY;
+
+    Basic_board_state<N> after = state;
+    out.played_flips = move == NO_MOVE ? 0 : after.play(piece, square_position<N>(move));
+    out.after = after.to_vec();
+    return out;
+}
+
+Ply_result kernel_ply(const Move_kernels &kernels, const Board_vec &board, Piece piece, int move) {
+    Bitboard own, opp, p1, p2;
+    to_bitboards<8>(board, piece, own, opp);
+    to_bitboards<8>(board, Piece::P1, p1, p2);
+    Ply_result out;
+
+    for(Bitboard moves = kernels.legal_moves(own, opp); moves; moves &= moves - 1)
+        out.legal.push_back(first_square(moves));
+    for(int square = 0; square < 64; square++) {
+        bool empty = !((own | opp) & (Bitboard(1) << square));
+        out.flips.push_back(empty ? count_bits(kernels.flipped_discs(own, opp, square)) : 0);
+    }
+
+    out.can_move[0] = kernels.legal_moves(p1, p2) != 0;
+    out.can_move[1] = kernels.legal_moves(p2, p1) != 0;
+    out.game_over = !out.can_move[0] && !out.can_move[1];
+    int discs1 = count_bits(p1), discs2 = count_bits(p2);
+    out.winner = discs1 > discs2 ? Piece::P1 : discs1 < discs2 ? Piece::P2 : Piece::EMPTY;
+
+    out.played_flips = 0;
+    if(move != NO_MOVE) {
+        Bitboard flips = kernels.flipped_discs(own, opp, move);
+        own |= flips | (Bitboard(1) << move);
+        opp &= ~flips;
+        out.played_flips = count_bits(flips);
+    }
+
+    out.after = Board_vec(8, vector<Piece>(8, Piece::EMPTY));
+    for(int square = 0; square < 64; square++) {
+        if(own & (Bitboard(1) << square))
+            out.after[square / 8][square % 8] = piece;
+        else if(opp & (Bitboard(1) << square))
+            out.after[square / 8][square % 8] = get_opponent(piece);
+    }
+    return out;
+}
+
+//The move kernels only exist for the 8x8 board
+template<int N>
+struct Kernel_candidates {
+    static void add(const Board_vec &, Piece, int, vector<pair<string, Ply_result>> &) {}
+};
+
+template<>
+struct Kernel_candidates<8> {
+    static void add(const Board_vec &board, Piece piece, int move, vector<pair<string, Ply_result>> &out) {
+        out.push_back({"scalar kernel", kernel_ply(SCALAR_KERNELS, board, piece, move)});
+#if defined(__x86_64__)
+        if(__builtin_cpu_supports("avx2"))
+            out.push_back({"avx2 kernel", kernel_ply(AVX2_KERNELS, board, piece, move)});
+#endif
+    }
+};
+
+
+//Checking and shrinking
+
+string piece_name(Piece piece) {
+    return piece == Piece::P1 ? "X" : piece == Piece::P2 ? "O" : "nobody";
+}
+
+//Describes the first way actual differs from expected, or returns "" if it does not
+string compare(int size, const Ply_result &expected, const Ply_result &actual) {
+    auto squares = [size](const vector<int> &list) {
+        string out;
+        for(int square: list)
+            out += (out.empty() ? "" : " ") + square_name(size, square);
+        return out.empty() ? string("none") : out;
+    };
+
+    if(actual.legal != expected.legal)
+        return "legal moves are " + squares(actual.legal) + ", expected " + squares(expected.legal);
+    for(int square = 0; square < size * size; square++)
+        if(actual.flips[square] != expected.flips[square])
+            return "a move on " + square_name(size, square) + " flips " + to_string(actual.flips[square]) +
+                ", expected " + to_string(expected.flips[square]);
+    for(int i = 0; i < 2; i++)
+        if(actual.can_move[i] != expected.can_move[i])
+            return piece_name(i == 0 ? Piece::P1 : Piece::P2) + (expected.can_move[i] ? " cannot" : " can") +
+                " move, expected the opposite";
+    if(actual.game_over != expected.game_over)
+        return string("the game is ") + (actual.game_over ? "over" : "not over") + ", expected the opposite";
+    if(actual.winner != expected.winner)
+        return "the winner is " + piece_name(actual.winner) + ", expected " + piece_name(expected.winner);
+    if(actual.played_flips != expected.played_flips)
+        return "the move flipped " + to_string(actual.played_flips) + ", expected " + to_string(expected.played_flips);
+    for(int square = 0; square < size * size; square++) {
+        Piece got = actual.after[square / size][square % size];
+        Piece wanted = expected.after[square / size][square % size];
+        if(got != wanted)
+            return "after the move " + square_name(size, square) + " holds " + piece_name(got) +
+                ", expected " + piece_name(wanted);
+    }
+    return "";
+}
+
+//Compares every candidate with the reference on one ply, returning "<candidate>: <difference>"
+//for the first that disagrees, or "" if they all agree
+template<int N>
+string check_ply(const Board_vec &board, Piece piece, int move, const Ply_result &expected) {
+    vector<pair<string, Ply_result>> candidates;
+    candidates.reserve(4);
+    candidates.push_back({"Basic_board", board_ply<N>(board, piece, move)});
+    candidates.push_back({"Basic_board_state", state_ply<N>(board, piece, move)});
+    Kernel_candidates<N>::add(board, piece, move, candidates);
+
+    for(const pair<string, Ply_result> &candidate: candidates) {
+        string difference = compare(N, expected, candidate.second);
+        if(difference != "")
+            return candidate.first + ": " + difference;
+    }
+    return "";
+}
+
+template<int N>
+string check_ply(const Board_vec &board, Piece piece, int move) {
+    return check_ply<N>(board, piece, move, reference_ply<N>(board, piece, move));
+}
+
+//Takes away discs, and then the move, for as long as the same candidate still fails
+template<int N>
+void shrink(Failure &failure) {
+    string candidate = failure.difference.substr(0, failure.difference.find(':'));
+    auto still_fails = [&](const Board_vec &board, int move, string &difference) {
+        //A move the reference no longer allows is not played
+        if(move != NO_MOVE && reference_count_move<N>(board, failure.piece, move / N, move % N) == 0)
+            move = NO_MOVE;
+        difference = check_ply<N>(board, failure.piece, move);
+        return difference.compare(0, candidate.size() + 1, candidate + ":") == 0;
+    };
+
+    for(bool changed = true; changed; ) {
+        changed = false;
+        for(int square = 0; square < N * N; square++) {
+            Piece &disc = failure.board[square / N][square % N];
+            if(disc == Piece::EMPTY)
+                continue;
+
+            Board_vec smaller = failure.board;
+            smaller[square / N][square % N] = Piece::EMPTY;
+            string difference;
+            if(still_fails(smaller, failure.move, difference)) {
+                failure.board = smaller;
+                failure.difference = difference;
+                changed = true;
+            }
+        }
+    }
+
+    string difference;
+    if(failure.move != NO_MOVE && still_fails(failure.board, NO_MOVE, difference)) {
+        failure.move = NO_MOVE;
+        failure.difference = difference;
+    }
+    if(failure.move != NO_MOVE && reference_count_move<N>(failure.board, failure.piece, failure.move / N, failure.move % N) == 0)
+        failure.move = NO_MOVE;
+}
+
+
+//Games
+
+struct Fuzz_stats {
+    atomic<long long> games{0};
+    atomic<long long> plies{0};
+    atomic<long long> passes{0};
+    mutex lock;
+    Failure failure;  //The lowest numbered failing game, if any
+};
+
+template<int N>
+Board_vec random_start(mt19937_64 &generator) {
+    Board_vec board(N, vector<Piece>(N, Piece::EMPTY));
+    double density = uniform_real_distribution<double>(0.2, 0.95)(generator);
+    for(vector<Piece> &row: board)
+        for(Piece &square: row)
+            if(uniform_real_distribution<double>(0, 1)(generator) < density)
+                square = generator() % 2 ? Piece::P1 : Piece::P2;
+    return board;
+}
+
+template<int N>
+int choose_move(int kind, bool most, const Ply_result &ply, mt19937_64 &generator) {
+    const vector<int> &legal = ply.legal;
+    if(kind == 1) {
+        int best = legal[generator() % legal.size()];
+        for(int square: legal)
+            if(most ? ply.flips[square] > ply.flips[best] : ply.flips[square] < ply.flips[best])
+                best = square;
+        return best;
+    }
+
+    if(kind == 2 && generator() % 5 != 0) {
+        vector<int> edges;
+        for(int square: legal) {
+            int row = square / N, col = square % N;
+            if(row == 0 || col == 0 || row == N - 1 || col == N - 1)
+                edges.push_back(square);
+        }
+        if(!edges.empty())
+            return edges[generator() % edges.size()];
+    }
+
+    return legal[generator() % legal.size()];
+}
+
+//Plays one game, checking every ply. Returns false with the failure filled in if a candidate
+//disagrees with the reference.
+template<int N>
+bool fuzz_game(uint64_t game, uint64_t seed, int kind, Fuzz_stats &stats, Failure &failure) {
+    mt19937_64 generator(seed ^ (game * 0x9e3779b97f4a7c15ULL));
+    bool most = generator() % 2;
+
+    Board_vec board = Basic_board_state<N>::start().to_vec();
+    Piece piece = Piece::P1;
+    if(kind == 3) {
+        board = random_start<N>(generator);
+        piece = generator() % 2 ? Piece::P1 : Piece::P2;
+    }
+
+    failure.size = N;
+    failure.kind = kind;
+    failure.start = board;
+    failure.first = piece;
+    failure.moves.clear();
+
+    long long plies = 0, passes = 0;
+    while(true) {
+        Ply_result expected = reference_ply<N>(board, piece);
+        int move = expected.legal.empty() ? NO_MOVE : choose_move<N>(kind, most, expected, generator);
+        if(move != NO_MOVE)
+            expected.played_flips = reference_play<N>(expected.after, piece, move / N, move % N);
+
+        string difference = check_ply<N>(board, piece, move, expected);
+        if(difference != "") {
+            failure.game = game;
+            failure.board = board;
+            failure.piece = piece;
+            failure.move = move;
+            failure.difference = difference;
+            break;
+        }
+
+        plies++;
+        if(expected.game_over)
+            break;
+        if(move == NO_MOVE)
+            passes++;
+
+        failure.moves.push_back(move);
+        board = expected.after;
+        piece = get_opponent(piece);
+    }
+
+    stats.plies += plies;
+    stats.passes += passes;
+    return failure.game == UINT64_MAX;
+}
+
+void fuzz_worker(const vector<int> &sizes, uint64_t games, uint64_t seed, atomic<uint64_t> &next, Fuzz_stats &stats) {
+    Failure failure;
+    while(true) {
+        uint64_t game = next++;
+        {
+            //Games after a known failure cannot be the one reported
+            lock_guard<mutex> lock(stats.lock);
+            if(game >= games || game > stats.failure.game)
+                return;
+        }
+
+        int size = sizes[game % sizes.size()];
+        int kind = (game / sizes.size()) % KINDS;
+        failure.game = UINT64_MAX;
+        bool passed = size == 4 ? fuzz_game<4>(game, seed, kind, stats, failure) :
+            size == 6 ? fuzz_game<6>(game, seed, kind, stats, failure) :
+            size == 8 ? fuzz_game<8>(game, seed, kind, stats, failure) :
+            fuzz_game<10>(game, seed, kind, stats, failure);
+        stats.games++;
+
+        if(!passed) {
+            lock_guard<mutex> lock(stats.lock);
+            if(game < stats.failure.game)
+                stats.failure = failure;
+        }
+    }
+}
+
+string board_text(const Board_vec &board) {
+    string out;
+    for(const vector<Piece> &row: board) {
+        out += "   ";
+        for(Piece square: row)
+            out += square == Piece::P1 ? " X" : square == Piece::P2 ? " O" : " -";
+        out += "\n";
+    }
+    return out;
+}
+
+//The board as one line of squares and the player to move, as bench_solve and game_index read it
+string board_line(const Board_vec &board, Piece piece) {
+    string out;
+    for(const vector<Piece> &row: board)
+        for(Piece square: row)
+            out += square == Piece::P1 ? 'X' : square == Piece::P2 ? 'O' : '-';
+    return out + " " + piece_name(piece);
+}
+
+void report(Failure failure) {
+    int size = failure.size;
+    printf("\nGame %llu (%s, %dx%d) failed at ply %zu\n", (unsigned long long)failure.game,
+        KIND_NAMES[failure.kind], size, size, failure.moves.size() + 1);
+    printf("  %s\n", failure.difference.c_str());
+    printf("Start, %s to move:\n%s", piece_name(failure.first).c_str(), board_text(failure.start).c_str());
+
+    string moves;
+    for(int move: failure.moves)
+        moves += move == NO_MOVE ? "pa" : square_name(size, move);
+    printf("Moves: %s\n", moves.empty() ? "none" : moves.c_str());
+    printf("Failing position, %s to move, %s:\n%s", piece_name(failure.piece).c_str(),
+        failure.move == NO_MOVE ? "no move played" : ("playing " + square_name(size, failure.move)).c_str(), board_text(failure.board).c_str());
+
+    if(size == 4) shrink<4>(failure);
+    else if(size == 6) shrink<6>(failure);
+    else if(size == 8) shrink<8>(failure);
+    else shrink<10>(failure);
+
+    int discs = 0;
+    for(const vector<Piece> &row: failure.board)
+        for(Piece square: row)
+            discs += square != Piece::EMPTY;
+    printf("\nShrunk to %d discs, %s to move, %s:\n%s", discs, piece_name(failure.piece).c_str(),
+        failure.move == NO_MOVE ? "no move played" : ("playing " + square_name(size, failure.move)).c_str(), board_text(failure.board).c_str());
+    printf("  %s\n  %s\n", failure.difference.c_str(), board_line(failure.board, failure.piece).c_str());
+}
+
+int main(int argc, char *argv[]) {
+    long long games = 100000;
+    int threads = 0;
+    string size = argc > 3 ? argv[3] : "8";
+    uint64_t seed = 1;
+    bool numbers = true;
+    try {
+        if(argc > 1)
+            games = stoll(argv[1]);
+        if(argc > 2)
+            threads = stoi(argv[2]);
+        if(argc > 4)
+            seed = stoull(argv[4]);
+    } catch(const exception &) {
+        numbers = false;
+    }
+
+    vector<int> sizes;
+    if(size == "all")
+        sizes.assign(SIZES, SIZES + SIZE_COUNT);
+    for(int s: SIZES)
+        if(size == to_string(s))
+            sizes.push_back(s);
+    if(!numbers || games < 1 || threads < 0 || sizes.empty()) {
+        cerr << "Usage: fuzz_moves [games] [threads] [board size | all] [seed]" << endl;
+        cerr << "Board sizes are 4, 6, 8 and 10" << endl;
+        return 1;
+    }
+    if(threads == 0)
+        threads = max(1, int(thread::hardware_concurrency()));
+
+    string checked = "Basic_board, Basic_board_state";
+    if(find(sizes.begin(), sizes.end(), 8) != sizes.end()) {
+        checked += ", scalar kernel";
+#if defined(__x86_64__)
+        if(__builtin_cpu_supports("avx2"))
+            checked += ", avx2 kernel";
+#endif
+    }
+    printf("Checking %s against the reference on %lld games with %d threads\n", checked.c_str(), games, threads);
+    fflush(stdout);
+
+    Fuzz_stats stats;
+    atomic<uint64_t> next{0};
+    auto start = chrono::steady_clock::now();
+
+    vector<thread> workers;
+    for(int i = 0; i < threads; i++)
+        workers.emplace_back(fuzz_worker, cref(sizes), uint64_t(games), seed, ref(next), ref(stats));
+    for(thread &t: workers)
+        t.join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%lld games, %lld plies (%lld passes) in %.2f s: %.0f games/s, %.0f plies/s\n",
+        stats.games.load(), stats.plies.load(), stats.passes.load(), seconds,
+        stats.games / seconds, stats.plies / seconds);
+
+    if(stats.failure.game != UINT64_MAX) {
+        report(stats.failure);
+        return 1;
+    }
+    printf("No differences found\n");
+}
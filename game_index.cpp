@@ -0,0 +1,166 @@
+//Index of the positions in a game archive
+//
+//"build" replays every game of an archive (one game per line, as move lists or GGF records)
+//and writes an index of the games through each position (see Position_index.h). "query"
+//finds a position in the index, given as the moves that lead to it from the start or as 64
+//squares of X, O and - followed by the player to move, and prints the results of the games
+//that reached it and the moves played from it. Given the archive too, it prints the first
+//of those games.
+//
+//Usage: game_index build <archive> <index> [memory MiB]
+//       game_index query <index> <moves | squares side> [games to list] [archive]
+
+#include "Position_index.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+
+using namespace std;
+
+const static int DEFAULT_LISTED = 10;
+
+int build(const string &archive, const string &index_path, long long memory_mib) {
+    auto start = chrono::steady_clock::now();
+    Index_build_stats stats = Position_index::build(archive, index_path, memory_mib * (1 << 20) / 16);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("Games: %llu indexed, %llu unreadable lines skipped\n",
+        (unsigned long long)stats.games, (unsigned long long)stats.skipped);
+    printf("Postings: %llu for %llu distinct positions, in %llu blocks\n",
+        (unsigned long long)stats.postings, (unsigned long long)stats.keys, (unsigned long long)stats.blocks);
+    printf("Index: %.1f MiB, %.1f bytes per posting, %d sorted runs, %d merge passes, %.2f s\n",
+        stats.bytes / 1048576.0, stats.postings ? double(stats.bytes) / stats.postings : 0.0,
+        stats.runs, stats.merge_passes, seconds);
+    return 0;
+}
+
+//Reads the position to look up, as 64 squares and a side or as moves from the start
+bool read_position(const string &first, const string &second, Board_state &board, Piece &to_move, string &error) {
+    if(first.size() == 64) {
+        board.p1 = board.p2 = 0;
+        for(int square = 0; square < 64; square++) {
+            char c = toupper(first[square]);
+            if(c == 'X' || c == '*' || c == 'B')
+                board.p1 |= Bitboard(1) << square;
+            else if(c == 'O' || c == 'W')
+                board.p2 |= Bitboard(1) << square;
+            else if(c != '-' && c != '.') {
+                error = "Cannot read square " + to_string(square + 1) + " of the position";
+                return false;
+            }
+        }
+
+        char side = second.empty() ? 'X' : toupper(second[0]);
+        to_move = (side == 'O' || side == 'W') ? Piece::P2 : Piece::P1;
+        return true;
+    }
+
+    Game_record record;
+    if(!read_game_record(first, record, error))
+        return false;
+
+    board = record.final_board;
+    to_move = record.moves.empty() ? Piece::P1 : get_opponent(record.moves.back().player);
+    return true;
+}
+
+string percent(long long part, long long whole) {
+    char out[16];
+    snprintf(out, sizeof(out), "%5.1f%%", whole ? 100.0 * part / whole : 0.0);
+    return out;
+}
+
+int query(int argc, char *argv[]) {
+    string index_path = argv[2];
+    string first = argv[3];
+    //The side follows the squares as its own argument
+    bool squares = first.size() == 64;
+    int next = squares ? 5 : 4;
+    string side = squares && argc > 4 ? argv[4] : "";
+    int listed = argc > next ? stoi(argv[next]) : DEFAULT_LISTED;
+    string archive = argc > next + 1 ? argv[next + 1] : "";
+
+    Board_state board;
+    Piece to_move;
+    string error;
+    if(!read_position(first, side, board, to_move, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    Position_index index(index_path);
+    auto start = chrono::steady_clock::now();
+    Position_stats stats = index.lookup(board, to_move);
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    long long total = stats.games.size();
+    if(!board.game_over() && !board.can_move(to_move))
+        to_move = get_opponent(to_move);
+    const char *player = board.game_over() ? "X" : to_move == Piece::P1 ? "X" : "O";
+
+    printf("%lld of %llu games reached the position, found in %.3f ms\n", total, (unsigned long long)index.games(), milliseconds);
+    if(total == 0)
+        return 0;
+
+    printf("For %s: %lld wins %s, %lld draws %s, %lld losses %s, average margin %+.1f\n", player,
+        stats.wins, percent(stats.wins, total).c_str(), stats.draws, percent(stats.draws, total).c_str(),
+        stats.losses, percent(stats.losses, total).c_str(), double(stats.total_margin) / total);
+    if(stats.finished)
+        printf("%lld games ended here\n", stats.finished);
+
+    if(!stats.next_moves.empty()) {
+        printf("\nMove  Games  Played  Score for %s\n", player);
+        for(const Position_stats::Next_move &move: stats.next_moves)
+            printf("%-4s %6lld  %s  %s\n", to_string(move.pos).c_str(), move.games,
+                percent(move.games, total).c_str(), percent(2 * move.wins + move.draws, 2 * move.games).c_str());
+    }
+
+    ifstream file;
+    if(archive != "") {
+        file.open(archive, ios::binary);
+        if(!file) {
+            cerr << "Cannot open " << archive << endl;
+            return 1;
+        }
+    }
+
+    printf("\nGames:");
+    for(int i = 0; i < listed && i < total; i++) {
+        uint64_t id = stats.games[i];
+        Indexed_game game = index.game(id);
+        if(!file.is_open()) {
+            printf(" %llu", (unsigned long long)id);
+            continue;
+        }
+
+        string line;
+        file.seekg(game.archive_offset);
+        getline(file, line);
+        printf("\n%llu (%+d): %s", (unsigned long long)id, game.margin, line.c_str());
+    }
+    printf("%s\n", total > listed ? " ..." : "");
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    string command = argc > 1 ? argv[1] : "";
+    if(!((command == "build" && argc >= 4) || (command == "query" && argc >= 4))) {
+        cerr << "Usage: game_index build <archive> <index> [memory MiB]" << endl;
+        cerr << "       game_index query <index> <moves | squares side> [games to list] [archive]" << endl;
+        return 1;
+    }
+
+    try {
+        if(command == "build")
+            return build(argv[2], argv[3], argc > 4 ? stoll(argv[4]) : 1024);
+        return query(argc, argv);
+    } catch(const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}
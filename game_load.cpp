@@ -0,0 +1,155 @@
+//Load generator for game_server
+//
+//Keeps a number of clients connected at once, each playing random legal moves in one game
+//after another until the total number of games has been played. Reports games per second
+//and the latency of each move: the time from sending a move (or starting a game) until the
+//server hands the turn back or ends the game, which includes the computer's search.
+//
+//Usage: game_load <address> [games] [clients] [depth]
+
+#include "Board.h"
+#include "Socket.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <poll.h>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Client {
+    int fd;
+    string input;
+    Board board;
+    Piece piece = Piece::P1;
+    Clock::time_point sent;
+    bool playing = false;
+};
+
+//Sends a whole line, returning false if the server has gone
+bool send_line(Client &client, const string &line) {
+    string out = line + "\n";
+    for(size_t sent = 0; sent < out.size(); ) {
+        ssize_t n = send(client.fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if(n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+bool start_game(Client &client, mt19937 &generator, int depth) {
+    client.board.reset();
+    client.piece = generator() % 2 ? Piece::P1 : Piece::P2;
+    client.playing = true;
+    client.sent = Clock::now();
+    return send_line(client, string("NEW ") + (client.piece == Piece::P1 ? "X" : "O") + " " + to_string(depth));
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        cerr << "Usage: game_load <address> [games] [clients] [depth]" << endl;
+        return 1;
+    }
+
+    string address = argv[1];
+    int games = argc > 2 ? stoi(argv[2]) : 1000;
+    int count = argc > 3 ? stoi(argv[3]) : 100;
+    int depth = argc > 4 ? stoi(argv[4]) : 2;
+
+    mt19937 generator(1);
+    vector<unique_ptr<Client>> clients;
+    for(int i = 0; i < count; i++) {
+        int fd = connect_socket(address);
+        if(fd < 0) {
+            cerr << "Cannot connect to " << address << " (" << i << " clients connected)" << endl;
+            return 1;
+        }
+        clients.emplace_back(new Client());
+        clients.back()->fd = fd;
+    }
+
+    auto start = Clock::now();
+    int started = 0, finished = 0;
+    vector<double> latencies;
+
+    for(unique_ptr<Client> &client: clients)
+        if(started < games && start_game(*client, generator, depth))
+            started++;
+
+    while(finished < started) {
+        vector<pollfd> fds;
+        for(unique_ptr<Client> &client: clients)
+            fds.push_back({client->fd, POLLIN, 0});
+        if(poll(fds.data(), fds.size(), 10000) <= 0) {
+            cerr << "The server stopped answering" << endl;
+            return 1;
+        }
+
+        for(size_t i = 0; i < clients.size(); i++) {
+            if(!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            Client &client = *clients[i];
+            char buffer[4096];
+            ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+            if(n <= 0) {
+                cerr << "The server closed a connection" << endl;
+                return 1;
+            }
+            client.input.append(buffer, n);
+
+            size_t end;
+            while((end = client.input.find('\n')) != string::npos) {
+                string line = client.input.substr(0, end);
+                client.input.erase(0, end + 1);
+
+                if(line.compare(0, 5, "MOVE ") == 0) {
+                    string square = line.substr(5);
+                    Position pos(stoi(square.substr(1)) - 1, square[0] - 'A');
+                    client.board.play(get_opponent(client.piece), pos);
+                } else if(line == "TURN" || line.compare(0, 4, "END ") == 0) {
+                    latencies.push_back(chrono::duration<double>(Clock::now() - client.sent).count());
+
+                    if(line == "TURN") {
+                        vector<Position> moves = Board::get_legal_positions(client.board.get_board_vec(), client.piece);
+                        Position pos = moves[generator() % moves.size()];
+                        client.board.play(client.piece, pos);
+                        client.sent = Clock::now();
+                        send_line(client, "PLAY " + to_string(pos));
+                    } else {
+                        finished++;
+                        client.playing = false;
+                        if(started < games && start_game(client, generator, depth))
+                            started++;
+                    }
+                } else if(line.compare(0, 5, "ERROR") == 0 || line == "ILLEGAL") {
+                    cerr << "Server replied: " << line << endl;
+                    return 1;
+                }
+            }
+        }
+    }
+
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    for(unique_ptr<Client> &client: clients) {
+        send_line(*client, "QUIT");
+        close(client->fd);
+    }
+
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0 : latencies[min(latencies.size() - 1, size_t(p * latencies.size()))] * 1000;
+    };
+
+    printf("Games: %d in %.2f s, %.1f games per second\n", finished, seconds, finished / seconds);
+    printf("Moves: %zu  latency p50 %.2f ms  p99 %.2f ms  max %.2f ms\n", latencies.size(),
+        percentile(0.5), percentile(0.99), percentile(1.0));
+}
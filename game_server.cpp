@@ -0,0 +1,484 @@
+//Game server, hosting many games against the computer at once
+//
+//Connections are shared between a few event loop threads, each waiting on its own epoll
+//set, so one thread serves thousands of idle or waiting clients. No loop ever blocks on
+//a game: the games are advanced with the step API of Game, and the computer's turns are
+//queued for a separate pool of search threads, whose moves are handed back to the loop
+//that owns the game.
+//
+//The protocol is line based. The client sends:
+//  NEW <X|O> [depth]   starts a game, playing X (first) or O against the computer
+//  PLAY <square>       plays a move when it is the client's turn
+//  QUIT
+//and the server replies:
+//  OK                  the game has started
+//  MOVE <square>       the computer played
+//  PASS                the client has no move, so the computer plays again
+//  TURN                the client is to move
+//  ILLEGAL             the client's last command was not a legal move, still its turn
+//  END <margin>        the game is over, margin in discs from the client's side
+//  ERROR <message>
+//
+//Usage: game_server <address> [event loops] [search threads]
+//Addresses are unix:<path> or <host>:<port>.
+
+#include "Game.h"
+#include "Computer_player.h"
+#include "Socket.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <csignal>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+using namespace std;
+
+const static int DEFAULT_DEPTH = 3;
+const static int MAX_DEPTH = 10;
+const static int END_GAME_DEPTH = 8;
+const static size_t MAX_LINE = 256;  //Longer lines are not commands of this protocol
+
+class Event_loop;
+
+//A computer turn waiting for, or coming back from, the search pool
+struct Search_job {
+    Event_loop *loop;
+    int fd;
+    uint64_t session;  //Tells a new connection apart from a closed one with the same fd
+    Board_state board;
+    Piece piece;
+    int depth;
+    string move;  //Filled in by the search
+};
+
+//Search threads, each with its own computer player, as a player's search state is not
+//shared between threads
+class Search_pool {
+private:
+    vector<thread> _threads;
+    deque<Search_job> _jobs;
+    mutex _lock;
+    condition_variable _wake;
+    bool _closing = false;
+
+    void work();
+
+public:
+    explicit Search_pool(int threads);
+    ~Search_pool();
+
+    void submit(Search_job job);
+};
+
+//One connection and the game it is playing
+class Session : public Game_host {
+private:
+    Board _board;
+    Game _game;
+
+public:
+    int fd;
+    uint64_t id;
+    string input;
+    string output;
+
+    bool playing = false;
+    bool searching = false;  //The computer's turn is with the search pool
+    Piece client = Piece::P1;
+    int depth = DEFAULT_DEPTH;
+
+    Session(int fd, uint64_t id);
+
+    //Commands that are not moves arrive here from the game, they are never valid mid-game
+    void handle_command(string s) override;
+
+    Game& game();
+    const Board& board() const;
+    void reply(const string &line);
+};
+
+class Event_loop {
+private:
+    int _epoll;
+    int _wake;  //eventfd written by the search pool when moves are ready
+    int _listener;
+    Search_pool &_pool;
+
+    map<int, unique_ptr<Session>> _sessions;
+    uint64_t _next_id;
+
+    mutex _lock;
+    vector<Search_job> _finished;
+
+    void accept_clients();
+    void read_client(Session &session);
+    void handle_line(Session &session, const string &line);
+    //Moves the game on after a move, to the client's turn, the computer's turn or the end
+    void advance(Session &session);
+    void flush(Session &session);
+    void close_session(int fd);
+    void apply_moves();
+
+public:
+    Event_loop(int listener, Search_pool &pool, uint64_t first_id);
+    void run();
+
+    //Called by search threads
+    void finished(Search_job job);
+};
+
+Search_pool::Search_pool(int threads) {
+    for(int i = 0; i < threads; i++)
+        _threads.emplace_back(&Search_pool::work, this);
+}
+
+Search_pool::~Search_pool() {
+    {
+        lock_guard<mutex> lock(_lock);
+        _closing = true;
+    }
+    _wake.notify_all();
+    for(thread &t: _threads)
+        t.join();
+}
+
+void Search_pool::submit(Search_job job) {
+    {
+        lock_guard<mutex> lock(_lock);
+        _jobs.push_back(move(job));
+    }
+    _wake.notify_one();
+}
+
+void Search_pool::work() {
+    Board board;
+    Computer_player player(Piece::P1, &board, DEFAULT_DEPTH, END_GAME_DEPTH, false);
+    player.set_solver_threads(1);
+
+    while(true) {
+        Search_job job;
+        {
+            unique_lock<mutex> lock(_lock);
+            _wake.wait(lock, [this] {return _closing || !_jobs.empty();});
+            if(_closing)
+                return;
+            job = move(_jobs.front());
+            _jobs.pop_front();
+        }
+
+        board.set_state(job.board);
+        player.set_piece(job.piece);
+        player.set_depth(job.depth);
+        job.move = player.move();
+        job.loop->finished(move(job));
+    }
+}
+
+Session::Session(int fd, uint64_t id):
+    _game(this, &_board, nullptr, nullptr),
+    fd(fd),
+    id(id)
+{}
+
+void Session::handle_command(string s) {
+    reply("ERROR Not a move: " + s);
+}
+
+Game& Session::game() {
+    return _game;
+}
+
+const Board& Session::board() const {
+    return _board;
+}
+
+void Session::reply(const string &line) {
+    output += line;
+    output += '\n';
+}
+
+Event_loop::Event_loop(int listener, Search_pool &pool, uint64_t first_id):
+    _epoll(epoll_create1(0)),
+    _wake(eventfd(0, EFD_NONBLOCK)),
+    _listener(listener),
+    _pool(pool),
+    _next_id(first_id)
+{
+    if(_epoll < 0 || _wake < 0)
+        cmpt::error("Cannot create the event loop");
+
+    //Every loop waits on the listener, and EPOLLEXCLUSIVE wakes only one of them per client
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.fd = _listener;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _listener, &event);
+
+    event.events = EPOLLIN;
+    event.data.fd = _wake;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake, &event);
+}
+
+void Event_loop::run() {
+    const int MAX_EVENTS = 256;
+    epoll_event events[MAX_EVENTS];
+
+    while(true) {
+        int count = epoll_wait(_epoll, events, MAX_EVENTS, -1);
+        for(int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+
+            if(fd == _listener) {
+                accept_clients();
+            } else if(fd == _wake) {
+                uint64_t signals;
+                while(read(_wake, &signals, sizeof(signals)) > 0) {}
+                apply_moves();
+            } else {
+                auto found = _sessions.find(fd);
+                if(found == _sessions.end())
+                    continue;
+
+                Session &session = *found->second;
+                if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    close_session(fd);
+                    continue;
+                }
+                if(events[i].events & EPOLLOUT)
+                    flush(session);
+                //Flushing closes the session if the client has gone
+                if((events[i].events & EPOLLIN) && _sessions.count(fd))
+                    read_client(session);
+            }
+        }
+    }
+}
+
+void Event_loop::finished(Search_job job) {
+    {
+        lock_guard<mutex> lock(_lock);
+        _finished.push_back(move(job));
+    }
+    uint64_t one = 1;
+    if(write(_wake, &one, sizeof(one)) < 0) {
+        //The counter is full, so the loop is already due to wake up
+    }
+}
+
+void Event_loop::accept_clients() {
+    while(true) {
+        int fd = accept(_listener, nullptr, nullptr);
+        if(fd < 0)
+            return;
+
+        set_nonblocking(fd);
+        _sessions[fd].reset(new Session(fd, _next_id++));
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void Event_loop::read_client(Session &session) {
+    int fd = session.fd;
+    char buffer[4096];
+
+    while(true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close_session(fd);
+            return;
+        }
+        if(n < 0)
+            break;
+        session.input.append(buffer, n);
+    }
+
+    size_t end;
+    while((end = session.input.find('\n')) != string::npos) {
+        string line = session.input.substr(0, end);
+        session.input.erase(0, end + 1);
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        handle_line(session, line);
+        if(_sessions.find(fd) == _sessions.end())
+            return;  //The client quit
+    }
+
+    if(session.input.size() > MAX_LINE) {
+        close_session(fd);
+        return;
+    }
+
+    flush(session);
+}
+
+void Event_loop::handle_line(Session &session, const string &line) {
+    istringstream args(line);
+    string command;
+    args >> command;
+    for(char &c: command) c = toupper(c);
+
+    if(command == "QUIT") {
+        int fd = session.fd;
+        flush(session);
+        if(_sessions.count(fd))
+            close_session(fd);
+    } else if(command == "NEW") {
+        if(session.searching) {
+            session.reply("ERROR Wait for the computer to move");
+            return;
+        }
+
+        string side;
+        int depth = DEFAULT_DEPTH;
+        args >> side >> depth;
+        for(char &c: side) c = toupper(c);
+        if(side != "X" && side != "O") {
+            session.reply("ERROR Choose X or O");
+            return;
+        }
+
+        session.client = side == "X" ? Piece::P1 : Piece::P2;
+        session.depth = max(1, min(MAX_DEPTH, depth));
+        session.playing = true;
+        session.game().start();
+        session.reply("OK");
+        advance(session);
+    } else if(command == "PLAY") {
+        if(!session.playing || session.searching || session.game().active_player() != session.client) {
+            session.reply("ERROR Not your turn");
+            return;
+        }
+
+        string square;
+        args >> square;
+        Step step = session.game().submit(square);
+        if(step == Step::PLAYED)
+            advance(session);
+        else if(step == Step::ILLEGAL)
+            session.reply("ILLEGAL");
+        else
+            session.handle_command(square);
+    } else if(command != "") {
+        session.reply("ERROR Unknown command: " + command);
+    }
+}
+
+void Event_loop::advance(Session &session) {
+    Game &game = session.game();
+
+    if(game.over()) {
+        int margin = session.board().count_pieces(session.client) - session.board().count_pieces(get_opponent(session.client));
+        session.reply("END " + to_string(margin));
+        session.playing = false;
+    } else if(game.active_player() == session.client) {
+        session.reply("TURN");
+    } else {
+        session.searching = true;
+        _pool.submit({this, session.fd, session.id, session.board().state(),
+            game.active_player(), session.depth, ""});
+    }
+}
+
+void Event_loop::apply_moves() {
+    vector<Search_job> jobs;
+    {
+        lock_guard<mutex> lock(_lock);
+        jobs.swap(_finished);
+    }
+
+    for(Search_job &job: jobs) {
+        auto found = _sessions.find(job.fd);
+        if(found == _sessions.end() || found->second->id != job.session)
+            continue;  //The client left while the computer was thinking
+
+        Session &session = *found->second;
+        session.searching = false;
+        if(session.game().submit(job.move) != Step::PLAYED) {
+            session.reply("ERROR The computer could not move");
+            session.playing = false;
+        } else {
+            session.reply("MOVE " + job.move);
+            //The computer is still to move if the client had to pass
+            if(!session.game().over() && session.game().active_player() != session.client)
+                session.reply("PASS");
+            advance(session);
+        }
+        flush(session);
+    }
+}
+
+void Event_loop::flush(Session &session) {
+    while(!session.output.empty()) {
+        ssize_t n = send(session.fd, session.output.data(), session.output.size(), MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if(n <= 0) {
+            close_session(session.fd);
+            return;
+        }
+        session.output.erase(0, n);
+    }
+
+    //Only wait for the socket to drain while there is something left to send
+    epoll_event event = {};
+    event.events = session.output.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+    event.data.fd = session.fd;
+    epoll_ctl(_epoll, EPOLL_CTL_MOD, session.fd, &event);
+}
+
+void Event_loop::close_session(int fd) {
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    _sessions.erase(fd);
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        cerr << "Usage: game_server <address> [event loops] [search threads]" << endl;
+        return 1;
+    }
+
+    int loops = argc > 2 ? stoi(argv[2]) : 2;
+    int searchers = argc > 3 ? stoi(argv[3]) : max(1, int(thread::hardware_concurrency()));
+
+    try {
+        int listener = listen_socket(argv[1]);
+        set_nonblocking(listener);
+        signal(SIGPIPE, SIG_IGN);
+
+        Search_pool pool(searchers);
+
+        //Session ids only need to be unique, so each loop counts in its own range
+        vector<unique_ptr<Event_loop>> event_loops;
+        for(int i = 0; i < max(1, loops); i++)
+            event_loops.emplace_back(new Event_loop(listener, pool, uint64_t(i) << 48));
+
+        cout << "Serving on " << argv[1] << " with " << event_loops.size() << " event loops and "
+            << searchers << " search threads" << endl;
+
+        vector<thread> threads;
+        for(unique_ptr<Event_loop> &loop: event_loops)
+            threads.emplace_back(&Event_loop::run, loop.get());
+        for(thread &t: threads)
+            t.join();
+    } catch(const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}
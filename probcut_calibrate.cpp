@@ -0,0 +1,89 @@
+//Calibration tool for the Multi-ProbCut search in Computer_player.h
+//
+//Generates positions from randomized self-play games, searches each of them at
+//a deep depth d and a shallow depth d / 2 and fits deep = slope * shallow + intercept
+//with least squares. The fits are printed as a PROBCUT_FITS table, ready to be
+//pasted into Computer_player.h.
+//
+//Usage: probcut_calibrate [positions] [max_depth] [seed]
+
+#include "Board.h"
+#include "Computer_player.h"
+#include "Random_positions.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    int positions = argc > 1 ? stoi(argv[1]) : 200;
+    int max_depth = argc > 2 ? stoi(argv[2]) : 6;
+    int seed = argc > 3 ? stoi(argv[3]) : 1;
+
+    Board board;
+    Computer_player engine(Piece::P1, &board, max_depth + 1, 0, false);
+    mt19937 generator(seed);
+
+    //Sums for the least squares fit of each deep depth
+    vector<double> n(max_depth + 1), sx(max_depth + 1), sy(max_depth + 1);
+    vector<double> sxx(max_depth + 1), sxy(max_depth + 1), syy(max_depth + 1);
+
+    int sampled = 0;
+    while(sampled < positions) {
+        //Positions from 8 to 44 moves into games where the engine mostly plays its best move
+        int empties = 60 - uniform_int_distribution<int>(8, 44)(generator);
+        Random_position position = random_position(generator, empties, Engine_move<Computer_player>{engine, 0.7});
+        Board_vec board_state = position.board_vec();
+        Piece piece = position.piece;
+
+        for(int deep = PROBCUT_MIN_DEPTH; deep <= max_depth; deep++) {
+            engine.clear_cache();
+            double x = engine.search_value(board_state, piece, deep / 2);
+            engine.clear_cache();
+            double y = engine.search_value(board_state, piece, deep);
+
+            //Finished game values are far outside the range of the evaluation
+            if(fabs(x) >= INT_MAX / 4 || fabs(y) >= INT_MAX / 4)
+                continue;
+
+            n[deep] += 1;
+            sx[deep] += x;
+            sy[deep] += y;
+            sxx[deep] += x * x;
+            sxy[deep] += x * y;
+            syy[deep] += y * y;
+        }
+
+        sampled++;
+        cerr << "\rPositions: " << sampled << "/" << positions << flush;
+    }
+    cerr << endl;
+
+    cout << "const static Probcut_fit PROBCUT_FITS[] = {" << endl;
+    for(int deep = 0; deep <= max_depth; deep++) {
+        char line[128];
+
+        if(deep < PROBCUT_MIN_DEPTH || n[deep] < 2) {
+            snprintf(line, sizeof(line), "    {0, 0, 0, 0}");
+        } else {
+            double slope = (n[deep] * sxy[deep] - sx[deep] * sy[deep]) /
+                (n[deep] * sxx[deep] - sx[deep] * sx[deep]);
+            double intercept = (sy[deep] - slope * sx[deep]) / n[deep];
+
+            //Residual sum of squares expanded in terms of the accumulated sums
+            double residual = syy[deep] - 2 * slope * sxy[deep] - 2 * intercept * sy[deep] +
+                slope * slope * sxx[deep] + 2 * slope * intercept * sx[deep] + n[deep] * intercept * intercept;
+            double sigma = sqrt(max(0.0, residual) / (n[deep] - 2));
+
+            snprintf(line, sizeof(line), "    {%d, %.3f, %.3f, %.3f}", deep / 2, slope, intercept, sigma);
+        }
+
+        cout << line << (deep < max_depth ? "," : "") << endl;
+    }
+    cout << "};" << endl;
+}
@@ -0,0 +1,197 @@
+//Game review
+//
+//Scores every move of a finished game against the best moves in its position, and prints
+//how much each move lost and the best alternatives. Moves are given as a list ("f5d6c3...",
+//passes may be left out or written "pa") or as a GGF record, whose BO board replaces the
+//standard start.
+//
+//The game is reviewed from the last move backwards. The end game is solved exactly, one
+//position after another, by a single solver using every thread: each earlier position's
+//moves lead into positions already solved, which are found in the solver's table instead of
+//being solved again. The positions before that are split into one block of consecutive moves
+//per thread, each block searched backwards by its own computer player, so the cache carries
+//results from each move to the one before it. "independent" reviews each move on its own
+//with empty caches instead, to compare the cost.
+//
+//Usage: review_game [game file | -] [depth] [solve empties] [threads] [backward|independent]
+
+#include "Board.h"
+#include "Computer_player.h"
+#include "Game_record.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+#include <climits>
+#include <cctype>
+#include <cstdio>
+
+using namespace std;
+
+const static int ALTERNATIVES = 3;  //Best moves listed besides the one played
+
+struct Ply {
+    Board_state board;  //Before the move
+    Piece player;
+    Position move;
+
+    vector<Move_analysis> results;  //Every legal move, best first
+    long long nodes = 0;
+};
+
+//Analyses plies first to last - 1 with one player, in the given direction
+void review_range(vector<Ply> &plies, int first, int last, bool backward, bool independent,
+    int depth, int solve_empties, int solver_threads) {
+
+    Board board;
+    Computer_player player(Piece::P1, &board, depth, solve_empties, false, "Review");
+    player.set_solver_threads(solver_threads);
+
+    for(int k = 0; k < last - first; k++) {
+        Ply &ply = plies[backward ? last - 1 - k : first + k];
+        if(independent)
+            player.clear_cache();
+
+        board.set_state(ply.board);
+        ply.results = player.analyze(ply.player);
+        ply.nodes = player.last_nodes();
+    }
+}
+
+//Disc margins for moves searched to the end, evaluations otherwise. The loss of a move is
+//the difference of these, so a win found by the midgame search counts as its margin.
+int score(int value) {
+    if(value >= INT_MAX / 4)
+        return value - INT_MAX / 2;
+    if(value <= INT_MIN / 4)
+        return value + INT_MAX / 2;
+    return value;
+}
+
+string value_text(int value) {
+    return (score(value) >= 0 ? "+" : "") + to_string(score(value));
+}
+
+int main(int argc, char *argv[]) {
+    string source = argc > 1 ? argv[1] : "-";
+    int depth = 8;
+    int solve_empties = 18;
+    int threads = 0;
+    string mode = argc > 5 ? argv[5] : "backward";
+    try {
+        if(argc > 2)
+            depth = stoi(argv[2]);
+        if(argc > 3)
+            solve_empties = stoi(argv[3]);
+        if(argc > 4)
+            threads = stoi(argv[4]);
+    } catch(const exception &) {
+        cerr << "Usage: review_game [game file | -] [depth] [solve empties] [threads] [backward|independent]" << endl;
+        return 1;
+    }
+    if(threads <= 0)
+        threads = max(1, int(thread::hardware_concurrency()));
+    if(mode != "backward" && mode != "independent") {
+        cerr << "The mode must be backward or independent" << endl;
+        return 1;
+    }
+
+    stringstream text;
+    if(source == "-") {
+        text << cin.rdbuf();
+    } else {
+        ifstream file(source);
+        if(!file) {
+            cerr << "Cannot open " << source << endl;
+            return 1;
+        }
+        text << file.rdbuf();
+    }
+
+    Game_record record;
+    string error;
+    if(!read_game_record(text.str(), record, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    vector<Ply> plies;
+    for(const Recorded_move &move: record.moves)
+        plies.push_back({move.board, move.player, move.move, {}, 0});
+
+    auto start = chrono::steady_clock::now();
+
+    if(mode == "independent") {
+        review_range(plies, 0, plies.size(), false, true, depth, solve_empties, threads);
+    } else {
+        //Plies are in order of falling empties, so the end game is a block at the end
+        int first_solved = plies.size();
+        while(first_solved > 0 && plies[first_solved - 1].board.count(Piece::EMPTY) <= solve_empties)
+            first_solved--;
+
+        review_range(plies, first_solved, plies.size(), true, false, depth, solve_empties, threads);
+
+        vector<thread> workers;
+        int blocks = min(threads, first_solved);
+        for(int i = 0; i < blocks; i++) {
+            int first = first_solved * i / blocks;
+            int last = first_solved * (i + 1) / blocks;
+            workers.emplace_back(review_range, ref(plies), first, last, true, false, depth, solve_empties, 1);
+        }
+        for(thread &t: workers)
+            t.join();
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("%4s %-6s %-9s %-9s %5s %6s  %s\n", "Move", "Player", "Played", "Best", "Depth", "Loss", "Alternatives");
+
+    long long total_nodes = 0;
+    int mistakes[2] = {0, 0};
+    long long disc_loss[2] = {0, 0};
+    for(size_t i = 0; i < plies.size(); i++) {
+        const Ply &ply = plies[i];
+        total_nodes += ply.nodes;
+        if(ply.results.empty())
+            continue;
+
+        const Move_analysis &best = ply.results.front();
+        const Move_analysis *played = &best;
+        for(const Move_analysis &result: ply.results)
+            if(result.pos.row == ply.move.row && result.pos.col == ply.move.col)
+                played = &result;
+
+        int lost = score(best.value) - score(played->value);
+        int side = ply.player == Piece::P1 ? 0 : 1;
+        if(lost > 0) {
+            mistakes[side]++;
+            if(best.exact)
+                disc_loss[side] += lost;
+        }
+
+        string alternatives;
+        int listed = 0;
+        for(const Move_analysis &result: ply.results) {
+            if(&result == played || listed == ALTERNATIVES)
+                continue;
+            alternatives += to_string(result.pos) + " " + value_text(result.value) + "  ";
+            listed++;
+        }
+
+        printf("%4zu %-6s %-3s %-5s %-3s %-5s %5s %6d  %s\n", i + 1, ply.player == Piece::P1 ? "X" : "O",
+            to_string(ply.move).c_str(), value_text(played->value).c_str(),
+            to_string(best.pos).c_str(), value_text(best.value).c_str(),
+            best.exact ? "end" : to_string(best.depth).c_str(), lost, alternatives.c_str());
+    }
+
+    printf("\nMoves that lost value: X %d, O %d\n", mistakes[0], mistakes[1]);
+    printf("Discs lost in the solved end game: X %lld, O %lld\n", disc_loss[0], disc_loss[1]);
+    printf("Reviewed %zu moves in %.2f s, %lld nodes (%s)\n", plies.size(), seconds, total_nodes, mode.c_str());
+}
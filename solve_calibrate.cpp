@@ -0,0 +1,111 @@
+//Calibration tool for the solve cost prediction in Computer_player.h
+//
+//Generates positions from randomized self-play games at a range of empty square counts,
+//solves each of them exactly and win/loss/draw only, and fits
+//ln(nodes) = intercept + per_empty * empties + per_log_mobility * ln(mobility + 1)
+//to the exact solves with least squares. The fit is printed as a SOLVE_COST constant,
+//ready to be pasted into Computer_player.h, along with the speed of the solves.
+//
+//Usage: solve_calibrate [positions per empty count] [max empties] [seed]
+
+#include "Board.h"
+#include "Computer_player.h"
+#include "Random_positions.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+const static int MIN_EMPTIES = 6;
+
+//Solves the 3x3 system a * x = b in place with Gaussian elimination
+void solve_3x3(double a[3][3], double b[3], double x[3]) {
+    for(int col = 0; col < 3; col++) {
+        int pivot = col;
+        for(int row = col + 1; row < 3; row++)
+            if(fabs(a[row][col]) > fabs(a[pivot][col]))
+                pivot = row;
+        swap(a[col], a[pivot]);
+        swap(b[col], b[pivot]);
+
+        for(int row = col + 1; row < 3; row++) {
+            double factor = a[row][col] / a[col][col];
+            for(int k = col; k < 3; k++)
+                a[row][k] -= factor * a[col][k];
+            b[row] -= factor * b[col];
+        }
+    }
+
+    for(int row = 2; row >= 0; row--) {
+        x[row] = b[row];
+        for(int k = row + 1; k < 3; k++)
+            x[row] -= a[row][k] * x[k];
+        x[row] /= a[row][row];
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int positions = argc > 1 ? stoi(argv[1]) : 20;
+    int max_empties = argc > 2 ? stoi(argv[2]) : 20;
+    int seed = argc > 3 ? stoi(argv[3]) : 1;
+
+    Board board;
+    Computer_player engine(Piece::P1, &board, 7, 0, false);
+    //Node counts are only repeatable with one thread, and the model predicts serial nodes
+    engine.set_solver_threads(1);
+    mt19937 generator(seed);
+
+    //Normal equations of the least squares fit, and the sums for the win/loss/draw ratio
+    double ata[3][3] = {{0}}, atb[3] = {0};
+    double log_ratio_sum = 0;
+    long long total_nodes = 0;
+    double total_seconds = 0;
+    int solved = 0;
+
+    for(int empties = MIN_EMPTIES; empties <= max_empties; empties++) {
+        for(int i = 0; i < positions; ) {
+            //A game where the engine mostly plays its best move
+            Random_position position = random_position(generator, empties, Engine_move<Computer_player>{engine, 0.7});
+            Board_vec board_state = position.board_vec();
+            Piece piece = position.piece;
+
+            engine.clear_cache();
+            auto start = chrono::steady_clock::now();
+            engine.solve_value(board_state, piece);
+            total_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            long long exact_nodes = engine.last_nodes();
+            total_nodes += exact_nodes;
+
+            engine.clear_cache();
+            engine.solve_value(board_state, piece, Solve::WIN_LOSS_DRAW);
+            long long wld_nodes = engine.last_nodes();
+
+            double row[3] = {1, double(empties), log(Board::count_legal_positions(board_state, piece) + 1.0)};
+            double y = log(double(exact_nodes));
+            for(int j = 0; j < 3; j++) {
+                for(int k = 0; k < 3; k++)
+                    ata[j][k] += row[j] * row[k];
+                atb[j] += row[j] * y;
+            }
+            log_ratio_sum += log(double(wld_nodes) / exact_nodes);
+
+            i++;
+            solved++;
+            cerr << "\rEmpties: " << empties << "/" << max_empties << "  positions: " << i << "/" << positions << flush;
+        }
+    }
+    cerr << endl;
+
+    double fit[3];
+    solve_3x3(ata, atb, fit);
+
+    printf("Solve speed: %.0f nodes per second\n", total_nodes / total_seconds);
+    printf("const static Solve_cost_fit SOLVE_COST = {%.3f, %.3f, %.3f, %.3f};\n",
+        fit[0], fit[1], fit[2], exp(log_ratio_sum / solved));
+}
@@ -0,0 +1,608 @@
+//Distributed end game solver, for positions too large to solve on one machine
+//
+//The coordinator expands the game tree a few moves below the position and hands the
+//positions at the bottom of that tree to worker processes as jobs, each solved with
+//Endgame_solver. Results come back as bounds on the final margin and are combined up
+//the tree with negamax. Every job is given the alpha-beta window in which its result
+//can still change the root, so later jobs get narrower windows and whole subtrees are
+//skipped once a cutoff is proven. A job whose result stops mattering is cancelled, and
+//a job whose worker disconnects is handed to another worker.
+//
+//Workers connect to the coordinator, so they can be started on other machines against
+//a TCP address. The coordinator can also start local workers itself.
+//
+//Usage: solve_cluster coordinator <address> <position> [local workers] [split moves]
+//       solve_cluster worker <address> [threads]
+//
+//Addresses are unix:<path> or <host>:<port>. The position is 64 squares of X, O and -
+//followed by the player to move, as in the FFO test suite.
+
+#include "Board.h"
+#include "Endgame_solver.h"
+#include "Socket.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <poll.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+//Every message has the same layout, with the fields a message type does not use left at 0:
+//type (1 byte), job id (4), own and opp discs (8 each), alpha and beta (4 each),
+//value (4), aborted (1) and nodes (8), all integers little endian.
+//  HELLO   worker -> coordinator  value is the worker's thread count
+//  JOB     coordinator -> worker  solve own to move in the window (alpha, beta)
+//  CANCEL  coordinator -> worker  give up on the job, a RESULT is still sent
+//  RESULT  worker -> coordinator  value is the margin or a bound outside the window
+enum Message_type : unsigned char {
+    HELLO = 'H', JOB = 'J', CANCEL = 'C', RESULT = 'R'
+};
+
+struct Message {
+    unsigned char type = 0;
+    uint32_t id = 0;
+    Bitboard own = 0;
+    Bitboard opp = 0;
+    int alpha = 0;
+    int beta = 0;
+    int value = 0;
+    bool aborted = false;
+    uint64_t nodes = 0;
+};
+
+const static size_t MESSAGE_SIZE = 42;
+
+void put(string &out, uint64_t value, int bytes) {
+    for(int i = 0; i < bytes; i++)
+        out += char((value >> (8 * i)) & 0xff);
+}
+
+uint64_t get(const string &in, size_t &offset, int bytes) {
+    uint64_t value = 0;
+    for(int i = 0; i < bytes; i++)
+        value |= uint64_t((unsigned char)in[offset + i]) << (8 * i);
+    offset += bytes;
+    return value;
+}
+
+string encode(const Message &m) {
+    string out;
+    put(out, m.type, 1);
+    put(out, m.id, 4);
+    put(out, m.own, 8);
+    put(out, m.opp, 8);
+    put(out, uint32_t(m.alpha), 4);
+    put(out, uint32_t(m.beta), 4);
+    put(out, uint32_t(m.value), 4);
+    put(out, m.aborted, 1);
+    put(out, m.nodes, 8);
+    return out;
+}
+
+bool decode(const string &in, Message &m) {
+    if(in.size() != MESSAGE_SIZE)
+        return false;
+
+    size_t offset = 0;
+    m.type = get(in, offset, 1);
+    m.id = get(in, offset, 4);
+    m.own = get(in, offset, 8);
+    m.opp = get(in, offset, 8);
+    m.alpha = int32_t(get(in, offset, 4));
+    m.beta = int32_t(get(in, offset, 4));
+    m.value = int32_t(get(in, offset, 4));
+    m.aborted = get(in, offset, 1);
+    m.nodes = get(in, offset, 8);
+    return true;
+}
+
+bool send_message(Connection &connection, const Message &m) {
+    return connection.send_frame(encode(m));
+}
+
+
+//Worker
+
+int run_worker(const string &address, int threads) {
+    //The coordinator may still be starting up
+    int fd = -1;
+    for(int attempt = 0; attempt < 100 && fd < 0; attempt++) {
+        fd = connect_socket(address);
+        if(fd < 0)
+            this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    if(fd < 0) {
+        cerr << "Cannot connect to " << address << endl;
+        return 1;
+    }
+
+    Connection connection(fd);
+    Endgame_solver solver(threads);
+
+    Message hello;
+    hello.type = HELLO;
+    hello.value = solver.threads();
+    send_message(connection, hello);
+
+    //The job is solved on its own thread, so a CANCEL is read while it runs
+    thread solving;
+    atomic<bool> busy{false}, done{false}, stop{false};
+    Message job, result;
+
+    bool open = true;
+    while(open || busy) {
+        pollfd input = {connection.fd(), POLLIN, 0};
+        if(!open)
+            this_thread::sleep_for(chrono::milliseconds(10));
+        else if(poll(&input, 1, busy ? 10 : -1) > 0)
+            open = connection.receive();
+
+        //Once the coordinator is gone the job is pointless
+        if(!open)
+            stop = true;
+
+        string frame;
+        Message m;
+        while(connection.next_frame(frame)) {
+            if(!decode(frame, m))
+                continue;
+
+            if(m.type == JOB && !busy) {
+                job = m;
+                stop = false;
+                done = false;
+                busy = true;
+                solving = thread([&] {
+                    int best;
+                    result = Message();
+                    result.type = RESULT;
+                    result.id = job.id;
+                    result.value = solver.solve(job.own, job.opp, job.alpha, job.beta, best, stop, chrono::steady_clock::time_point::max());
+                    result.aborted = solver.aborted();
+                    result.nodes = solver.last_nodes();
+                    done = true;
+                });
+            } else if(m.type == CANCEL && busy && m.id == job.id) {
+                stop = true;
+            }
+        }
+
+        if(busy && done) {
+            solving.join();
+            busy = false;
+            if(open)
+                send_message(connection, result);
+        }
+    }
+
+    return 0;
+}
+
+
+//Coordinator
+
+//A position in the tree the coordinator expanded. Values are final margins for the player
+//to move in the node, known to lie in [lower, upper].
+struct Node {
+    Board_vec board;
+    Piece piece;
+    Position move;  //The move that led here, unset for a pass
+    int parent = -1;
+    vector<int> children;
+    bool job = false;  //Solved by a worker rather than from its children
+
+    int lower = -64;
+    int upper = 64;
+
+    //The window the node's value matters in, set by assign_windows
+    int alpha = -65;
+    int beta = 65;
+    bool relevant = true;
+
+    int worker = -1;  //The worker solving the job, if any
+    int job_alpha = 0;
+    int job_beta = 0;
+};
+
+struct Worker {
+    unique_ptr<Connection> connection;
+    int threads = 0;
+    int node = -1;  //The job's node, -1 when idle
+    uint32_t job_id = 0;
+    bool cancelled = false;
+};
+
+class Coordinator {
+private:
+    vector<Node> _nodes;
+    vector<Worker> _workers;
+    int _listener;
+
+    uint32_t _next_job_id = 1;
+    int _jobs = 0;
+    int _reissued = 0;
+    int _cancelled = 0;
+    uint64_t _total_nodes = 0;
+
+    //Adds a node and the tree below it, down to the given number of moves
+    int expand(const Board_vec &board, Piece piece, Position move, int parent, int moves);
+    //Recomputes the bounds of a node's ancestors from their children
+    void update_bounds(int index);
+    //Sets the window of each node from the bounds of its ancestors and their other children
+    void assign_windows(int index, int alpha, int beta);
+    void mark_irrelevant(int index);
+
+    void accept_worker();
+    void handle_result(int w, const Message &m);
+    void drop_worker(int w);
+    //Cancels jobs that no longer matter and gives idle workers the next jobs in tree order
+    void schedule();
+
+public:
+    Coordinator(const Board_vec &board, Piece piece, int listener, int split_moves);
+    //Runs until the root is solved. Returns false if every worker is lost first.
+    bool solve(int expected_workers);
+    void report(double seconds) const;
+};
+
+Coordinator::Coordinator(const Board_vec &board, Piece piece, int listener, int split_moves):
+_listener(listener)
+{
+    expand(board, piece, Position(), -1, split_moves);
+    for(int i = _nodes.size() - 1; i >= 0; i--)
+        if(!_nodes[i].children.empty())
+            update_bounds(_nodes[i].children.front());
+}
+
+int Coordinator::expand(const Board_vec &board, Piece piece, Position move, int parent, int moves) {
+    int index = _nodes.size();
+    _nodes.emplace_back();
+    _nodes[index].board = board;
+    _nodes[index].piece = piece;
+    _nodes[index].move = move;
+    _nodes[index].parent = parent;
+
+    if(Board::game_over(board)) {
+        int margin = Board::count_pieces(board, piece) - Board::count_pieces(board, get_opponent(piece));
+        _nodes[index].lower = _nodes[index].upper = margin;
+        return index;
+    }
+
+    if(moves == 0) {
+        _nodes[index].job = true;
+        return index;
+    }
+
+    if(!Board::can_move(board, piece)) {
+        int child = expand(board, get_opponent(piece), Position(), index, moves - 1);
+        _nodes[index].children.push_back(child);
+        return index;
+    }
+
+    //Fastest first, so the jobs handed out first are the ones most likely to be best
+    vector<pair<int, Position>> ordered;
+    for(Position pos: Board::get_legal_positions(board, piece)) {
+        Board_vec board_next = board;
+        Board::play(board_next, piece, pos);
+        ordered.push_back({Board::count_legal_positions(board_next, get_opponent(piece)), pos});
+    }
+    stable_sort(ordered.begin(), ordered.end(),
+    [](const pair<int, Position> &a, const pair<int, Position> &b)
+    {return a.first < b.first;}
+    );
+
+    for(const pair<int, Position> &o: ordered) {
+        Board_vec board_next = board;
+        Board::play(board_next, piece, o.second);
+        int child = expand(board_next, get_opponent(piece), o.second, index, moves - 1);
+        _nodes[index].children.push_back(child);
+    }
+
+    return index;
+}
+
+void Coordinator::update_bounds(int index) {
+    for(int i = _nodes[index].parent; i >= 0; i = _nodes[i].parent) {
+        int lower = -65, upper = -65;
+        for(int c: _nodes[i].children) {
+            lower = max(lower, -_nodes[c].upper);
+            upper = max(upper, -_nodes[c].lower);
+        }
+        _nodes[i].lower = lower;
+        _nodes[i].upper = upper;
+    }
+}
+
+void Coordinator::assign_windows(int index, int alpha, int beta) {
+    Node &node = _nodes[index];
+    node.alpha = alpha;
+    node.beta = beta;
+    node.relevant = node.lower < node.upper && node.upper > alpha && node.lower < beta;
+
+    if(!node.relevant) {
+        mark_irrelevant(index);
+        return;
+    }
+
+    //The two best lower bounds among the children, so each child can find the best of the others
+    int first = -65, second = -65;
+    for(int c: node.children) {
+        int bound = -_nodes[c].upper;
+        if(bound > first) {
+            second = first;
+            first = bound;
+        } else if(bound > second) {
+            second = bound;
+        }
+    }
+
+    for(int c: node.children) {
+        int others = -_nodes[c].upper == first ? second : first;
+        int child_alpha = max(alpha, others);
+        if(child_alpha >= beta)
+            mark_irrelevant(c);
+        else
+            assign_windows(c, -beta, -child_alpha);
+    }
+}
+
+void Coordinator::mark_irrelevant(int index) {
+    _nodes[index].relevant = false;
+    for(int c: _nodes[index].children)
+        mark_irrelevant(c);
+}
+
+void Coordinator::accept_worker() {
+    int fd = accept(_listener, nullptr, nullptr);
+    if(fd < 0)
+        return;
+
+    Worker worker;
+    worker.connection.reset(new Connection(fd));
+    _workers.push_back(move(worker));
+}
+
+void Coordinator::handle_result(int w, const Message &m) {
+    Worker &worker = _workers[w];
+    if(worker.node < 0 || m.id != worker.job_id)
+        return;
+
+    Node &node = _nodes[worker.node];
+    node.worker = -1;
+    worker.node = -1;
+    worker.cancelled = false;
+    _total_nodes += m.nodes;
+
+    //A job cancelled too late still finishes, and its bound is as true as any other
+    if(m.aborted)
+        return;
+
+    if(m.value <= node.job_alpha) {
+        node.upper = min(node.upper, m.value);
+    } else if(m.value >= node.job_beta) {
+        node.lower = max(node.lower, m.value);
+    } else {
+        node.lower = m.value;
+        node.upper = m.value;
+    }
+    update_bounds(&node - _nodes.data());
+}
+
+void Coordinator::drop_worker(int w) {
+    Worker &worker = _workers[w];
+    if(worker.node >= 0) {
+        _nodes[worker.node].worker = -1;
+        _reissued++;
+    }
+
+    _workers.erase(_workers.begin() + w);
+    for(Node &node: _nodes)
+        if(node.worker > w)
+            node.worker--;
+}
+
+void Coordinator::schedule() {
+    assign_windows(0, -65, 65);
+
+    for(Worker &worker: _workers) {
+        if(worker.node < 0 || worker.cancelled || _nodes[worker.node].relevant)
+            continue;
+
+        Message cancel;
+        cancel.type = CANCEL;
+        cancel.id = worker.job_id;
+        send_message(*worker.connection, cancel);
+        worker.cancelled = true;
+        _cancelled++;
+    }
+
+    //Nodes are numbered in tree order, so the jobs are handed out in search order
+    size_t next = 0;
+    for(int w = 0; w < int(_workers.size()); w++) {
+        Worker &worker = _workers[w];
+        if(worker.node >= 0 || worker.threads == 0)
+            continue;
+
+        while(next < _nodes.size() && !(_nodes[next].job && _nodes[next].relevant && _nodes[next].worker < 0))
+            next++;
+        if(next == _nodes.size())
+            break;
+
+        //The known bounds narrow the window too, as values outside them cannot occur
+        Node &node = _nodes[next];
+        node.job_alpha = max(node.alpha, node.lower - 1);
+        node.job_beta = min(node.beta, node.upper + 1);
+
+        Message job;
+        job.type = JOB;
+        job.id = _next_job_id++;
+        to_bitboards(node.board, node.piece, job.own, job.opp);
+        job.alpha = node.job_alpha;
+        job.beta = node.job_beta;
+        if(!send_message(*worker.connection, job))
+            continue;  //The failure is noticed when the connection is next read
+
+        node.worker = w;
+        worker.node = next;
+        worker.job_id = job.id;
+        _jobs++;
+    }
+}
+
+bool Coordinator::solve(int expected_workers) {
+    bool had_workers = false;
+
+    while(_nodes[0].lower < _nodes[0].upper) {
+        schedule();
+
+        vector<pollfd> fds = {{_listener, POLLIN, 0}};
+        for(Worker &worker: _workers)
+            fds.push_back({worker.connection->fd(), POLLIN, 0});
+        poll(fds.data(), fds.size(), 1000);
+
+        if(fds[0].revents & POLLIN)
+            accept_worker();
+
+        //Backwards, so dropping a worker does not move the ones still to be read
+        for(int w = int(fds.size()) - 2; w >= 0; w--) {
+            if(!fds[w + 1].revents)
+                continue;
+
+            Worker &worker = _workers[w];
+            bool open = worker.connection->receive();
+
+            string frame;
+            Message m;
+            while(worker.connection->next_frame(frame)) {
+                if(!decode(frame, m))
+                    continue;
+                if(m.type == HELLO) {
+                    worker.threads = max(1, m.value);
+                    had_workers = true;
+                } else if(m.type == RESULT) {
+                    handle_result(w, m);
+                }
+            }
+
+            if(!open)
+                drop_worker(w);
+        }
+
+        //Local workers that all died are not coming back, remote ones may still connect
+        if(had_workers && _workers.empty() && expected_workers > 0)
+            return false;
+    }
+
+    return true;
+}
+
+void Coordinator::report(double seconds) const {
+    const Node &root = _nodes[0];
+
+    string best = "pass";
+    for(int c: root.children)
+        if(-_nodes[c].upper == root.lower && _nodes[c].move.row < Board::SIZE)
+            best = to_string(_nodes[c].move);
+    if(root.children.empty())
+        best = "none";
+
+    printf("Margin: %+d  Best move: %s\n", root.lower, best.c_str());
+    printf("Jobs: %d (%d cancelled, %d reissued)  Nodes: %llu  Time: %.2f s  Speed: %.2f M nodes/s\n",
+        _jobs, _cancelled, _reissued, (unsigned long long)_total_nodes, seconds, _total_nodes / seconds / 1e6);
+}
+
+//Reads a position in the FFO format, returning false if it is not one
+bool parse_position(const string &text, Board_vec &board, Piece &piece) {
+    board = Board_vec(8, vector<Piece>(8, Piece::EMPTY));
+    int square = 0;
+    size_t i = 0;
+    for(; i < text.size() && square < 64; i++) {
+        char c = toupper(text[i]);
+        if(c == 'X' || c == '*')
+            board[square / 8][square % 8] = Piece::P1;
+        else if(c == 'O')
+            board[square / 8][square % 8] = Piece::P2;
+        else if(c != '-' && c != '.')
+            continue;
+        square++;
+    }
+
+    size_t side = text.find_first_not_of(" \t", i);
+    if(square < 64 || side == string::npos)
+        return false;
+
+    char mover = toupper(text[side]);
+    piece = mover == 'O' ? Piece::P2 : Piece::P1;
+    return mover == 'X' || mover == '*' || mover == 'O';
+}
+
+int run_coordinator(const string &self, const string &address, const string &position, int local_workers, int split_moves) {
+    Board_vec board;
+    Piece piece;
+    if(!parse_position(position, board, piece)) {
+        cerr << "Not a position: " << position << endl;
+        return 1;
+    }
+
+    int listener = listen_socket(address);
+    Coordinator coordinator(board, piece, listener, split_moves);
+
+    vector<pid_t> children;
+    for(int i = 0; i < local_workers; i++) {
+        pid_t pid = fork();
+        if(pid == 0) {
+            close(listener);
+            execl("/proc/self/exe", self.c_str(), "worker", address.c_str(), (char *)nullptr);
+            _exit(1);
+        }
+        children.push_back(pid);
+    }
+
+    auto start = chrono::steady_clock::now();
+    bool solved = coordinator.solve(local_workers);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    //Closing the connections (with the coordinator) tells the workers to exit
+    close(listener);
+    if(solved)
+        coordinator.report(seconds);
+    else
+        cerr << "Every worker was lost before the position was solved" << endl;
+
+    string host, port;
+    if(parse_address(address, host, port))
+        unlink(host.c_str());
+    return solved ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    string role = argc > 1 ? argv[1] : "";
+
+    try {
+        if(role == "worker" && argc > 2)
+            return run_worker(argv[2], argc > 3 ? stoi(argv[3]) : 0);
+
+        if(role == "coordinator" && argc > 3) {
+            int local_workers = argc > 4 ? stoi(argv[4]) : 0;
+            int split_moves = argc > 5 ? stoi(argv[5]) : 2;
+            int status = run_coordinator(argv[0], argv[2], argv[3], local_workers, split_moves);
+            while(wait(nullptr) > 0) {}
+            return status;
+        }
+    } catch(const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    cerr << "Usage: solve_cluster coordinator <address> <position> [local workers] [split moves]" << endl;
+    cerr << "       solve_cluster worker <address> [threads]" << endl;
+    return 1;
+}
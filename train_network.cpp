@@ -0,0 +1,292 @@
+//Trainer for the network evaluator in Network.h
+//
+//Plays self-play games with the computer player, choosing mostly the move with the best
+//1 move search value and sometimes a random move, and records every position with the
+//final disc margin from the point of view of the player to move. Each position is used
+//in all 8 of its rotations and reflections. A floating point copy of the network is
+//fitted to the margins with Adam, then quantized and written as a weights file.
+//
+//If the output file already holds a network, the games are played with it instead of
+//the position weights, so repeated runs train each network on the games of the last.
+//
+//Usage: train_network [games] [epochs] [output] [seed]
+
+#include "Board.h"
+#include "Computer_player.h"
+#include "Network.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+struct Sample {
+    Bitboard own;  //Discs of the player to move
+    Bitboard opp;
+    float target;  //Final margin for the player to move, divided by MARGIN_SCALE
+};
+
+//Targets and outputs are kept near 1 while training, and scaled back when quantizing
+const static float MARGIN_SCALE = 64;
+
+//Plays one game and adds its positions to samples
+void play_game(Computer_player &engine, mt19937 &generator, vector<Sample> &samples) {
+    Board board;
+    Board_vec board_state = board.get_board_vec();
+    Piece piece = Piece::P1;
+
+    vector<pair<Sample, Piece>> positions;
+
+    while(!Board::game_over(board_state)) {
+        if(!Board::can_move(board_state, piece)) {
+            piece = get_opponent(piece);
+            continue;
+        }
+
+        Sample sample;
+        to_bitboards(board_state, piece, sample.own, sample.opp);
+        positions.push_back({sample, piece});
+
+        vector<Position> moves = Board::get_legal_positions(board_state, piece);
+        Position choice = moves[uniform_int_distribution<int>(0, moves.size() - 1)(generator)];
+
+        if(uniform_real_distribution<double>(0, 1)(generator) < 0.9) {
+            int best = INT_MIN;
+            for(Position pos: moves) {
+                Board_vec board_next = board_state;
+                Board::play(board_next, piece, pos);
+                int value = -1 * engine.search_value(board_next, get_opponent(piece), 0);
+                if(value > best) {
+                    best = value;
+                    choice = pos;
+                }
+            }
+        }
+
+        Board::play(board_state, piece, choice);
+        piece = get_opponent(piece);
+    }
+
+    int p1_margin = Board::count_pieces(board_state, Piece::P1) - Board::count_pieces(board_state, Piece::P2);
+    for(auto &position: positions) {
+        int margin = position.second == Piece::P1 ? p1_margin : -p1_margin;
+        for(int i = 0; i < 8; i++) {
+            Sample sample = position.first;
+            sample.own = symmetry(sample.own, i);
+            sample.opp = symmetry(sample.opp, i);
+            sample.target = margin / MARGIN_SCALE;
+            samples.push_back(sample);
+        }
+    }
+}
+
+//The network in floating point, with the same layers as Network
+struct Float_network {
+    const static int H1 = Network::HIDDEN1;
+    const static int H2 = Network::HIDDEN2;
+
+    //All parameters in one array so the optimizer can treat them alike
+    vector<float> params;
+    float *w1, *b1, *w2, *b2, *w3, *b3;
+
+    Float_network(): params(Network::INPUTS * H1 + H1 + H2 * H1 + H2 + H2 + 1) {
+        w1 = params.data();
+        b1 = w1 + Network::INPUTS * H1;
+        w2 = b1 + H1;
+        b2 = w2 + H2 * H1;
+        w3 = b2 + H2;
+        b3 = w3 + H2;
+    }
+
+    //The largest hidden weight that still fits in a signed byte once quantized
+    static float max_hidden_weight() {
+        return 127.0f / Network::WEIGHT_SCALE;
+    }
+
+    //Runs the network and keeps the layer values needed for the gradient
+    float forward(const Sample &s, float pre1[], float h1[], float pre2[], float h2[]) const {
+        for(int i = 0; i < H1; i++)
+            pre1[i] = b1[i];
+        for(Bitboard bits = s.own; bits; bits &= bits - 1)
+            for(int i = 0, f = first_square(bits); i < H1; i++)
+                pre1[i] += w1[f * H1 + i];
+        for(Bitboard bits = s.opp; bits; bits &= bits - 1)
+            for(int i = 0, f = 64 + first_square(bits); i < H1; i++)
+                pre1[i] += w1[f * H1 + i];
+        for(int i = 0; i < H1; i++)
+            h1[i] = min(max(pre1[i], 0.0f), 1.0f);
+
+        float out = *b3;
+        for(int j = 0; j < H2; j++) {
+            pre2[j] = b2[j];
+            for(int i = 0; i < H1; i++)
+                pre2[j] += w2[j * H1 + i] * h1[i];
+            h2[j] = min(max(pre2[j], 0.0f), 1.0f);
+            out += w3[j] * h2[j];
+        }
+
+        return out;
+    }
+
+    //Adds the gradient of the squared error of one sample to grad
+    float backward(const Sample &s, vector<float> &grad) const {
+        float pre1[H1], h1[H1], pre2[H2], h2[H2];
+        float out = forward(s, pre1, h1, pre2, h2);
+        float d_out = 2 * (out - s.target);
+
+        float *g_w1 = grad.data() + (w1 - params.data());
+        float *g_b1 = grad.data() + (b1 - params.data());
+        float *g_w2 = grad.data() + (w2 - params.data());
+        float *g_b2 = grad.data() + (b2 - params.data());
+        float *g_w3 = grad.data() + (w3 - params.data());
+        float *g_b3 = grad.data() + (b3 - params.data());
+
+        *g_b3 += d_out;
+
+        float d_h1[H1] = {0};
+        for(int j = 0; j < H2; j++) {
+            g_w3[j] += d_out * h2[j];
+            if(pre2[j] <= 0 || pre2[j] >= 1)
+                continue;
+
+            float d_pre2 = d_out * w3[j];
+            g_b2[j] += d_pre2;
+            for(int i = 0; i < H1; i++) {
+                g_w2[j * H1 + i] += d_pre2 * h1[i];
+                d_h1[i] += d_pre2 * w2[j * H1 + i];
+            }
+        }
+
+        for(int i = 0; i < H1; i++)
+            if(pre1[i] <= 0 || pre1[i] >= 1)
+                d_h1[i] = 0;
+
+        for(int i = 0; i < H1; i++)
+            g_b1[i] += d_h1[i];
+        for(Bitboard bits = s.own; bits; bits &= bits - 1)
+            for(int i = 0, f = first_square(bits); i < H1; i++)
+                g_w1[f * H1 + i] += d_h1[i];
+        for(Bitboard bits = s.opp; bits; bits &= bits - 1)
+            for(int i = 0, f = 64 + first_square(bits); i < H1; i++)
+                g_w1[f * H1 + i] += d_h1[i];
+
+        return (out - s.target) * (out - s.target);
+    }
+
+    void quantize(Network &network) const {
+        auto fit = [](float value, float scale, long long lowest, long long highest) {
+            return max(lowest, min(highest, (long long)lround(value * scale)));
+        };
+
+        const float a = Network::ACTIVATION_SCALE;
+        const float w = Network::WEIGHT_SCALE;
+
+        for(int f = 0; f < Network::INPUTS; f++)
+            for(int i = 0; i < H1; i++)
+                network.input_weights[f][i] = fit(w1[f * H1 + i], a, -32767, 32767);
+        for(int i = 0; i < H1; i++)
+            network.input_biases[i] = fit(b1[i], a, -32767, 32767);
+
+        for(int j = 0; j < H2; j++) {
+            for(int i = 0; i < H1; i++)
+                network.hidden_weights[j][i] = fit(w2[j * H1 + i], w, -127, 127);
+            network.hidden_biases[j] = fit(b2[j], a * w, INT_MIN, INT_MAX);
+            network.output_weights[j] = fit(w3[j], w * MARGIN_SCALE, -32767, 32767);
+        }
+        network.output_bias = fit(*b3, a * w * MARGIN_SCALE, INT_MIN, INT_MAX);
+    }
+};
+
+//Root mean squared error in discs of the quantized network, as used by the search
+double quantized_error(const Network &network, const vector<Sample> &samples) {
+    double total = 0;
+    Network::Accumulator acc;
+    for(const Sample &s: samples) {
+        network.refresh(acc, s.own, s.opp);
+        double predicted = network.evaluate(acc, Piece::P1) / double(Network::DISC_VALUE);
+        double error = predicted - s.target * MARGIN_SCALE;
+        total += error * error;
+    }
+    return sqrt(total / samples.size());
+}
+
+int main(int argc, char *argv[]) {
+    int games = argc > 1 ? stoi(argv[1]) : 1000;
+    int epochs = argc > 2 ? stoi(argv[2]) : 6;
+    string output = argc > 3 ? argv[3] : "reversi.net";
+    int seed = argc > 4 ? stoi(argv[4]) : 1;
+
+    mt19937 generator(seed);
+
+    Board board;
+    Computer_player engine(Piece::P1, &board, 1, 0, false);
+    Network previous;
+    if(previous.load(output)) {
+        cerr << "Playing with the network in " << output << endl;
+        engine.set_network(&previous);
+    }
+
+    vector<Sample> samples;
+    for(int game = 0; game < games; game++) {
+        play_game(engine, generator, samples);
+        cerr << "\rGames: " << game + 1 << "/" << games << flush;
+    }
+    cerr << endl;
+
+    //Whole games are held out, so the validation positions are not symmetries of training ones
+    size_t validation_size = samples.size() / 20 / 8 * 8;
+    vector<Sample> validation(samples.end() - validation_size, samples.end());
+    samples.resize(samples.size() - validation_size);
+
+    Float_network net;
+    normal_distribution<float> init(0, 0.1f);
+    for(float &p: net.params)
+        p = init(generator);
+    for(int i = 0; i < Network::HIDDEN1; i++)
+        net.b1[i] = 0.5f;
+
+    //Adam
+    const float rate = 0.001f, beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+    const int batch_size = 256;
+    vector<float> grad(net.params.size()), m(net.params.size()), v(net.params.size());
+    long long step = 0;
+
+    for(int epoch = 0; epoch < epochs; epoch++) {
+        shuffle(samples.begin(), samples.end(), generator);
+
+        double loss = 0;
+        for(size_t start = 0; start < samples.size(); start += batch_size) {
+            size_t end = min(samples.size(), start + batch_size);
+            fill(grad.begin(), grad.end(), 0.0f);
+            for(size_t i = start; i < end; i++)
+                loss += net.backward(samples[i], grad);
+
+            step++;
+            float correction1 = 1 - pow(beta1, step);
+            float correction2 = 1 - pow(beta2, step);
+            for(size_t k = 0; k < net.params.size(); k++) {
+                float g = grad[k] / (end - start);
+                m[k] = beta1 * m[k] + (1 - beta1) * g;
+                v[k] = beta2 * v[k] + (1 - beta2) * g * g;
+                net.params[k] -= rate * (m[k] / correction1) / (sqrt(v[k] / correction2) + epsilon);
+            }
+
+            for(int k = 0; k < Network::HIDDEN2 * Network::HIDDEN1; k++)
+                net.w2[k] = min(max(net.w2[k], -Float_network::max_hidden_weight()), Float_network::max_hidden_weight());
+        }
+
+        Network quantized;
+        net.quantize(quantized);
+        printf("Epoch %d: training error %.2f discs, validation error %.2f discs\n", epoch + 1,
+            sqrt(loss / samples.size()) * MARGIN_SCALE, quantized_error(quantized, validation));
+    }
+
+    Network quantized;
+    net.quantize(quantized);
+    quantized.save(output);
+    cout << "Saved " << output << endl;
+}